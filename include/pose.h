@@ -40,7 +40,8 @@ typedef enum
     RESULT_INVALIDPARAMETERS = -3,
     RESULT_INTERNALERROR = -4,
     RESULT_UNHANDLEDEXCEPTION = -5,
-    RESULT_FINISHED = -6
+    RESULT_FINISHED = -6,
+    RESULT_NODATA = -7
 } PoseResult;
 
 typedef enum
@@ -94,15 +95,60 @@ struct _PoseScene
 {
     PoseSkeleton* skeletons;
     int numSkeletons;
+    long long timestamp;        // capture timestamp of the frame the scene belongs to
+    unsigned int sequence;      // sequence number of the frame the scene belongs to
 };
 typedef struct _PoseScene PoseScene;
 
+// all latencies are given in milliseconds
+typedef struct
+{
+    unsigned int frames;
+    unsigned int sequenceGaps;      // number of detected gaps in the sequence numbers
+    unsigned int droppedFrames;     // number of frames missing in these gaps
+    unsigned int outOfOrderFrames;  // duplicate or reordered sequence numbers
+    float lastQueueLatency;         // capture until the frame is passed to the library
+    float avgQueueLatency;
+    float maxQueueLatency;
+    float lastProcessingLatency;    // frame passed to the library until the scene is available
+    float avgProcessingLatency;
+    float maxProcessingLatency;
+    float lastTotalLatency;         // capture until the scene is available
+    float avgTotalLatency;
+    float maxTotalLatency;
+} PoseLatencyStats;
+
 POSEAPI PoseResult poseInit(PoseContext** context, int width, int height);
 
+// like poseInit, but the background model is loaded from the snapshot file if it exists and matches the
+// image size, so the segmentation works from the first frame; the snapshot is written to the same file every
+// snapshotInterval frames (0 to write it only at poseShutdown)
+POSEAPI PoseResult poseInitWithSnapshot(PoseContext** context, int width, int height, const char* snapshotPath, int snapshotInterval);
+
 POSEAPI PoseResult poseShutdown(PoseContext* context);
 
+// track the connected components over time and cluster them into users (non-zero), by default all
+// components belong to a single user
+POSEAPI PoseResult poseSetUserTracking(PoseContext* context, int enabled);
+
+// pointsData may be NULL (with pointsDataSize 0) after the first frames, the point cloud is then
+// computed internally from the depth data
 POSEAPI PoseResult poseSetInput(PoseContext* context, float* depthData, int depthDataSize, float* pointsData, int pointsDataSize);
 
+// timestamps are given in microseconds of the clock returned by poseGetTimestamp()
+POSEAPI PoseResult poseSetInputTimestamped(PoseContext* context, float* depthData, int depthDataSize, float* pointsData, int pointsDataSize,
+                                           long long timestamp, unsigned int sequence);
+
+POSEAPI long long poseGetTimestamp(void);
+
+POSEAPI PoseResult poseGetLatencyStats(PoseContext* context, PoseLatencyStats* stats);
+
+// attach to the POSIX shared memory ring buffer of a capture process (see src/input/sharedmemoryring.h)
+POSEAPI PoseResult poseAttachSharedMemory(PoseContext* context, const char* name);
+
+// process the next frame of the shared memory ring buffer in place, returns RESULT_NODATA if there is no new frame
+POSEAPI PoseResult poseProcessSharedMemory(PoseContext* context);
+
 POSEAPI PoseResult poseGetScene(PoseContext* context, PoseScene** scene);
 
 POSEAPI PoseResult poseFreeScene(PoseScene* scene);
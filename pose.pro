@@ -5,9 +5,19 @@ CONFIG += create_prl
 SOURCES += src/pose.cc \
     src/algorithm.cpp \
     src/input/input.cpp \
+    src/input/backprojectkernels.cpp \
+    src/input/depthfilter.cpp \
+    src/input/sharedmemoryinput.cpp \
+    src/input/sharedmemoryproducer.cpp \
     src/segmentation/connectedcomponentlabeling.cpp \
+    src/segmentation/componenttable.cpp \
     src/segmentation/tracking.cpp \
     src/segmentation/staticmap.cpp \
+    src/segmentation/staticmapkernels.cpp \
+    src/segmentation/planeremoval.cpp \
+    src/segmentation/backgroundmixture.cpp \
+    src/segmentation/backgroundmixturekernels.cpp \
+    src/segmentation/backgroundsnapshot.cpp \
     src/tracking/bone.cpp \
     src/tracking/joint.cpp \
     src/tracking/fitting.cpp \
@@ -24,6 +34,12 @@ SOURCES += src/pose.cc \
     src/utils/numberedfilereader.cpp \
     src/utils/module.cpp \
     src/utils/timer.cpp \
+    src/utils/cpufeatures.cpp \
+    src/utils/threadpool.cpp \
+    src/utils/bitmask.cpp \
+    src/utils/assignment.cpp \
+    src/utils/spatialgrid.cpp \
+    src/utils/latencytracer.cpp \
     src/utils/streamreader.cpp \
     src/utils/streamwriter.cpp
 
@@ -31,9 +47,20 @@ HEADERS += include/pose.h \
     src/internal.h \
     src/algorithm.h \
     src/input/input.h \
+    src/input/backprojectkernels.h \
+    src/input/depthfilter.h \
+    src/input/sharedmemoryring.h \
+    src/input/sharedmemoryinput.h \
+    src/input/sharedmemoryproducer.h \
     src/segmentation/connectedcomponentlabeling.h \
+    src/segmentation/componenttable.h \
     src/segmentation/tracking.h \
     src/segmentation/staticmap.h \
+    src/segmentation/staticmapkernels.h \
+    src/segmentation/planeremoval.h \
+    src/segmentation/backgroundmixture.h \
+    src/segmentation/backgroundmixturekernels.h \
+    src/segmentation/backgroundsnapshot.h \
     src/tracking/bone.h \
     src/tracking/joint.h \
     src/tracking/fitting.h \
@@ -50,12 +77,23 @@ HEADERS += include/pose.h \
     src/utils/numberedfilereader.h \
     src/utils/module.h \
     src/utils/timer.h \
+    src/utils/cpufeatures.h \
+    src/utils/threadpool.h \
+    src/utils/bitmask.h \
+    src/utils/assignment.h \
+    src/utils/spatialgrid.h \
+    src/utils/frameinfo.h \
+    src/utils/latencytracer.h \
     src/utils/streamreader.h \
     src/utils/streamwriter.h
 
 INCLUDEPATH += $${_PRO_FILE_PWD_}/src \
     $${_PRO_FILE_PWD_}/include
 
+unix {
+    LIBS += -lrt
+}
+
 win32 {
     DEFINES += _CRT_SECURE_NO_WARNINGS \
         DEBUG_IMAGES
@@ -1,11 +1,15 @@
 #include "algorithm.h"
 #include <input/input.h>
+#include <input/sharedmemoryinput.h>
 #include <segmentation/staticmap.h>
+#include <segmentation/planeremoval.h>
+#include <segmentation/backgroundsnapshot.h>
 #include <segmentation/connectedcomponentlabeling.h>
 #include <segmentation/tracking.h>
 #include <tracking/fitting.h>
 
 #include <utils/streamreader.h>
+#include <utils/exception.h>
 
 #include <utils/utils.h>
 
@@ -22,11 +26,16 @@ StreamReader foregroundReader("d:/sequences/scene1/foreground.seq", startFrame,
 cv::Mat projectionMatrix;
 
 Algorithm::Algorithm(int width, int height)
-    : m_width(width),
+    : m_sharedMemoryInput(0),
+      m_snapshotWriter(0),
+      m_snapshotInterval(0),
+      m_framesSinceSnapshot(0),
+      m_width(width),
       m_height(height)
 {
     m_input = new Input(width, height);
     m_staticMap = new StaticMap();
+    m_planeRemoval = new PlaneRemoval();
     m_ccLabelling = new ConnectedComponentLabeling();
     m_tracking = new Tracking();
     m_fitting = new Fitting();
@@ -45,14 +54,23 @@ Algorithm::Algorithm(int width, int height)
 
 Algorithm::~Algorithm()
 {
+    // keep the latest background for the next start
+    if (m_snapshotWriter) {
+        writeBackgroundSnapshot();
+        delete m_snapshotWriter;
+    }
+
+    delete m_sharedMemoryInput;
     delete m_input;
     delete m_ccLabelling;
     delete m_staticMap;
+    delete m_planeRemoval;
     delete m_tracking;
     delete m_fitting;
 }
 
-bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize)
+bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize,
+                        const FrameInfo& frameInfo)
 {
     UNUSED(depthData);
     UNUSED(depthDataSize);
@@ -64,6 +82,10 @@ bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData,
     if (!cameraReader.read(cameraImages) || !foregroundReader.read(foreground))
         return false;
 
+    // only frames that are processed are traced
+    FrameInfo currentFrameInfo = frameInfo;
+    FrameTrace trace(m_latencyTracer, currentFrameInfo);
+
     m_depthMap = cameraImages[0];
     cv::Mat pointCloud = cameraImages[1];
 
@@ -84,39 +106,151 @@ bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData,
 //    if (cv::waitKey(1) == 27)
 //        return false;
 
+    // the scene now belongs to this frame
+    m_frameInfo = currentFrameInfo;
+    trace.end(m_frameInfo);
+
     return true;
 }
 
-/*bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize)
+/*bool Algorithm::process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize,
+                        const FrameInfo& frameInfo)
 {
+    FrameInfo currentFrameInfo = frameInfo;
+    FrameTrace trace(m_latencyTracer, currentFrameInfo);
+
     // process input data to create OpenCV images from it and reconstruct the projection matrix
-    m_input->process(depthData, depthDataSize, pointsData, pointsDataSize);
+    m_input->process(depthData, depthDataSize, pointsData, pointsDataSize, currentFrameInfo);
+
+    if (processInput())
+        trace.end(m_frameInfo);
+
+    return true;
+}*/
+
+void Algorithm::attachSharedMemory(const std::string& name)
+{
+    delete m_sharedMemoryInput;
+    m_sharedMemoryInput = 0;
+    m_sharedMemoryInput = new SharedMemoryInput(name, m_width, m_height);
+}
+
+bool Algorithm::processSharedMemory()
+{
+    if (!m_sharedMemoryInput)
+        throw Exception("no shared memory attached");
 
-    if (m_input->ready()) {
-        const cv::Mat& depthMap = m_input->getDepthMap();
-        const cv::Mat& pointCloud = m_input->getPointCloud();
-        const cv::Mat& projectionMatrix = m_input->getProjectionMatrix();
+    // keep the current frame (which is still referenced by the images) if there is no new one
+    if (!m_sharedMemoryInput->hasNewFrame())
+        return false;
+
+    m_sharedMemoryInput->release();
 
-        // process the depth data and compute a static background
-        m_staticMap->process(depthMap);
+    SharedMemoryFrame frame;
+    if (!m_sharedMemoryInput->acquire(frame))
+        return false;
 
-        const cv::Mat& foreground = m_staticMap->getForeground();
+    // the frame is only traced if it is processed completely, i.e. not if the input is not ready
+    // yet or a module throws
+    FrameInfo frameInfo;
+    frameInfo.timestamp = frame.timestamp;
+    frameInfo.sequence = frame.sequence;
+    FrameTrace trace(m_latencyTracer, frameInfo);
 
-        // detect connected components
-        m_ccLabelling->process(foreground, pointCloud);
+    // wrap the frame data without copying it
+    m_input->processInPlace(frame.depthData, frame.pointsData, frameInfo);
 
-        const cv::Mat& labelMap = m_ccLabelling->getLabelMap();
-        std::vector<std::shared_ptr<ConnectedComponent>> components = m_ccLabelling->getComponents();
+    if (processInput())
+        trace.end(m_frameInfo);
 
-        // cluster components and track the users
-        m_tracking->process(depthMap, labelMap, components, projectionMatrix);
+    return true;
+}
+
+bool Algorithm::loadBackgroundSnapshot(const std::string& filename)
+{
+    // a snapshot that can not be read, does not match the camera or does not describe a valid
+    // background model is ignored, the background is learned from scratch then
+    try {
+        BackgroundState state;
+        if (!BackgroundSnapshot::load(filename, m_height, m_width, state))
+            return false;
 
-        // fit a skeleton inside each user
-        m_fitting->process(depthMap, pointCloud, labelMap, projectionMatrix);
+        m_staticMap->setState(state);
+    }
+    catch (...) {
+        return false;
     }
 
     return true;
-}*/
+}
+
+void Algorithm::setBackgroundSnapshot(const std::string& filename, int interval)
+{
+    delete m_snapshotWriter;
+    m_snapshotWriter = new BackgroundSnapshotWriter(filename);
+    m_snapshotInterval = interval;
+    m_framesSinceSnapshot = 0;
+}
+
+void Algorithm::setUserTracking(bool enabled)
+{
+    m_ccLabelling->setTemporalLabels(enabled);
+    m_tracking->setTemporalComponentLabels(enabled);
+    m_tracking->setObjectTracking(enabled);
+}
+
+void Algorithm::writeBackgroundSnapshot()
+{
+    // nothing has been learned yet
+    if (!m_staticMap->hasBackground())
+        return;
+
+    BackgroundState state;
+    m_staticMap->getState(state);
+    m_snapshotWriter->write(state);
+    m_framesSinceSnapshot = 0;
+}
+
+bool Algorithm::processInput()
+{
+    if (!m_input->ready())
+        return false;
+
+    const cv::Mat& depthMap = m_input->getDepthMap();
+    const cv::Mat& pointCloud = m_input->getPointCloud();
+    const cv::Mat& projectionMatrix = m_input->getProjectionMatrix();
+    m_depthMap = depthMap;
+
+    // process the depth data and compute a static background
+    m_staticMap->process(depthMap);
+
+    if (m_snapshotWriter && m_snapshotInterval > 0 && ++m_framesSinceSnapshot >= m_snapshotInterval)
+        writeBackgroundSnapshot();
+
+    // remove the foreground pixels on the floor and the walls, the foreground tiles of the static
+    // map still cover all remaining pixels
+    m_planeRemoval->process(m_staticMap->getForeground(), pointCloud, &m_staticMap->getForegroundTiles(), StaticMap::TILE_SIZE);
+    const cv::Mat& foreground = m_planeRemoval->getForeground();
+
+    // detect connected components, only the tiles with foreground have to be searched, the
+    // metric area of the components needs the focal length (without the direction of the axes)
+    const cv::Vec2f focalLength = m_input->getFocalLength();
+    m_ccLabelling->setFocalLength(fabs(focalLength[0]), fabs(focalLength[1]));
+    m_ccLabelling->process(foreground, pointCloud, &m_staticMap->getForegroundTiles(), StaticMap::TILE_SIZE);
+
+    const cv::Mat& labelMap = m_ccLabelling->getLabelMap();
+    const std::vector<std::shared_ptr<ConnectedComponent>>& components = m_ccLabelling->getComponents();
+
+    // cluster components and track the users
+    m_tracking->process(foreground, labelMap, components, projectionMatrix);
+
+    // fit a skeleton inside each user
+    m_fitting->process(foreground, pointCloud, m_tracking->getClusters(), m_tracking->getLabelMap(), projectionMatrix);
+
+    // the scene now belongs to this frame
+    m_frameInfo = m_input->getFrameInfo();
+    return true;
+}
 
 bool Algorithm::getImage(PoseImageType type, int* width, int* height, int* size, void** data)
 {
@@ -157,4 +291,14 @@ bool Algorithm::getImage(PoseImageType type, int* width, int* height, int* size,
 
     return true;
 }
+
+const FrameInfo& Algorithm::getFrameInfo() const
+{
+    return m_frameInfo;
+}
+
+const LatencyTracer& Algorithm::getLatencyTracer() const
+{
+    return m_latencyTracer;
+}
 }
@@ -3,14 +3,19 @@
 
 #include <opencv2/opencv.hpp>
 #include "pose.h"
+#include <utils/frameinfo.h>
+#include <utils/latencytracer.h>
 
 namespace pose
 {
 class Input;
 class StaticMap;
+class PlaneRemoval;
 class ConnectedComponentLabeling;
 class Tracking;
 class Fitting;
+class SharedMemoryInput;
+class BackgroundSnapshotWriter;
 
 class Algorithm
 {
@@ -18,21 +23,76 @@ public:
     Algorithm(int width, int height);
     ~Algorithm();
 
-    bool process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize);
+    bool process(float* depthData, int depthDataSize, float* pointsData, int pointsDataSize,
+                 const FrameInfo& frameInfo);
+
+    /**
+     * @brief Attach to a shared memory ring buffer of a capture process (see sharedmemoryring.h).
+     */
+    void attachSharedMemory(const std::string& name);
+
+    /**
+     * @brief Process the next frame of the shared memory ring buffer in place. The frame is
+     * handed back to the capture process when the next frame is processed. Returns false if
+     * no new frame is available.
+     */
+    bool processSharedMemory();
+
+    /**
+     * @brief Continue with the background model of a snapshot file instead of learning a new
+     * background. Returns false if there is no valid snapshot for this image size.
+     */
+    bool loadBackgroundSnapshot(const std::string& filename);
+
+    /**
+     * @brief Write a snapshot of the background model every interval frames and when the
+     * algorithm is destroyed. The file is written on a separate thread.
+     */
+    void setBackgroundSnapshot(const std::string& filename, int interval);
+
+    /**
+     * @brief Track the components over time and cluster them into users instead of treating all
+     * components as a single user. The component labels are kept stable across frames then, so
+     * most components are assigned to their objects by label.
+     */
+    void setUserTracking(bool enabled);
 
     bool getImage(PoseImageType type, int* width, int* height, int* size, void** data);
 
+    /**
+     * @brief Get the timestamp and sequence number of the frame the current scene belongs to.
+     */
+    const FrameInfo& getFrameInfo() const;
+
+    const LatencyTracer& getLatencyTracer() const;
+
 private:
+    /**
+     * @brief Process the current frame of the input with all modules. Returns false if the input
+     * is not ready yet.
+     */
+    bool processInput();
+    void writeBackgroundSnapshot();
+
     Input* m_input;
+    SharedMemoryInput* m_sharedMemoryInput;
     StaticMap* m_staticMap;
+    PlaneRemoval* m_planeRemoval;
     ConnectedComponentLabeling* m_ccLabelling;
     Tracking* m_tracking;
     Fitting* m_fitting;
+    BackgroundSnapshotWriter* m_snapshotWriter;
+
+    int m_snapshotInterval;
+    int m_framesSinceSnapshot;
 
     int m_width;
     int m_height;
 
     cv::Mat m_depthMap;
+
+    FrameInfo m_frameInfo;
+    LatencyTracer m_latencyTracer;
 };
 }
 
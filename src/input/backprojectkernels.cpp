@@ -0,0 +1,154 @@
+#include "backprojectkernels.h"
+#include <cstring>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+// ---------------------------------------------------------------------------------------------
+// scalar fallback, also used for the remaining pixels at the end of each row
+// ---------------------------------------------------------------------------------------------
+
+static void backProjectRowScalar(const float* depth, const unsigned char* mask, const float* rayX,
+                                 float rayY, float* points, int cols)
+{
+    for (int j = 0; j < cols; j++) {
+        const float z = !mask || mask[j] ? depth[j] : 0.0f;
+        points[j * 3 + 0] = rayX[j] * z;
+        points[j * 3 + 1] = rayY * z;
+        points[j * 3 + 2] = z;
+    }
+}
+
+#ifdef POSE_SIMD_X86
+
+// ---------------------------------------------------------------------------------------------
+// SSE4.1
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("sse4.1")
+static inline __m128 loadMaskSSE41(const unsigned char* mask)
+{
+    // widen 4 bytes to 4 lanes that are all set where the mask is set
+    int bytes;
+    memcpy(&bytes, mask, sizeof(int));
+    const __m128i mask32 = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(mask32, _mm_setzero_si128()));
+}
+
+POSE_TARGET("sse4.1")
+static void backProjectRowSSE41(const float* depth, const unsigned char* mask, const float* rayX,
+                                float rayY, float* points, int cols)
+{
+    const __m128 ry = _mm_set1_ps(rayY);
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        __m128 z = _mm_loadu_ps(depth + j);
+        if (mask)
+            z = _mm_and_ps(z, loadMaskSSE41(mask + j));
+
+        const __m128 x = _mm_mul_ps(_mm_loadu_ps(rayX + j), z);
+        const __m128 y = _mm_mul_ps(ry, z);
+
+        // interleave to x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        const __m128 xy01 = _mm_unpacklo_ps(x, y);
+        const __m128 xy23 = _mm_unpackhi_ps(x, y);
+        const __m128 z0x1 = _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 y1z1 = _mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));
+        const __m128 z2x3 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 y3z3 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));
+
+        float* p = points + j * 3;
+        _mm_storeu_ps(p + 0, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(p + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(p + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+
+    backProjectRowScalar(depth + j, mask ? mask + j : 0, rayX + j, rayY, points + j * 3, cols - j);
+}
+
+// ---------------------------------------------------------------------------------------------
+// AVX2
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("avx2")
+static inline __m256 loadMaskAVX2(const unsigned char* mask)
+{
+    // widen 8 bytes to 8 lanes that are all set where the mask is set
+    const __m256i mask32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)mask));
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(mask32, _mm256_setzero_si256()));
+}
+
+POSE_TARGET("avx2")
+static void backProjectRowAVX2(const float* depth, const unsigned char* mask, const float* rayX,
+                               float rayY, float* points, int cols)
+{
+    const __m256 ry = _mm256_set1_ps(rayY);
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        __m256 z = _mm256_loadu_ps(depth + j);
+        if (mask)
+            z = _mm256_and_ps(z, loadMaskAVX2(mask + j));
+
+        const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(rayX + j), z);
+        const __m256 y = _mm256_mul_ps(ry, z);
+
+        // the shuffles work within each 128 bit lane, so this interleaves the points 0-3 in the
+        // lower and the points 4-7 in the upper lanes like the SSE4.1 version
+        const __m256 xy01 = _mm256_unpacklo_ps(x, y);
+        const __m256 xy23 = _mm256_unpackhi_ps(x, y);
+        const __m256 z0x1 = _mm256_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m256 y1z1 = _mm256_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));
+        const __m256 z2x3 = _mm256_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m256 y3z3 = _mm256_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));
+
+        const __m256 out0 = _mm256_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0));
+        const __m256 out1 = _mm256_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0));
+        const __m256 out2 = _mm256_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0));
+
+        // reorder the lanes to the points 0-7
+        float* p = points + j * 3;
+        _mm256_storeu_ps(p + 0, _mm256_permute2f128_ps(out0, out1, 0x20));
+        _mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(out2, out0, 0x30));
+        _mm256_storeu_ps(p + 16, _mm256_permute2f128_ps(out1, out2, 0x31));
+    }
+
+    backProjectRowScalar(depth + j, mask ? mask + j : 0, rayX + j, rayY, points + j * 3, cols - j);
+}
+
+#endif // POSE_SIMD_X86
+
+BackProjectKernels BackProjectKernels::get(CpuFeatures::InstructionSet instructionSet)
+{
+    BackProjectKernels kernels;
+    kernels.instructionSet = CpuFeatures::IS_SCALAR;
+    kernels.backProjectRow = backProjectRowScalar;
+
+#ifdef POSE_SIMD_X86
+    switch (instructionSet) {
+    case CpuFeatures::IS_AVX512:
+        // there are no AVX-512 kernels, the AVX2 ones are used
+    case CpuFeatures::IS_AVX2:
+        kernels.instructionSet = CpuFeatures::IS_AVX2;
+        kernels.backProjectRow = backProjectRowAVX2;
+        break;
+    case CpuFeatures::IS_AVX:
+        // there are no AVX kernels, the SSE4.1 ones are used
+    case CpuFeatures::IS_SSE41:
+        kernels.instructionSet = CpuFeatures::IS_SSE41;
+        kernels.backProjectRow = backProjectRowSSE41;
+        break;
+    case CpuFeatures::IS_SCALAR:
+        break;
+    }
+#else
+    (void)instructionSet;
+#endif
+
+    return kernels;
+}
+}
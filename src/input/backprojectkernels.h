@@ -0,0 +1,35 @@
+#ifndef BACKPROJECTKERNELS_H
+#define BACKPROJECTKERNELS_H
+
+#include <utils/cpufeatures.h>
+
+namespace pose
+{
+/**
+ * @brief Row kernel of the back-projection in Input. The points are stored interleaved (x, y, z),
+ * so the vector versions compute 4 (SSE4.1) or 8 (AVX2) points at once and shuffle them into
+ * place instead of storing each coordinate on its own. Each version produces the same results as
+ * the scalar fallback, the best version is selected at runtime.
+ */
+struct BackProjectKernels
+{
+    /**
+     * @brief Writes the point (rayX * z, rayY * z, z) of each pixel of the row, z is the depth of
+     * the pixel or 0 if the mask is given and not set. Invalid depth values (0) result in a zero
+     * point.
+     */
+    typedef void (*BackProjectRowFunc)(const float* depth, const unsigned char* mask, const float* rayX,
+                                       float rayY, float* points, int cols);
+
+    CpuFeatures::InstructionSet instructionSet;
+    BackProjectRowFunc backProjectRow;
+
+    /**
+     * @brief Get the kernels for the given instruction set or the best available if the
+     * instruction set is not supported by the build.
+     */
+    static BackProjectKernels get(CpuFeatures::InstructionSet instructionSet);
+};
+}
+
+#endif // BACKPROJECTKERNELS_H
@@ -0,0 +1,192 @@
+#include "depthfilter.h"
+#include <utils/exception.h>
+#include <utils/threadpool.h>
+
+namespace pose
+{
+// NOTE: the median computations are implemented as sorting networks on min/max operations, so the
+// row loops below are branch-free and get vectorized by the compiler.
+#define DEPTH_SORT(a, b) { const float t = std::min(a, b); b = std::max(a, b); a = t; }
+
+static inline float median3(float a, float b, float c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+static inline float median5(float a, float b, float c, float d, float e)
+{
+    DEPTH_SORT(a, b); DEPTH_SORT(d, e); DEPTH_SORT(a, d);
+    DEPTH_SORT(b, e); DEPTH_SORT(b, c); DEPTH_SORT(c, d);
+    DEPTH_SORT(b, c);
+    return c;
+}
+
+static inline float median9(float p0, float p1, float p2, float p3, float p4,
+                            float p5, float p6, float p7, float p8)
+{
+    DEPTH_SORT(p1, p2); DEPTH_SORT(p4, p5); DEPTH_SORT(p7, p8);
+    DEPTH_SORT(p0, p1); DEPTH_SORT(p3, p4); DEPTH_SORT(p6, p7);
+    DEPTH_SORT(p1, p2); DEPTH_SORT(p4, p5); DEPTH_SORT(p7, p8);
+    DEPTH_SORT(p0, p3); DEPTH_SORT(p5, p8); DEPTH_SORT(p4, p7);
+    DEPTH_SORT(p3, p6); DEPTH_SORT(p1, p4); DEPTH_SORT(p2, p5);
+    DEPTH_SORT(p4, p7); DEPTH_SORT(p4, p2); DEPTH_SORT(p6, p4);
+    DEPTH_SORT(p4, p2);
+    return p4;
+}
+
+#undef DEPTH_SORT
+
+DepthFilter::DepthFilter()
+    : Module("DepthFilter"),
+      m_historyIndex(0),
+      m_historySize(0)
+{
+    setTemporalFrames(3);
+    setMotionThreshold(0.1f);
+    setHoleFilling(true);
+    setNumBands(ThreadPool::instance().getNumThreads());
+}
+
+DepthFilter::~DepthFilter()
+{
+}
+
+void DepthFilter::setTemporalFrames(int frames)
+{
+    if (frames != 1 && frames != 3 && frames != 5)
+        throw Exception("invalid number of temporal frames");
+
+    m_temporalFrames = frames;
+    reset();
+}
+
+void DepthFilter::setMotionThreshold(float threshold)
+{
+    m_motionThreshold = threshold;
+}
+
+void DepthFilter::setHoleFilling(bool enabled)
+{
+    m_holeFilling = enabled;
+}
+
+void DepthFilter::setNumBands(int numBands)
+{
+    m_numBands = std::max(1, numBands);
+}
+
+void DepthFilter::reset()
+{
+    m_history.clear();
+    m_historyIndex = 0;
+    m_historySize = 0;
+}
+
+void DepthFilter::process(cv::Mat& depthMap)
+{
+    begin();
+
+    if (depthMap.type() != CV_32F)
+        throw Exception("invalid depth map");
+
+    if (m_filtered.cols != depthMap.cols || m_filtered.rows != depthMap.rows) {
+        m_filtered = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
+        reset();
+    }
+
+    if (m_temporalFrames > 1)
+        temporalMedian(depthMap);
+
+    if (m_holeFilling)
+        fillHoles(depthMap);
+
+    end();
+}
+
+void DepthFilter::temporalMedian(cv::Mat& depthMap)
+{
+    // store the unfiltered frame in the history ring buffer
+    if ((int)m_history.size() != m_temporalFrames)
+        m_history.resize(m_temporalFrames);
+
+    depthMap.copyTo(m_history[m_historyIndex]);
+    m_historyIndex = (m_historyIndex + 1) % m_temporalFrames;
+    if (m_historySize < m_temporalFrames)
+        m_historySize++;
+
+    // not enough frames yet
+    if (m_historySize < m_temporalFrames)
+        return;
+
+    // Invalid values (0) are sorted to the front, so the median only becomes invalid if the
+    // majority of the samples is invalid. Pixels that moved more than the motion threshold keep
+    // their current value.
+    const int cols = depthMap.cols;
+    const float threshold = m_motionThreshold;
+
+    ThreadPool::instance().parallelFor(0, depthMap.rows, m_numBands, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            float* depthRow = depthMap.ptr<float>(i);
+            const float* row0 = m_history[0].ptr<float>(i);
+            const float* row1 = m_history[1].ptr<float>(i);
+            const float* row2 = m_history[2].ptr<float>(i);
+
+            if (m_temporalFrames == 3) {
+                for (int j = 0; j < cols; j++) {
+                    const float current = depthRow[j];
+                    const float median = median3(row0[j], row1[j], row2[j]);
+                    const bool moving = current > 0 && fabs(current - median) > threshold;
+                    depthRow[j] = moving ? current : median;
+                }
+            }
+            else {
+                const float* row3 = m_history[3].ptr<float>(i);
+                const float* row4 = m_history[4].ptr<float>(i);
+
+                for (int j = 0; j < cols; j++) {
+                    const float current = depthRow[j];
+                    const float median = median5(row0[j], row1[j], row2[j], row3[j], row4[j]);
+                    const bool moving = current > 0 && fabs(current - median) > threshold;
+                    depthRow[j] = moving ? current : median;
+                }
+            }
+        }
+    });
+}
+
+void DepthFilter::fillHoles(cv::Mat& depthMap)
+{
+    // Invalid pixels are replaced by the median of their 3x3 neighborhood. As the invalid center
+    // takes part in the median, a hole is only filled if at least five neighbors are valid. This
+    // closes single pixel holes and speckle but keeps larger invalid regions, e.g. shadows.
+    const int cols = depthMap.cols;
+    const int rows = depthMap.rows;
+
+    ThreadPool::instance().parallelFor(0, rows, m_numBands, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const float* srcRow = depthMap.ptr<float>(i);
+            float* dstRow = m_filtered.ptr<float>(i);
+
+            if (i == 0 || i == rows - 1) {
+                memcpy(dstRow, srcRow, cols * sizeof(float));
+                continue;
+            }
+
+            const float* prevRow = depthMap.ptr<float>(i - 1);
+            const float* nextRow = depthMap.ptr<float>(i + 1);
+
+            dstRow[0] = srcRow[0];
+            dstRow[cols - 1] = srcRow[cols - 1];
+
+            for (int j = 1; j < cols - 1; j++) {
+                const float median = median9(prevRow[j - 1], prevRow[j], prevRow[j + 1],
+                                             srcRow[j - 1], srcRow[j], srcRow[j + 1],
+                                             nextRow[j - 1], nextRow[j], nextRow[j + 1]);
+                dstRow[j] = srcRow[j] > 0 ? srcRow[j] : median;
+            }
+        }
+    });
+
+    m_filtered.copyTo(depthMap);
+}
+}
@@ -0,0 +1,68 @@
+#ifndef DEPTHFILTER_H
+#define DEPTHFILTER_H
+
+#include <opencv2/opencv.hpp>
+#include <utils/module.h>
+
+namespace pose
+{
+/**
+ * @brief Optional pre-stage that removes flicker and small holes from the raw depth map before
+ * it is processed by any other module. It consists of a temporal median over the last frames and
+ * a spatial 3x3 median that is only applied to invalid pixels (depth value 0).
+ */
+class DepthFilter
+        : public Module
+{
+public:
+    DepthFilter();
+    ~DepthFilter();
+
+    /**
+     * @brief Sets the number of frames that are used for the temporal median. Allowed values
+     * are 1 (temporal filtering disabled), 3 and 5.
+     */
+    void setTemporalFrames(int frames);
+
+    /**
+     * @brief Sets the maximum distance between the current depth value and the temporal median.
+     * If the current value differs more, the pixel is considered to be moving and is not filtered
+     * to preserve edges and to avoid lagging behind moving objects.
+     */
+    void setMotionThreshold(float threshold);
+
+    /**
+     * @brief Enables or disables filling of invalid pixels with the spatial median.
+     */
+    void setHoleFilling(bool enabled);
+
+    /**
+     * @brief Sets the number of horizontal bands the depth map is split into to be filtered in
+     * parallel on the shared thread pool. Defaults to the number of threads of the pool.
+     */
+    void setNumBands(int numBands);
+
+    void reset();
+
+    /**
+     * @brief Filter the given depth map in place.
+     */
+    void process(cv::Mat& depthMap);
+
+private:
+    void temporalMedian(cv::Mat& depthMap);
+    void fillHoles(cv::Mat& depthMap);
+
+    std::vector<cv::Mat> m_history;
+    int m_historyIndex;
+    int m_historySize;
+    cv::Mat m_filtered;
+
+    int     m_temporalFrames;
+    float   m_motionThreshold;
+    bool    m_holeFilling;
+    int     m_numBands;
+};
+}
+
+#endif // DEPTHFILTER_H
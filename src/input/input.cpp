@@ -1,43 +1,128 @@
 #include "input.h"
+#include "depthfilter.h"
+#include "backprojectkernels.h"
 #include <utils/exception.h>
+#include <utils/threadpool.h>
 
 namespace pose
 {
 Input::Input(int width, int height)
     : Module("Input"),
+      m_depthFilter(0),
+      m_depthFilterEnabled(false),
+      m_hasIntrinsics(false),
+      m_fx(0),
+      m_fy(0),
+      m_cx(0),
+      m_cy(0),
       m_width(width),
       m_height(height)
 {
-    m_depthMap = cv::Mat(m_height, m_width, CV_32F);
-    m_pointCloud = cv::Mat(m_height, m_width, CV_32FC3);
+    m_depthBuffer = cv::Mat(m_height, m_width, CV_32F);
+    m_pointBuffer = cv::Mat(m_height, m_width, CV_32FC3);
+    m_depthMap = m_depthBuffer;
+    m_pointCloud = m_pointBuffer;
+    m_depthFilter = new DepthFilter();
+    setNumBands(ThreadPool::instance().getNumThreads());
 }
 
 Input::~Input()
 {
+    delete m_depthFilter;
     m_depthMap.release();
     m_pointCloud.release();
+    m_depthBuffer.release();
+    m_pointBuffer.release();
 }
 
-void Input::process(const float* depthData, int depthDataSize, const float* pointsData, int pointsDataSize)
+void Input::process(const float* depthData, int depthDataSize, const float* pointsData, int pointsDataSize,
+                    const FrameInfo& frameInfo)
 {
     begin();
 
+    m_frameInfo = frameInfo;
+
     // check data sizes
-    if (depthDataSize * sizeof(float) != m_depthMap.cols * m_depthMap.rows * m_depthMap.elemSize() ||
-        pointsDataSize * sizeof(float) != m_pointCloud.cols * m_pointCloud.rows * m_pointCloud.elemSize())
+    if (depthDataSize * sizeof(float) != m_depthBuffer.cols * m_depthBuffer.rows * m_depthBuffer.elemSize() ||
+        (pointsData && pointsDataSize * sizeof(float) != m_pointBuffer.cols * m_pointBuffer.rows * m_pointBuffer.elemSize()))
         throw Exception("invalid input data size(s)");
 
     // copy data
+    m_depthMap = m_depthBuffer;
     memcpy(m_depthMap.data, depthData, depthDataSize * sizeof(float));
-    memcpy(m_pointCloud.data, pointsData, pointsDataSize * sizeof(float));
 
-    // compute projection matrix
-    if (!m_pointCloud.empty() && m_projectionMatrix.empty())
-        m_projectionMatrix = computeProjectionMatrix(m_pointCloud);
+    if (pointsData) {
+        m_pointCloud = m_pointBuffer;
+        memcpy(m_pointCloud.data, pointsData, pointsDataSize * sizeof(float));
+    }
+
+    update(pointsData != 0);
+
+    end();
+}
+
+void Input::processInPlace(float* depthData, const float* pointsData, const FrameInfo& frameInfo)
+{
+    begin();
+
+    m_frameInfo = frameInfo;
+
+    // only wrap the data, it has to stay valid until the next frame is processed
+    m_depthMap = cv::Mat(m_height, m_width, CV_32F, depthData);
+    if (pointsData)
+        m_pointCloud = cv::Mat(m_height, m_width, CV_32FC3, const_cast<float*>(pointsData));
+
+    update(pointsData != 0);
 
     end();
 }
 
+void Input::update(bool hasPoints)
+{
+    // remove flicker and holes before any other module sees the depth map
+    if (m_depthFilterEnabled)
+        m_depthFilter->process(m_depthMap);
+
+    if (hasPoints) {
+        // compute projection matrix and derive the intrinsics from it
+        if (m_projectionMatrix.empty()) {
+            m_projectionMatrix = computeProjectionMatrix(m_pointCloud);
+            computeIntrinsics(m_projectionMatrix);
+        }
+
+        // keep the point cloud consistent with the filtered depth map
+        if (m_depthFilterEnabled && m_hasIntrinsics) {
+            m_pointCloud = m_pointBuffer;
+            backProject(m_depthMap, m_pointCloud);
+        }
+    }
+    else if (m_hasIntrinsics) {
+        // the caller did not provide a point cloud, so compute it from the depth map
+        m_pointCloud = m_pointBuffer;
+        backProject(m_depthMap, m_pointCloud);
+    }
+    else
+        throw Exception("no point cloud given and no intrinsics available yet");
+}
+
+void Input::setDepthFilterEnabled(bool enabled)
+{
+    if (enabled && !m_depthFilterEnabled)
+        m_depthFilter->reset();
+
+    m_depthFilterEnabled = enabled;
+}
+
+void Input::setNumBands(int numBands)
+{
+    m_numBands = std::max(1, numBands);
+}
+
+DepthFilter* Input::getDepthFilter() const
+{
+    return m_depthFilter;
+}
+
 const bool Input::ready() const
 {
     return !m_depthMap.empty() && !m_pointCloud.empty() && !m_projectionMatrix.empty();
@@ -58,6 +143,79 @@ const cv::Mat& Input::getProjectionMatrix() const
     return m_projectionMatrix;
 }
 
+const FrameInfo& Input::getFrameInfo() const
+{
+    return m_frameInfo;
+}
+
+bool Input::hasIntrinsics() const
+{
+    return m_hasIntrinsics;
+}
+
+cv::Vec2f Input::getFocalLength() const
+{
+    return m_hasIntrinsics ? cv::Vec2f(m_fx, m_fy) : cv::Vec2f(0, 0);
+}
+
+void Input::backProject(const cv::Mat& depthMap, cv::Mat& pointCloud, const cv::Mat& mask) const
+{
+    if (!m_hasIntrinsics)
+        throw Exception("intrinsics are not available");
+
+    if (depthMap.type() != CV_32F || depthMap.cols != (int)m_rayX.size() || depthMap.rows != (int)m_rayY.size())
+        throw Exception("invalid depth map");
+
+    if (!mask.empty() && (mask.type() != CV_8U || mask.cols != depthMap.cols || mask.rows != depthMap.rows))
+        throw Exception("invalid mask");
+
+    if (pointCloud.cols != depthMap.cols || pointCloud.rows != depthMap.rows || pointCloud.type() != CV_32FC3)
+        pointCloud = cv::Mat(depthMap.rows, depthMap.cols, CV_32FC3);
+
+    const BackProjectKernels kernels = BackProjectKernels::get(CpuFeatures::getInstructionSet());
+    const float* rayX = &m_rayX[0];
+
+    ThreadPool::instance().parallelFor(0, depthMap.rows, m_numBands, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const uchar* maskRow = mask.empty() ? 0 : mask.ptr<uchar>(i);
+            kernels.backProjectRow(depthMap.ptr<float>(i), maskRow, rayX, m_rayY[i], pointCloud.ptr<float>(i), depthMap.cols);
+        }
+    });
+}
+
+void Input::computeIntrinsics(const cv::Mat& projectionMatrix)
+{
+    m_hasIntrinsics = false;
+
+    if (projectionMatrix.empty())
+        return;
+
+    // The point cloud is given in camera coordinates, so the projection matrix is K * [I|0] up to
+    // scale, i.e. the intrinsics can directly be read from the left 3x3 part after normalization.
+    const float scale = projectionMatrix.ptr<float>(2)[2];
+    if (fabs(scale) < 1e-6f)
+        return;
+
+    m_fx = projectionMatrix.ptr<float>(0)[0] / scale;
+    m_fy = projectionMatrix.ptr<float>(1)[1] / scale;
+    m_cx = projectionMatrix.ptr<float>(0)[2] / scale;
+    m_cy = projectionMatrix.ptr<float>(1)[2] / scale;
+
+    if (fabs(m_fx) < 1e-6f || fabs(m_fy) < 1e-6f)
+        return;
+
+    // precompute the ray factors so that back-projection only needs one multiplication per coordinate
+    m_rayX.resize(m_width);
+    for (int j = 0; j < m_width; j++)
+        m_rayX[j] = (j - m_cx) / m_fx;
+
+    m_rayY.resize(m_height);
+    for (int i = 0; i < m_height; i++)
+        m_rayY[i] = (i - m_cy) / m_fy;
+
+    m_hasIntrinsics = true;
+}
+
 cv::Mat Input::computeProjectionMatrix(const cv::Mat& pointCloud) const
 {
     if (pointCloud.empty() || pointCloud.type() != CV_32FC3)
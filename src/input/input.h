@@ -3,9 +3,12 @@
 
 #include <opencv2/opencv.hpp>
 #include <utils/module.h>
+#include <utils/frameinfo.h>
 
 namespace pose
 {
+class DepthFilter;
+
 class Input
         : public Module
 {
@@ -13,7 +16,38 @@ public:
     Input(int width, int height);
     ~Input();
 
-    void process(const float* depthData, int depthDataSize, const float* pointsData, int pointsDataSize);
+    /**
+     * @brief Process a new frame. The point cloud may be omitted (pointsData is NULL) as soon as
+     * the camera intrinsics have been derived from the projection matrix. In that case, the point
+     * cloud is computed from the depth map by back-projection.
+     */
+    void process(const float* depthData, int depthDataSize, const float* pointsData, int pointsDataSize,
+                 const FrameInfo& frameInfo);
+
+    /**
+     * @brief Process a new frame without copying it. The depth map and point cloud only wrap the
+     * given data, which therefore has to stay valid until the next frame is processed. If the
+     * depth filter is enabled, the depth data is modified in place.
+     */
+    void processInPlace(float* depthData, const float* pointsData, const FrameInfo& frameInfo);
+
+    /**
+     * @brief Enables the depth filter pre-stage that removes flicker and small holes from the
+     * depth map. If the intrinsics are available, the point cloud is then computed from the
+     * filtered depth map.
+     */
+    void setDepthFilterEnabled(bool enabled);
+
+    /**
+     * @brief Sets the number of horizontal bands the depth map is split into to be back-projected
+     * in parallel on the shared thread pool. Defaults to the number of threads of the pool.
+     */
+    void setNumBands(int numBands);
+
+    /**
+     * @brief Get the depth filter to change its parameters.
+     */
+    DepthFilter* getDepthFilter() const;
 
     /**
      * @brief Check whether the device is ready to process. This is true if all
@@ -37,13 +71,55 @@ public:
      */
     const cv::Mat& getProjectionMatrix() const;
 
+    /**
+     * @brief Get the timestamp and sequence number of the most recent frame.
+     */
+    const FrameInfo& getFrameInfo() const;
+
+    /**
+     * @brief Check whether the camera intrinsics have been derived from the projection matrix,
+     * i.e. whether the point cloud can be computed from the depth map alone.
+     */
+    bool hasIntrinsics() const;
+
+    /**
+     * @brief Get the focal length (fx, fy) in pixels of the camera intrinsics. The sign is the
+     * direction of the image axes. Both are 0 as long as hasIntrinsics() is false.
+     */
+    cv::Vec2f getFocalLength() const;
+
+    /**
+     * @brief Compute the organized point cloud (CV_32FC3) from the given depth map by using
+     * the camera intrinsics. If a mask is given, only points with a non-zero mask value are
+     * computed, all other points are set to 0.
+     */
+    void backProject(const cv::Mat& depthMap, cv::Mat& pointCloud, const cv::Mat& mask = cv::Mat()) const;
+
 private:
+    void update(bool hasPoints);
     cv::Mat computeProjectionMatrix(const cv::Mat& pointCloud) const;
+    void computeIntrinsics(const cv::Mat& projectionMatrix);
 
     cv::Mat m_depthMap;
     cv::Mat m_pointCloud;
+    cv::Mat m_depthBuffer;
+    cv::Mat m_pointBuffer;
     cv::Mat m_projectionMatrix;
+    FrameInfo m_frameInfo;
+
+    DepthFilter* m_depthFilter;
+    bool m_depthFilterEnabled;
+
+    // camera intrinsics and the per-column / per-row ray factors (u - cx) / fx and (v - cy) / fy
+    bool m_hasIntrinsics;
+    float m_fx;
+    float m_fy;
+    float m_cx;
+    float m_cy;
+    std::vector<float> m_rayX;
+    std::vector<float> m_rayY;
 
+    int m_numBands;
     int m_width;
     int m_height;
 };
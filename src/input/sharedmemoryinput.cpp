@@ -0,0 +1,123 @@
+#include "sharedmemoryinput.h"
+#include <utils/exception.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pose
+{
+SharedMemoryInput::SharedMemoryInput(const std::string& name, int width, int height)
+    : m_name(name),
+      m_mapping(0),
+      m_mappingSize(0),
+      m_header(0),
+      m_acquired(false)
+{
+#ifdef _WIN32
+    (void)width;
+    (void)height;
+    throw Exception("shared memory input is not supported on this platform");
+#else
+    int fd = shm_open(m_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        throw Exception("could not open shared memory object " + m_name);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SharedMemoryRingHeader)) {
+        close(fd);
+        throw Exception("invalid shared memory object " + m_name);
+    }
+
+    m_mappingSize = (size_t)info.st_size;
+    m_mapping = mmap(0, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (m_mapping == MAP_FAILED) {
+        m_mapping = 0;
+        throw Exception("could not map shared memory object " + m_name);
+    }
+
+    m_header = (SharedMemoryRingHeader*)m_mapping;
+
+    // validate the header layout against the expected frame size
+    const bool initialized = m_header->magic == SHARED_MEMORY_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t slotSize = getSharedMemorySlotSize(width, height, m_header->hasPoints != 0);
+    if (!initialized ||
+        m_header->version != SHARED_MEMORY_VERSION ||
+        m_header->width != (uint32_t)width ||
+        m_header->height != (uint32_t)height ||
+        m_header->slotCount == 0 ||
+        m_header->slotSize != slotSize ||
+        m_header->dataOffset < sizeof(SharedMemoryRingHeader) ||
+        m_header->dataOffset + m_header->slotCount * m_header->slotSize > m_mappingSize) {
+        munmap(m_mapping, m_mappingSize);
+        m_mapping = 0;
+        m_header = 0;
+        throw Exception("shared memory object has an incompatible layout");
+    }
+#endif
+}
+
+SharedMemoryInput::~SharedMemoryInput()
+{
+#ifndef _WIN32
+    if (m_acquired)
+        release();
+
+    if (m_mapping)
+        munmap(m_mapping, m_mappingSize);
+#endif
+}
+
+bool SharedMemoryInput::acquire(SharedMemoryFrame& frame)
+{
+    if (m_acquired)
+        throw Exception("the previous frame has not been released");
+
+    const uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_header->head.load(std::memory_order_acquire);
+
+    // ring is empty
+    if (tail == head)
+        return false;
+
+    unsigned char* slot = (unsigned char*)m_mapping + m_header->dataOffset + (tail % m_header->slotCount) * m_header->slotSize;
+    const SharedMemorySlotHeader* slotHeader = (const SharedMemorySlotHeader*)slot;
+    float* depthData = (float*)(slot + sizeof(SharedMemorySlotHeader));
+
+    frame.depthData = depthData;
+    frame.pointsData = m_header->hasPoints ? depthData + m_header->width * m_header->height : 0;
+    frame.timestamp = slotHeader->timestamp;
+    frame.sequence = slotHeader->sequence;
+
+    m_acquired = true;
+    return true;
+}
+
+void SharedMemoryInput::release()
+{
+    if (!m_acquired)
+        return;
+
+    // the slot may now be overwritten by the producer
+    m_header->tail.fetch_add(1, std::memory_order_release);
+    m_acquired = false;
+}
+
+bool SharedMemoryInput::hasAcquiredFrame() const
+{
+    return m_acquired;
+}
+
+bool SharedMemoryInput::hasNewFrame() const
+{
+    const uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_header->head.load(std::memory_order_acquire);
+    return head - tail > (m_acquired ? 1u : 0u);
+}
+}
@@ -0,0 +1,58 @@
+#ifndef SHAREDMEMORYINPUT_H
+#define SHAREDMEMORYINPUT_H
+
+#include <string>
+#include "sharedmemoryring.h"
+
+namespace pose
+{
+/**
+ * @brief A frame inside the shared memory ring. The data is not copied and stays valid until
+ * the frame is released.
+ */
+struct SharedMemoryFrame
+{
+    float*          depthData;
+    const float*    pointsData;     // NULL if the ring does not contain point clouds
+    long long       timestamp;
+    unsigned int    sequence;
+};
+
+/**
+ * @brief Consumer side of the shared memory ring buffer (see sharedmemoryring.h). Attaches to a
+ * shared memory object that has been created by a capture process and consumes the frames in place.
+ */
+class SharedMemoryInput
+{
+public:
+    SharedMemoryInput(const std::string& name, int width, int height);
+    ~SharedMemoryInput();
+
+    /**
+     * @brief Get the oldest frame that has not been consumed yet. Returns false if the ring is
+     * empty. The frame has to be released before the next frame can be acquired.
+     */
+    bool acquire(SharedMemoryFrame& frame);
+
+    /**
+     * @brief Hand the acquired frame back to the producer.
+     */
+    void release();
+
+    bool hasAcquiredFrame() const;
+
+    /**
+     * @brief Check whether there is a frame in the ring that has not been acquired yet.
+     */
+    bool hasNewFrame() const;
+
+private:
+    std::string m_name;
+    void* m_mapping;
+    size_t m_mappingSize;
+    SharedMemoryRingHeader* m_header;
+    bool m_acquired;
+};
+}
+
+#endif // SHAREDMEMORYINPUT_H
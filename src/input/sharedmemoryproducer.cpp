@@ -0,0 +1,104 @@
+#include "sharedmemoryproducer.h"
+#include <utils/exception.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pose
+{
+SharedMemoryProducer::SharedMemoryProducer(const std::string& name, int width, int height, int slotCount, bool hasPoints)
+    : m_name(name),
+      m_mapping(0),
+      m_mappingSize(0),
+      m_header(0)
+{
+    if (width <= 0 || height <= 0 || slotCount <= 0)
+        throw Exception("invalid shared memory ring size");
+
+#ifdef _WIN32
+    (void)hasPoints;
+    throw Exception("shared memory input is not supported on this platform");
+#else
+    const uint64_t slotSize = getSharedMemorySlotSize(width, height, hasPoints);
+    const uint64_t dataOffset = sizeof(SharedMemoryRingHeader);
+    m_mappingSize = (size_t)(dataOffset + slotCount * slotSize);
+
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        throw Exception("could not create shared memory object " + m_name);
+
+    if (ftruncate(fd, (off_t)m_mappingSize) != 0) {
+        close(fd);
+        shm_unlink(m_name.c_str());
+        throw Exception("could not resize shared memory object " + m_name);
+    }
+
+    m_mapping = mmap(0, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (m_mapping == MAP_FAILED) {
+        m_mapping = 0;
+        shm_unlink(m_name.c_str());
+        throw Exception("could not map shared memory object " + m_name);
+    }
+
+    // initialize the header, the magic number is written last so consumers only attach to a
+    // completely initialized ring
+    m_header = (SharedMemoryRingHeader*)m_mapping;
+    m_header->version = SHARED_MEMORY_VERSION;
+    m_header->width = width;
+    m_header->height = height;
+    m_header->slotCount = slotCount;
+    m_header->hasPoints = hasPoints ? 1 : 0;
+    m_header->slotSize = slotSize;
+    m_header->dataOffset = dataOffset;
+    m_header->head.store(0, std::memory_order_relaxed);
+    m_header->tail.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = SHARED_MEMORY_MAGIC;
+#endif
+}
+
+SharedMemoryProducer::~SharedMemoryProducer()
+{
+#ifndef _WIN32
+    if (m_mapping)
+        munmap(m_mapping, m_mappingSize);
+    shm_unlink(m_name.c_str());
+#endif
+}
+
+bool SharedMemoryProducer::write(const float* depthData, const float* pointsData, long long timestamp, unsigned int sequence)
+{
+    // the consumer would read the point cloud of an older frame from the slot
+    if (m_header->hasPoints && !pointsData)
+        throw Exception("the shared memory ring requires a point cloud");
+
+    const uint64_t head = m_header->head.load(std::memory_order_relaxed);
+    const uint64_t tail = m_header->tail.load(std::memory_order_acquire);
+
+    // ring is full, drop the frame
+    if (head - tail >= m_header->slotCount)
+        return false;
+
+    unsigned char* slot = (unsigned char*)m_mapping + m_header->dataOffset + (head % m_header->slotCount) * m_header->slotSize;
+    SharedMemorySlotHeader* slotHeader = (SharedMemorySlotHeader*)slot;
+    float* slotDepth = (float*)(slot + sizeof(SharedMemorySlotHeader));
+    const size_t numPixels = (size_t)m_header->width * m_header->height;
+
+    slotHeader->timestamp = timestamp;
+    slotHeader->sequence = sequence;
+    memcpy(slotDepth, depthData, numPixels * sizeof(float));
+    if (m_header->hasPoints)
+        memcpy(slotDepth + numPixels, pointsData, numPixels * 3 * sizeof(float));
+
+    // publish the frame to the consumer
+    m_header->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+}
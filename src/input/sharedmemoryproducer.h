@@ -0,0 +1,35 @@
+#ifndef SHAREDMEMORYPRODUCER_H
+#define SHAREDMEMORYPRODUCER_H
+
+#include <string>
+#include "sharedmemoryring.h"
+
+namespace pose
+{
+/**
+ * @brief Producer side of the shared memory ring buffer (see sharedmemoryring.h). Creates the
+ * shared memory object and writes frames into it. This is meant as a reference for capture
+ * processes and as a local stand-in for a camera.
+ */
+class SharedMemoryProducer
+{
+public:
+    SharedMemoryProducer(const std::string& name, int width, int height, int slotCount, bool hasPoints);
+    ~SharedMemoryProducer();
+
+    /**
+     * @brief Write a frame into the next free slot. pointsData is ignored if the ring does not
+     * contain point clouds, otherwise it is required. Returns false if the ring is full, i.e. the
+     * frame has been dropped.
+     */
+    bool write(const float* depthData, const float* pointsData, long long timestamp, unsigned int sequence);
+
+private:
+    std::string m_name;
+    void* m_mapping;
+    size_t m_mappingSize;
+    SharedMemoryRingHeader* m_header;
+};
+}
+
+#endif // SHAREDMEMORYPRODUCER_H
@@ -0,0 +1,71 @@
+#ifndef SHAREDMEMORYRING_H
+#define SHAREDMEMORYRING_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * Layout of the POSIX shared memory ring buffer that is used to pass frames from a separate
+ * capture process to the library (see SharedMemoryInput and SharedMemoryProducer).
+ *
+ * The shared memory object consists of a SharedMemoryRingHeader, followed by slotCount slots of
+ * slotSize bytes each, starting at dataOffset. Each slot consists of
+ *
+ *      SharedMemorySlotHeader                  (64 bytes)
+ *      float depth[height][width]              depth in meters, 0 for invalid pixels
+ *      float points[height][width][3]          only if hasPoints is set
+ *
+ * and is padded to a multiple of 64 bytes.
+ *
+ * The ring has a single producer and a single consumer. head and tail are monotonically increasing
+ * frame counters, the slot of a frame is counter % slotCount.
+ *  - The producer owns head. It writes the slot at head if head - tail < slotCount, i.e. the ring
+ *    is not full, and publishes it by incrementing head (release).
+ *  - The consumer owns tail. It reads the slot at tail if tail != head (acquire) and hands the
+ *    slot back to the producer by incrementing tail (release) after it has finished with it.
+ * Both counters are placed in separate cache lines to avoid false sharing.
+ */
+
+namespace pose
+{
+const uint32_t SHARED_MEMORY_MAGIC = 0x4d485350;   // "PSHM"
+const uint32_t SHARED_MEMORY_VERSION = 1;
+const uint32_t SHARED_MEMORY_ALIGNMENT = 64;
+
+struct SharedMemoryRingHeader
+{
+    uint32_t magic;             // SHARED_MEMORY_MAGIC, written last by the producer
+    uint32_t version;           // SHARED_MEMORY_VERSION
+    uint32_t width;
+    uint32_t height;
+    uint32_t slotCount;
+    uint32_t hasPoints;         // 1 if the slots contain a point cloud
+    uint64_t slotSize;          // size of a slot in bytes including the slot header
+    uint64_t dataOffset;        // offset of the first slot from the beginning of the object
+    uint8_t  padding0[SHARED_MEMORY_ALIGNMENT - 40];
+
+    std::atomic<uint64_t> head; // number of frames written by the producer
+    uint8_t  padding1[SHARED_MEMORY_ALIGNMENT - sizeof(std::atomic<uint64_t>)];
+
+    std::atomic<uint64_t> tail; // number of frames released by the consumer
+    uint8_t  padding2[SHARED_MEMORY_ALIGNMENT - sizeof(std::atomic<uint64_t>)];
+};
+
+struct SharedMemorySlotHeader
+{
+    int64_t  timestamp;         // capture timestamp in microseconds
+    uint32_t sequence;          // sequence number of the frame
+    uint8_t  padding[SHARED_MEMORY_ALIGNMENT - 12];
+};
+
+/**
+ * @brief Compute the size of a slot for the given frame size.
+ */
+inline uint64_t getSharedMemorySlotSize(uint32_t width, uint32_t height, bool hasPoints)
+{
+    uint64_t size = sizeof(SharedMemorySlotHeader) + (uint64_t)width * height * sizeof(float) * (hasPoints ? 4 : 1);
+    return (size + SHARED_MEMORY_ALIGNMENT - 1) / SHARED_MEMORY_ALIGNMENT * SHARED_MEMORY_ALIGNMENT;
+}
+}
+
+#endif // SHAREDMEMORYRING_H
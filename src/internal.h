@@ -9,6 +9,7 @@ struct _PoseContext
     int height;
     int depthFrameSize;
     int pointsFrameSize;
+    unsigned int nextSequence;
     CAlgorithm* algorithm;
 };
 
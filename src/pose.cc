@@ -5,6 +5,7 @@
 #include "algorithm.h"
 #include "internal.h"
 #include <utils/exception.h>
+#include <utils/timer.h>
 
 POSEAPI PoseResult poseInit(PoseContext** context, int width, int height)
 {
@@ -26,6 +27,37 @@ POSEAPI PoseResult poseInit(PoseContext** context, int width, int height)
     return RESULT_SUCCESS;
 }
 
+POSEAPI PoseResult poseInitWithSnapshot(PoseContext** context, int width, int height, const char* snapshotPath, int snapshotInterval)
+{
+    if (snapshotPath == NULL || strlen(snapshotPath) == 0 || snapshotInterval < 0)
+        return RESULT_INVALIDPARAMETERS;
+
+    PoseResult result = poseInit(context, width, height);
+    if (result != RESULT_SUCCESS)
+        return result;
+
+    try {
+        // a missing or outdated snapshot is not an error, the background is learned as usual then
+        pose::Algorithm* algorithm = (pose::Algorithm*)((*context)->algorithm);
+        algorithm->loadBackgroundSnapshot(snapshotPath);
+        algorithm->setBackgroundSnapshot(snapshotPath, snapshotInterval);
+    }
+    catch (const pose::Exception& exception) {
+        printf("Exception: %s", exception.what());
+        poseShutdown(*context);
+        *context = NULL;
+        return RESULT_INTERNALERROR;
+    }
+    catch (...) {
+        printf("Unhandled Exception");
+        poseShutdown(*context);
+        *context = NULL;
+        return RESULT_UNHANDLEDEXCEPTION;
+    }
+
+    return RESULT_SUCCESS;
+}
+
 POSEAPI PoseResult poseShutdown(PoseContext* context)
 {
     if (context == NULL)
@@ -36,19 +68,45 @@ POSEAPI PoseResult poseShutdown(PoseContext* context)
     return RESULT_SUCCESS;
 }
 
+POSEAPI PoseResult poseSetUserTracking(PoseContext* context, int enabled)
+{
+    if (context == NULL)
+        return RESULT_INVALIDCONTEXT;
+
+    ((pose::Algorithm*)(context->algorithm))->setUserTracking(enabled != 0);
+    return RESULT_SUCCESS;
+}
+
 POSEAPI PoseResult poseSetInput(PoseContext* context, float* depthData, int depthDataSize, float* pointsData, int pointsDataSize)
+{
+    if (context == NULL)
+        return RESULT_INVALIDCONTEXT;
+
+    // no capture information available, so the frame is captured now and is the next one in sequence
+    return poseSetInputTimestamped(context, depthData, depthDataSize, pointsData, pointsDataSize,
+                                   poseGetTimestamp(), context->nextSequence);
+}
+
+POSEAPI PoseResult poseSetInputTimestamped(PoseContext* context, float* depthData, int depthDataSize, float* pointsData, int pointsDataSize,
+                                           long long timestamp, unsigned int sequence)
 {
     if (context == NULL)
         return RESULT_INVALIDCONTEXT;
 
     if (depthData == NULL ||
-        pointsData == NULL ||
         depthDataSize != context->depthFrameSize ||
-        pointsDataSize != context->pointsFrameSize)
+        (pointsData != NULL && pointsDataSize != context->pointsFrameSize) ||
+        (pointsData == NULL && pointsDataSize != 0))
         return RESULT_INVALIDPARAMETERS;
 
+    context->nextSequence = sequence + 1;
+
+    pose::FrameInfo frameInfo;
+    frameInfo.timestamp = timestamp;
+    frameInfo.sequence = sequence;
+
     try {
-        if (!((pose::Algorithm*)(context->algorithm))->process(depthData, depthDataSize, pointsData, pointsDataSize))
+        if (!((pose::Algorithm*)(context->algorithm))->process(depthData, depthDataSize, pointsData, pointsDataSize, frameInfo))
             return RESULT_FINISHED;
     }
     catch (const pose::Exception& exception) {
@@ -63,6 +121,50 @@ POSEAPI PoseResult poseSetInput(PoseContext* context, float* depthData, int dept
     return RESULT_SUCCESS;
 }
 
+POSEAPI PoseResult poseAttachSharedMemory(PoseContext* context, const char* name)
+{
+    if (context == NULL)
+        return RESULT_INVALIDCONTEXT;
+
+    if (name == NULL || strlen(name) == 0)
+        return RESULT_INVALIDPARAMETERS;
+
+    try {
+        ((pose::Algorithm*)(context->algorithm))->attachSharedMemory(name);
+    }
+    catch (const pose::Exception& exception) {
+        printf("Exception: %s", exception.what());
+        return RESULT_INTERNALERROR;
+    }
+    catch (...) {
+        printf("Unhandled Exception");
+        return RESULT_UNHANDLEDEXCEPTION;
+    }
+
+    return RESULT_SUCCESS;
+}
+
+POSEAPI PoseResult poseProcessSharedMemory(PoseContext* context)
+{
+    if (context == NULL)
+        return RESULT_INVALIDCONTEXT;
+
+    try {
+        if (!((pose::Algorithm*)(context->algorithm))->processSharedMemory())
+            return RESULT_NODATA;
+    }
+    catch (const pose::Exception& exception) {
+        printf("Exception: %s", exception.what());
+        return RESULT_INTERNALERROR;
+    }
+    catch (...) {
+        printf("Unhandled Exception");
+        return RESULT_UNHANDLEDEXCEPTION;
+    }
+
+    return RESULT_SUCCESS;
+}
+
 POSEAPI PoseResult poseGetScene(PoseContext* context, PoseScene** scene)
 {
     if (context == NULL)
@@ -77,11 +179,46 @@ POSEAPI PoseResult poseGetScene(PoseContext* context, PoseScene** scene)
 
     memset(*scene, 0, sizeof(PoseScene));
 
+    const pose::FrameInfo& frameInfo = ((pose::Algorithm*)(context->algorithm))->getFrameInfo();
+    (*scene)->timestamp = frameInfo.timestamp;
+    (*scene)->sequence = frameInfo.sequence;
+
     (*scene)->skeletons = (PoseSkeleton*)malloc((*scene)->numSkeletons * sizeof(PoseSkeleton));
 
     return RESULT_SUCCESS;
 }
 
+POSEAPI long long poseGetTimestamp(void)
+{
+    return pose::Timer::getMicroseconds();
+}
+
+POSEAPI PoseResult poseGetLatencyStats(PoseContext* context, PoseLatencyStats* stats)
+{
+    if (context == NULL)
+        return RESULT_INVALIDCONTEXT;
+
+    if (stats == NULL)
+        return RESULT_INVALIDPARAMETERS;
+
+    const pose::LatencyTracer& tracer = ((pose::Algorithm*)(context->algorithm))->getLatencyTracer();
+    stats->frames = tracer.getFrames();
+    stats->sequenceGaps = tracer.getSequenceGaps();
+    stats->droppedFrames = tracer.getDroppedFrames();
+    stats->outOfOrderFrames = tracer.getOutOfOrderFrames();
+    stats->lastQueueLatency = tracer.getLastQueueLatency();
+    stats->avgQueueLatency = tracer.getAvgQueueLatency();
+    stats->maxQueueLatency = tracer.getMaxQueueLatency();
+    stats->lastProcessingLatency = tracer.getLastProcessingLatency();
+    stats->avgProcessingLatency = tracer.getAvgProcessingLatency();
+    stats->maxProcessingLatency = tracer.getMaxProcessingLatency();
+    stats->lastTotalLatency = tracer.getLastTotalLatency();
+    stats->avgTotalLatency = tracer.getAvgTotalLatency();
+    stats->maxTotalLatency = tracer.getMaxTotalLatency();
+
+    return RESULT_SUCCESS;
+}
+
 POSEAPI PoseResult poseFreeScene(PoseScene* scene)
 {
     if (scene == NULL)
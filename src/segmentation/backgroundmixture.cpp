@@ -0,0 +1,134 @@
+#include "backgroundmixture.h"
+#include <utils/exception.h>
+
+namespace pose
+{
+BackgroundMixture::BackgroundMixture()
+    : m_numModes(3),
+      m_learningRate(0.01f),
+      m_backgroundRatio(0.7f),
+      m_foregroundDistance(0.1f),
+      m_kernels(BackgroundMixtureKernels::get(CpuFeatures::getInstructionSet()))
+{
+}
+
+BackgroundMixture::~BackgroundMixture()
+{
+}
+
+void BackgroundMixture::setNumModes(int numModes)
+{
+    if (numModes < 1 || numModes > MAX_MODES)
+        throw Exception("invalid number of modes");
+
+    m_numModes = numModes;
+    m_means.clear();
+    m_variances.clear();
+    m_weights.clear();
+}
+
+void BackgroundMixture::setLearningRate(float learningRate)
+{
+    m_learningRate = learningRate;
+}
+
+void BackgroundMixture::setBackgroundRatio(float ratio)
+{
+    m_backgroundRatio = ratio;
+}
+
+void BackgroundMixture::setForegroundDistance(float distance)
+{
+    m_foregroundDistance = distance;
+}
+
+void BackgroundMixture::setInstructionSet(CpuFeatures::InstructionSet instructionSet)
+{
+    m_kernels = BackgroundMixtureKernels::get(instructionSet);
+}
+
+int BackgroundMixture::getNumModes() const
+{
+    return m_numModes;
+}
+
+bool BackgroundMixture::isInitialized() const
+{
+    return (int)m_means.size() == m_numModes;
+}
+
+void BackgroundMixture::reset(const cv::Mat& depthMap)
+{
+    m_means.resize(m_numModes);
+    m_variances.resize(m_numModes);
+    m_weights.resize(m_numModes);
+
+    for (int k = 0; k < m_numModes; k++) {
+        m_means[k] = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
+        m_variances[k] = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
+        m_weights[k] = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
+        m_means[k].setTo(0);
+        m_variances[k].setTo(BackgroundMixtureKernels::INITIAL_VARIANCE);
+        m_weights[k].setTo(0);
+    }
+
+    // the first mode starts with the current depth wherever it is valid
+    depthMap.copyTo(m_means[0]);
+    for (int i = 0; i < depthMap.rows; i++) {
+        const float* depthRow = depthMap.ptr<float>(i);
+        float* weightRow = m_weights[0].ptr<float>(i);
+
+        for (int j = 0; j < depthMap.cols; j++)
+            weightRow[j] = depthRow[j] > 0 ? 1.0f : 0.0f;
+    }
+}
+
+int BackgroundMixture::classifyRow(const cv::Mat& depthMap, cv::Mat& foreground, cv::Mat& mask, int row,
+                                   int begin, int end, signed char* matches)
+{
+    const float* means[MAX_MODES];
+    const float* variances[MAX_MODES];
+    const float* weights[MAX_MODES];
+    for (int k = 0; k < m_numModes; k++) {
+        means[k] = m_means[k].ptr<float>(row) + begin;
+        variances[k] = m_variances[k].ptr<float>(row) + begin;
+        weights[k] = m_weights[k].ptr<float>(row) + begin;
+    }
+
+    return m_kernels.classifyRow[m_numModes - 1](depthMap.ptr<float>(row) + begin, means, variances, weights,
+                                                 foreground.ptr<float>(row) + begin, mask.ptr<uchar>(row) + begin,
+                                                 matches + begin, end - begin, m_backgroundRatio, m_foregroundDistance);
+}
+
+int BackgroundMixture::updateRow(const cv::Mat& depthMap, cv::Mat& background, int row, int begin, int end,
+                                 const signed char* matches, const uchar* shadow)
+{
+    float* means[MAX_MODES];
+    float* variances[MAX_MODES];
+    float* weights[MAX_MODES];
+    for (int k = 0; k < m_numModes; k++) {
+        means[k] = m_means[k].ptr<float>(row) + begin;
+        variances[k] = m_variances[k].ptr<float>(row) + begin;
+        weights[k] = m_weights[k].ptr<float>(row) + begin;
+    }
+
+    return m_kernels.updateRow[m_numModes - 1](depthMap.ptr<float>(row) + begin, matches + begin, shadow + begin,
+                                               means, variances, weights, background.ptr<float>(row) + begin,
+                                               end - begin, m_learningRate);
+}
+
+std::vector<cv::Mat>& BackgroundMixture::getMeans()
+{
+    return m_means;
+}
+
+std::vector<cv::Mat>& BackgroundMixture::getVariances()
+{
+    return m_variances;
+}
+
+std::vector<cv::Mat>& BackgroundMixture::getWeights()
+{
+    return m_weights;
+}
+}
@@ -0,0 +1,94 @@
+#ifndef BACKGROUNDMIXTURE_H
+#define BACKGROUNDMIXTURE_H
+
+#include "backgroundmixturekernels.h"
+#include <opencv2/opencv.hpp>
+
+namespace pose
+{
+/**
+ * @brief Multi-modal background model with a mixture of gaussians per pixel. This is able to
+ * represent pixels that switch between multiple depths, e.g. doors or swivel chairs. The modes
+ * are stored as structure-of-arrays, i.e. there is one plane of means, variances and weights for
+ * each mode, so the update of a row only consists of contiguous loads and stores. The rows are
+ * processed by the kernels in BackgroundMixtureKernels.
+ */
+class BackgroundMixture
+{
+public:
+    static const int MAX_MODES = BackgroundMixtureKernels::MAX_MODES;
+
+    BackgroundMixture();
+    ~BackgroundMixture();
+
+    /**
+     * @brief Sets the number of modes per pixel (1 to MAX_MODES). This resets the model.
+     */
+    void setNumModes(int numModes);
+
+    /**
+     * @brief Sets the learning rate, i.e. the weight of a new observation.
+     */
+    void setLearningRate(float learningRate);
+
+    /**
+     * @brief Sets the minimum accumulated weight of the modes that are considered background.
+     */
+    void setBackgroundRatio(float ratio);
+
+    /**
+     * @brief Sets the minimum distance that a pixel should have from the farthest background
+     * mode to be considered part of the foreground.
+     */
+    void setForegroundDistance(float distance);
+
+    /**
+     * @brief Selects the row kernels for the given instruction set.
+     */
+    void setInstructionSet(CpuFeatures::InstructionSet instructionSet);
+
+    int getNumModes() const;
+    bool isInitialized() const;
+
+    /**
+     * @brief Initialize the model with one mode per pixel at the given depth.
+     */
+    void reset(const cv::Mat& depthMap);
+
+    /**
+     * @brief Compute the foreground and the mask of the columns [begin, end) of a row with the
+     * current model. The matching mode of each pixel is written to matches (indexed by the
+     * column) for updateRow. Returns the number of foreground pixels.
+     */
+    int classifyRow(const cv::Mat& depthMap, cv::Mat& foreground, cv::Mat& mask, int row, int begin, int end,
+                    signed char* matches);
+
+    /**
+     * @brief Update the model of the columns [begin, end) of a row with the matches of
+     * classifyRow, except for the pixels
+     * inside of the shadow (non-zero), and write the background, i.e. the mean of the strongest
+     * mode of each pixel. Returns the number of valid pixels that were not updated because of
+     * the shadow.
+     */
+    int updateRow(const cv::Mat& depthMap, cv::Mat& background, int row, int begin, int end,
+                  const signed char* matches, const uchar* shadow);
+
+    std::vector<cv::Mat>& getMeans();
+    std::vector<cv::Mat>& getVariances();
+    std::vector<cv::Mat>& getWeights();
+
+private:
+    std::vector<cv::Mat> m_means;
+    std::vector<cv::Mat> m_variances;
+    std::vector<cv::Mat> m_weights;
+
+    int     m_numModes;
+    float   m_learningRate;
+    float   m_backgroundRatio;
+    float   m_foregroundDistance;
+
+    BackgroundMixtureKernels m_kernels;
+};
+}
+
+#endif // BACKGROUNDMIXTURE_H
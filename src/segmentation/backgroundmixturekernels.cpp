@@ -0,0 +1,705 @@
+#include "backgroundmixturekernels.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+const float BackgroundMixtureKernels::INITIAL_VARIANCE = 0.05f * 0.05f;
+
+// a pixel matches a mode if it is within this number of standard deviations
+static const float matchSigmas = 2.5f;
+static const float matchSigmasSqr = matchSigmas * matchSigmas;
+// minimum match distance in meters to account for the depth quantization
+static const float minMatchDistance = 0.02f;
+static const float minMatchDistanceSqr = minMatchDistance * minMatchDistance;
+// minimum variance (in square meters)
+static const float minVariance = 0.005f * 0.005f;
+
+// ---------------------------------------------------------------------------------------------
+// scalar fallback, also used for the remaining pixels at the end of each row
+// ---------------------------------------------------------------------------------------------
+
+template <int K>
+static int classifyRowScalar(const float* depth, const float* const* means, const float* const* variances,
+                             const float* const* weights, float* foreground, unsigned char* mask,
+                             signed char* matches, int cols, float backgroundRatio, float foregroundDistance)
+{
+    int numForeground = 0;
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+
+        // invalid pixels neither update the model nor belong to the foreground
+        if (!(dist > 0)) {
+            foreground[j] = 0;
+            mask[j] = 0;
+            matches[j] = -1;
+            continue;
+        }
+
+        float rank[K];
+        for (int k = 0; k < K; k++)
+            rank[k] = weights[k][j] * weights[k][j] / variances[k][j];
+
+        // Background modes are the strongest modes (ranked by weight / sigma, compared without
+        // the square root) whose accumulated weight reaches the background ratio. Instead of
+        // sorting, a mode is background if the weight of all stronger modes is below the ratio,
+        // equal ranks are ordered by the index of the mode.
+        bool isBackground[K];
+        float farthestBackground = 0;
+        for (int k = 0; k < K; k++) {
+            float strongerWeight = 0;
+            for (int l = 0; l < K; l++) {
+                if (l < k ? rank[l] >= rank[k] : rank[l] > rank[k])
+                    strongerWeight += weights[l][j];
+            }
+
+            isBackground[k] = weights[k][j] > 0 && strongerWeight < backgroundRatio;
+            if (isBackground[k] && means[k][j] > farthestBackground)
+                farthestBackground = means[k][j];
+        }
+
+        // find the closest matching mode, valid pixels without a matching mode are marked with K
+        // to create a new mode
+        int match = K;
+        bool isMatchBackground = false;
+        float matchDistSqr = std::numeric_limits<float>::max();
+        for (int k = 0; k < K; k++) {
+            const float diff = dist - means[k][j];
+            const float distSqr = diff * diff;
+            const float thresholdSqr = std::max(matchSigmasSqr * variances[k][j], minMatchDistanceSqr);
+            if (weights[k][j] > 0 && distSqr < thresholdSqr && distSqr < matchDistSqr) {
+                match = k;
+                isMatchBackground = isBackground[k];
+                matchDistSqr = distSqr;
+            }
+        }
+
+        // the pixel belongs to the foreground if it does not match a background mode and is in
+        // front of all background modes
+        const bool isForeground = !isMatchBackground && dist < farthestBackground - foregroundDistance;
+        foreground[j] = isForeground ? dist : 0;
+        mask[j] = isForeground ? 255 : 0;
+        numForeground += isForeground;
+        matches[j] = match;
+    }
+
+    return numForeground;
+}
+
+template <int K>
+static int updateRowScalar(const float* depth, const signed char* matches, const unsigned char* shadow,
+                           float* const* means, float* const* variances, float* const* weights,
+                           float* background, int cols, float learningRate)
+{
+    const float alpha = learningRate;
+    const float decay = 1 - alpha;
+
+    int numSuppressed = 0;
+    for (int j = 0; j < cols; j++) {
+        const int match = matches[j];
+
+        // invalid pixels and pixels inside of the shadow keep their modes
+        numSuppressed += match >= 0 && shadow[j];
+        if (match >= 0 && !shadow[j]) {
+            const float dist = depth[j];
+
+            float weight[K];
+            float weightSum = 0;
+            if (match < K) {
+                for (int k = 0; k < K; k++) {
+                    weight[k] = decay * weights[k][j] + (k == match ? alpha : 0);
+                    weightSum += weight[k];
+                }
+
+                const float rho = std::min(alpha / weight[match], 1.0f);
+                const float diff = dist - means[match][j];
+                const float variance = variances[match][j];
+                means[match][j] += rho * diff;
+                variances[match][j] = std::max(variance + rho * (diff * diff - variance), minVariance);
+            }
+            else {
+                // replace the weakest mode with a new one at the current depth
+                int weakest = 0;
+                for (int k = 1; k < K; k++) {
+                    if (weights[k][j] < weights[weakest][j])
+                        weakest = k;
+                }
+
+                for (int k = 0; k < K; k++) {
+                    weight[k] = k == weakest ? alpha : decay * weights[k][j];
+                    weightSum += weight[k];
+                }
+
+                means[weakest][j] = dist;
+                variances[weakest][j] = BackgroundMixtureKernels::INITIAL_VARIANCE;
+            }
+
+            // normalize the weights
+            const float normalization = 1.0f / weightSum;
+            for (int k = 0; k < K; k++)
+                weights[k][j] = weight[k] * normalization;
+        }
+
+        // the background is the mean of the strongest mode
+        int strongest = 0;
+        for (int k = 1; k < K; k++) {
+            if (weights[k][j] > weights[strongest][j])
+                strongest = k;
+        }
+        background[j] = means[strongest][j];
+    }
+
+    return numSuppressed;
+}
+
+#ifdef POSE_SIMD_X86
+
+// ---------------------------------------------------------------------------------------------
+// SSE4.1, 4 pixels per vector, all modes of the pixels are kept in registers
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("sse4.1")
+static inline int horizontalSumSSE41(__m128i sum)
+{
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+POSE_TARGET("sse4.1")
+static inline void storeBytesSSE41(void* bytes, __m128i x)
+{
+    // narrow 4 lanes to 4 bytes, all bits set (-1) saturates to 0xff
+    x = _mm_packs_epi32(x, x);
+    const int packed = _mm_cvtsi128_si32(_mm_packs_epi16(x, x));
+    memcpy(bytes, &packed, sizeof(int));
+}
+
+POSE_TARGET("sse4.1")
+static inline __m128i loadBytesSSE41(const void* bytes)
+{
+    // widen 4 signed bytes to 4 lanes
+    int packed;
+    memcpy(&packed, bytes, sizeof(int));
+    return _mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed));
+}
+
+POSE_TARGET("sse4.1")
+static inline __m128 loadShadowSSE41(const unsigned char* shadow)
+{
+    // widen 4 bytes to 4 lanes that are all set where the shadow is set
+    int bytes;
+    memcpy(&bytes, shadow, sizeof(int));
+    const __m128i shadow32 = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(shadow32, _mm_setzero_si128()));
+}
+
+POSE_TARGET("sse4.1")
+static inline __m128 selectSSE41(__m128 a, __m128 b, __m128 select)
+{
+    return _mm_blendv_ps(a, b, select);
+}
+
+POSE_TARGET("sse4.1")
+static inline __m128i selectSSE41(__m128i a, __m128i b, __m128 select)
+{
+    return _mm_blendv_epi8(a, b, _mm_castps_si128(select));
+}
+
+template <int K>
+POSE_TARGET("sse4.1")
+static int classifyRowSSE41(const float* depth, const float* const* means, const float* const* variances,
+                            const float* const* weights, float* foreground, unsigned char* mask,
+                            signed char* matches, int cols, float backgroundRatio, float foregroundDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 ratio = _mm_set1_ps(backgroundRatio);
+    const __m128 distance = _mm_set1_ps(foregroundDistance);
+    const __m128 sigmasSqr = _mm_set1_ps(matchSigmasSqr);
+    const __m128 minDistSqr = _mm_set1_ps(minMatchDistanceSqr);
+
+    // set lanes are -1, so subtracting the masks counts them
+    __m128i numForeground = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+
+        __m128 mean[K];
+        __m128 variance[K];
+        __m128 weight[K];
+        __m128 rank[K];
+        for (int k = 0; k < K; k++) {
+            mean[k] = _mm_loadu_ps(means[k] + j);
+            variance[k] = _mm_loadu_ps(variances[k] + j);
+            weight[k] = _mm_loadu_ps(weights[k] + j);
+            rank[k] = _mm_div_ps(_mm_mul_ps(weight[k], weight[k]), variance[k]);
+        }
+
+        // the weights of the weaker modes are masked to 0, which does not change the sum
+        __m128 isBackground[K];
+        __m128 farthestBackground = zero;
+        for (int k = 0; k < K; k++) {
+            __m128 strongerWeight = zero;
+            for (int l = 0; l < K; l++) {
+                if (l == k)
+                    continue;
+
+                const __m128 isStronger = l < k ? _mm_cmpge_ps(rank[l], rank[k]) : _mm_cmpgt_ps(rank[l], rank[k]);
+                strongerWeight = _mm_add_ps(strongerWeight, _mm_and_ps(weight[l], isStronger));
+            }
+
+            isBackground[k] = _mm_and_ps(_mm_cmpgt_ps(weight[k], zero), _mm_cmplt_ps(strongerWeight, ratio));
+            farthestBackground = selectSSE41(farthestBackground, mean[k],
+                                             _mm_and_ps(isBackground[k], _mm_cmpgt_ps(mean[k], farthestBackground)));
+        }
+
+        __m128i match = _mm_set1_epi32(K);
+        __m128 isMatchBackground = zero;
+        __m128 matchDistSqr = _mm_set1_ps(std::numeric_limits<float>::max());
+        for (int k = 0; k < K; k++) {
+            const __m128 diff = _mm_sub_ps(dist, mean[k]);
+            const __m128 distSqr = _mm_mul_ps(diff, diff);
+            const __m128 thresholdSqr = _mm_max_ps(_mm_mul_ps(sigmasSqr, variance[k]), minDistSqr);
+            const __m128 isMatch = _mm_and_ps(_mm_cmpgt_ps(weight[k], zero),
+                                              _mm_and_ps(_mm_cmplt_ps(distSqr, thresholdSqr),
+                                                         _mm_cmplt_ps(distSqr, matchDistSqr)));
+
+            match = selectSSE41(match, _mm_set1_epi32(k), isMatch);
+            isMatchBackground = selectSSE41(isMatchBackground, isBackground[k], isMatch);
+            matchDistSqr = selectSSE41(matchDistSqr, distSqr, isMatch);
+        }
+
+        const __m128 isValid = _mm_cmpgt_ps(dist, zero);
+        const __m128 isFront = _mm_cmplt_ps(dist, _mm_sub_ps(farthestBackground, distance));
+        const __m128 isForeground = _mm_and_ps(isValid, _mm_andnot_ps(isMatchBackground, isFront));
+
+        _mm_storeu_ps(foreground + j, _mm_and_ps(dist, isForeground));
+        storeBytesSSE41(mask + j, _mm_castps_si128(isForeground));
+        storeBytesSSE41(matches + j, selectSSE41(_mm_set1_epi32(-1), match, isValid));
+        numForeground = _mm_sub_epi32(numForeground, _mm_castps_si128(isForeground));
+    }
+
+    const float* meanTails[K];
+    const float* varianceTails[K];
+    const float* weightTails[K];
+    for (int k = 0; k < K; k++) {
+        meanTails[k] = means[k] + j;
+        varianceTails[k] = variances[k] + j;
+        weightTails[k] = weights[k] + j;
+    }
+
+    return horizontalSumSSE41(numForeground) +
+            classifyRowScalar<K>(depth + j, meanTails, varianceTails, weightTails, foreground + j, mask + j,
+                                 matches + j, cols - j, backgroundRatio, foregroundDistance);
+}
+
+template <int K>
+POSE_TARGET("sse4.1")
+static int updateRowSSE41(const float* depth, const signed char* matches, const unsigned char* shadow,
+                          float* const* means, float* const* variances, float* const* weights,
+                          float* background, int cols, float learningRate)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 alpha = _mm_set1_ps(learningRate);
+    const __m128 decay = _mm_set1_ps(1 - learningRate);
+    const __m128 minVar = _mm_set1_ps(minVariance);
+    const __m128 initialVariance = _mm_set1_ps(BackgroundMixtureKernels::INITIAL_VARIANCE);
+
+    __m128i numSuppressed = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+        const __m128i match = loadBytesSSE41(matches + j);
+        const __m128 isValid = _mm_castsi128_ps(_mm_cmpgt_epi32(match, _mm_set1_epi32(-1)));
+        const __m128 isNew = _mm_castsi128_ps(_mm_cmpeq_epi32(match, _mm_set1_epi32(K)));
+        const __m128 inShadow = loadShadowSSE41(shadow + j);
+        const __m128 update = _mm_andnot_ps(inShadow, isValid);
+
+        __m128 mean[K];
+        __m128 variance[K];
+        __m128 weight[K];
+        __m128 isMatch[K];
+        for (int k = 0; k < K; k++) {
+            mean[k] = _mm_loadu_ps(means[k] + j);
+            variance[k] = _mm_loadu_ps(variances[k] + j);
+            weight[k] = _mm_loadu_ps(weights[k] + j);
+            isMatch[k] = _mm_castsi128_ps(_mm_cmpeq_epi32(match, _mm_set1_epi32(k)));
+        }
+
+        // the weakest mode is replaced by a new mode if no mode matches
+        __m128i weakest = _mm_setzero_si128();
+        __m128 weakestWeight = weight[0];
+        for (int k = 1; k < K; k++) {
+            const __m128 isWeaker = _mm_cmplt_ps(weight[k], weakestWeight);
+            weakest = selectSSE41(weakest, _mm_set1_epi32(k), isWeaker);
+            weakestWeight = selectSSE41(weakestWeight, weight[k], isWeaker);
+        }
+
+        // update the weights and gather the data of the matching mode
+        __m128 isReplaced[K];
+        __m128 newWeight[K];
+        __m128 weightSum = _mm_setzero_ps();
+        __m128 matchWeight = one;
+        __m128 matchMean = dist;
+        __m128 matchVariance = initialVariance;
+        for (int k = 0; k < K; k++) {
+            isReplaced[k] = _mm_and_ps(isNew, _mm_castsi128_ps(_mm_cmpeq_epi32(weakest, _mm_set1_epi32(k))));
+            newWeight[k] = selectSSE41(_mm_add_ps(_mm_mul_ps(decay, weight[k]), _mm_and_ps(alpha, isMatch[k])),
+                                       alpha, isReplaced[k]);
+            weightSum = _mm_add_ps(weightSum, newWeight[k]);
+
+            matchWeight = selectSSE41(matchWeight, newWeight[k], isMatch[k]);
+            matchMean = selectSSE41(matchMean, mean[k], isMatch[k]);
+            matchVariance = selectSSE41(matchVariance, variance[k], isMatch[k]);
+        }
+
+        const __m128 rho = _mm_min_ps(_mm_div_ps(alpha, matchWeight), one);
+        const __m128 diff = _mm_sub_ps(dist, matchMean);
+        const __m128 newMean = _mm_add_ps(matchMean, _mm_mul_ps(rho, diff));
+        const __m128 varianceDiff = _mm_sub_ps(_mm_mul_ps(diff, diff), matchVariance);
+        const __m128 newVariance = _mm_max_ps(_mm_add_ps(matchVariance, _mm_mul_ps(rho, varianceDiff)), minVar);
+        const __m128 normalization = _mm_div_ps(one, weightSum);
+
+        // store the modes of the updated pixels
+        for (int k = 0; k < K; k++) {
+            const __m128 isUpdated = _mm_and_ps(update, _mm_or_ps(isMatch[k], isReplaced[k]));
+            const __m128 replacedMean = selectSSE41(newMean, dist, isReplaced[k]);
+            const __m128 replacedVariance = selectSSE41(newVariance, initialVariance, isReplaced[k]);
+
+            mean[k] = selectSSE41(mean[k], replacedMean, isUpdated);
+            variance[k] = selectSSE41(variance[k], replacedVariance, isUpdated);
+            weight[k] = selectSSE41(weight[k], _mm_mul_ps(newWeight[k], normalization), update);
+
+            _mm_storeu_ps(means[k] + j, mean[k]);
+            _mm_storeu_ps(variances[k] + j, variance[k]);
+            _mm_storeu_ps(weights[k] + j, weight[k]);
+        }
+
+        // the background is the mean of the strongest mode
+        __m128 strongestWeight = weight[0];
+        __m128 strongestMean = mean[0];
+        for (int k = 1; k < K; k++) {
+            const __m128 isStronger = _mm_cmpgt_ps(weight[k], strongestWeight);
+            strongestWeight = selectSSE41(strongestWeight, weight[k], isStronger);
+            strongestMean = selectSSE41(strongestMean, mean[k], isStronger);
+        }
+
+        _mm_storeu_ps(background + j, strongestMean);
+        numSuppressed = _mm_sub_epi32(numSuppressed, _mm_castps_si128(_mm_and_ps(inShadow, isValid)));
+    }
+
+    float* meanTails[K];
+    float* varianceTails[K];
+    float* weightTails[K];
+    for (int k = 0; k < K; k++) {
+        meanTails[k] = means[k] + j;
+        varianceTails[k] = variances[k] + j;
+        weightTails[k] = weights[k] + j;
+    }
+
+    return horizontalSumSSE41(numSuppressed) +
+            updateRowScalar<K>(depth + j, matches + j, shadow + j, meanTails, varianceTails, weightTails,
+                               background + j, cols - j, learningRate);
+}
+
+// ---------------------------------------------------------------------------------------------
+// AVX2, 8 pixels per vector, all modes of the pixels are kept in registers
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("avx2")
+static inline int horizontalSumAVX2(__m256i sum)
+{
+    return horizontalSumSSE41(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+}
+
+POSE_TARGET("avx2")
+static inline void storeBytesAVX2(void* bytes, __m256i x)
+{
+    // narrow 8 lanes to 8 bytes, all bits set (-1) saturates to 0xff
+    const __m128i x16 = _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    _mm_storel_epi64((__m128i*)bytes, _mm_packs_epi16(x16, x16));
+}
+
+POSE_TARGET("avx2")
+static inline __m256i loadBytesAVX2(const void* bytes)
+{
+    // widen 8 signed bytes to 8 lanes
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)bytes));
+}
+
+POSE_TARGET("avx2")
+static inline __m256 loadShadowAVX2(const unsigned char* shadow)
+{
+    // widen 8 bytes to 8 lanes that are all set where the shadow is set
+    const __m256i shadow32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)shadow));
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(shadow32, _mm256_setzero_si256()));
+}
+
+POSE_TARGET("avx2")
+static inline __m256 selectAVX2(__m256 a, __m256 b, __m256 select)
+{
+    return _mm256_blendv_ps(a, b, select);
+}
+
+POSE_TARGET("avx2")
+static inline __m256i selectAVX2(__m256i a, __m256i b, __m256 select)
+{
+    return _mm256_blendv_epi8(a, b, _mm256_castps_si256(select));
+}
+
+template <int K>
+POSE_TARGET("avx2")
+static int classifyRowAVX2(const float* depth, const float* const* means, const float* const* variances,
+                           const float* const* weights, float* foreground, unsigned char* mask,
+                           signed char* matches, int cols, float backgroundRatio, float foregroundDistance)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 ratio = _mm256_set1_ps(backgroundRatio);
+    const __m256 distance = _mm256_set1_ps(foregroundDistance);
+    const __m256 sigmasSqr = _mm256_set1_ps(matchSigmasSqr);
+    const __m256 minDistSqr = _mm256_set1_ps(minMatchDistanceSqr);
+
+    __m256i numForeground = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+
+        __m256 mean[K];
+        __m256 variance[K];
+        __m256 weight[K];
+        __m256 rank[K];
+        for (int k = 0; k < K; k++) {
+            mean[k] = _mm256_loadu_ps(means[k] + j);
+            variance[k] = _mm256_loadu_ps(variances[k] + j);
+            weight[k] = _mm256_loadu_ps(weights[k] + j);
+            rank[k] = _mm256_div_ps(_mm256_mul_ps(weight[k], weight[k]), variance[k]);
+        }
+
+        __m256 isBackground[K];
+        __m256 farthestBackground = zero;
+        for (int k = 0; k < K; k++) {
+            __m256 strongerWeight = zero;
+            for (int l = 0; l < K; l++) {
+                if (l == k)
+                    continue;
+
+                const __m256 isStronger = l < k ? _mm256_cmp_ps(rank[l], rank[k], _CMP_GE_OQ)
+                                                : _mm256_cmp_ps(rank[l], rank[k], _CMP_GT_OQ);
+                strongerWeight = _mm256_add_ps(strongerWeight, _mm256_and_ps(weight[l], isStronger));
+            }
+
+            isBackground[k] = _mm256_and_ps(_mm256_cmp_ps(weight[k], zero, _CMP_GT_OQ),
+                                            _mm256_cmp_ps(strongerWeight, ratio, _CMP_LT_OQ));
+            farthestBackground = selectAVX2(farthestBackground, mean[k],
+                                            _mm256_and_ps(isBackground[k],
+                                                          _mm256_cmp_ps(mean[k], farthestBackground, _CMP_GT_OQ)));
+        }
+
+        __m256i match = _mm256_set1_epi32(K);
+        __m256 isMatchBackground = zero;
+        __m256 matchDistSqr = _mm256_set1_ps(std::numeric_limits<float>::max());
+        for (int k = 0; k < K; k++) {
+            const __m256 diff = _mm256_sub_ps(dist, mean[k]);
+            const __m256 distSqr = _mm256_mul_ps(diff, diff);
+            const __m256 thresholdSqr = _mm256_max_ps(_mm256_mul_ps(sigmasSqr, variance[k]), minDistSqr);
+            const __m256 isMatch = _mm256_and_ps(_mm256_cmp_ps(weight[k], zero, _CMP_GT_OQ),
+                                                 _mm256_and_ps(_mm256_cmp_ps(distSqr, thresholdSqr, _CMP_LT_OQ),
+                                                               _mm256_cmp_ps(distSqr, matchDistSqr, _CMP_LT_OQ)));
+
+            match = selectAVX2(match, _mm256_set1_epi32(k), isMatch);
+            isMatchBackground = selectAVX2(isMatchBackground, isBackground[k], isMatch);
+            matchDistSqr = selectAVX2(matchDistSqr, distSqr, isMatch);
+        }
+
+        const __m256 isValid = _mm256_cmp_ps(dist, zero, _CMP_GT_OQ);
+        const __m256 isFront = _mm256_cmp_ps(dist, _mm256_sub_ps(farthestBackground, distance), _CMP_LT_OQ);
+        const __m256 isForeground = _mm256_and_ps(isValid, _mm256_andnot_ps(isMatchBackground, isFront));
+
+        _mm256_storeu_ps(foreground + j, _mm256_and_ps(dist, isForeground));
+        storeBytesAVX2(mask + j, _mm256_castps_si256(isForeground));
+        storeBytesAVX2(matches + j, selectAVX2(_mm256_set1_epi32(-1), match, isValid));
+        numForeground = _mm256_sub_epi32(numForeground, _mm256_castps_si256(isForeground));
+    }
+
+    const float* meanTails[K];
+    const float* varianceTails[K];
+    const float* weightTails[K];
+    for (int k = 0; k < K; k++) {
+        meanTails[k] = means[k] + j;
+        varianceTails[k] = variances[k] + j;
+        weightTails[k] = weights[k] + j;
+    }
+
+    return horizontalSumAVX2(numForeground) +
+            classifyRowScalar<K>(depth + j, meanTails, varianceTails, weightTails, foreground + j, mask + j,
+                                 matches + j, cols - j, backgroundRatio, foregroundDistance);
+}
+
+template <int K>
+POSE_TARGET("avx2")
+static int updateRowAVX2(const float* depth, const signed char* matches, const unsigned char* shadow,
+                         float* const* means, float* const* variances, float* const* weights,
+                         float* background, int cols, float learningRate)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 alpha = _mm256_set1_ps(learningRate);
+    const __m256 decay = _mm256_set1_ps(1 - learningRate);
+    const __m256 minVar = _mm256_set1_ps(minVariance);
+    const __m256 initialVariance = _mm256_set1_ps(BackgroundMixtureKernels::INITIAL_VARIANCE);
+
+    __m256i numSuppressed = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+        const __m256i match = loadBytesAVX2(matches + j);
+        const __m256 isValid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(match, _mm256_set1_epi32(-1)));
+        const __m256 isNew = _mm256_castsi256_ps(_mm256_cmpeq_epi32(match, _mm256_set1_epi32(K)));
+        const __m256 inShadow = loadShadowAVX2(shadow + j);
+        const __m256 update = _mm256_andnot_ps(inShadow, isValid);
+
+        __m256 mean[K];
+        __m256 variance[K];
+        __m256 weight[K];
+        __m256 isMatch[K];
+        for (int k = 0; k < K; k++) {
+            mean[k] = _mm256_loadu_ps(means[k] + j);
+            variance[k] = _mm256_loadu_ps(variances[k] + j);
+            weight[k] = _mm256_loadu_ps(weights[k] + j);
+            isMatch[k] = _mm256_castsi256_ps(_mm256_cmpeq_epi32(match, _mm256_set1_epi32(k)));
+        }
+
+        __m256i weakest = _mm256_setzero_si256();
+        __m256 weakestWeight = weight[0];
+        for (int k = 1; k < K; k++) {
+            const __m256 isWeaker = _mm256_cmp_ps(weight[k], weakestWeight, _CMP_LT_OQ);
+            weakest = selectAVX2(weakest, _mm256_set1_epi32(k), isWeaker);
+            weakestWeight = selectAVX2(weakestWeight, weight[k], isWeaker);
+        }
+
+        __m256 isReplaced[K];
+        __m256 newWeight[K];
+        __m256 weightSum = _mm256_setzero_ps();
+        __m256 matchWeight = one;
+        __m256 matchMean = dist;
+        __m256 matchVariance = initialVariance;
+        for (int k = 0; k < K; k++) {
+            isReplaced[k] = _mm256_and_ps(isNew, _mm256_castsi256_ps(_mm256_cmpeq_epi32(weakest, _mm256_set1_epi32(k))));
+            newWeight[k] = selectAVX2(_mm256_add_ps(_mm256_mul_ps(decay, weight[k]), _mm256_and_ps(alpha, isMatch[k])),
+                                      alpha, isReplaced[k]);
+            weightSum = _mm256_add_ps(weightSum, newWeight[k]);
+
+            matchWeight = selectAVX2(matchWeight, newWeight[k], isMatch[k]);
+            matchMean = selectAVX2(matchMean, mean[k], isMatch[k]);
+            matchVariance = selectAVX2(matchVariance, variance[k], isMatch[k]);
+        }
+
+        const __m256 rho = _mm256_min_ps(_mm256_div_ps(alpha, matchWeight), one);
+        const __m256 diff = _mm256_sub_ps(dist, matchMean);
+        const __m256 newMean = _mm256_add_ps(matchMean, _mm256_mul_ps(rho, diff));
+        const __m256 varianceDiff = _mm256_sub_ps(_mm256_mul_ps(diff, diff), matchVariance);
+        const __m256 newVariance = _mm256_max_ps(_mm256_add_ps(matchVariance, _mm256_mul_ps(rho, varianceDiff)), minVar);
+        const __m256 normalization = _mm256_div_ps(one, weightSum);
+
+        for (int k = 0; k < K; k++) {
+            const __m256 isUpdated = _mm256_and_ps(update, _mm256_or_ps(isMatch[k], isReplaced[k]));
+            const __m256 replacedMean = selectAVX2(newMean, dist, isReplaced[k]);
+            const __m256 replacedVariance = selectAVX2(newVariance, initialVariance, isReplaced[k]);
+
+            mean[k] = selectAVX2(mean[k], replacedMean, isUpdated);
+            variance[k] = selectAVX2(variance[k], replacedVariance, isUpdated);
+            weight[k] = selectAVX2(weight[k], _mm256_mul_ps(newWeight[k], normalization), update);
+
+            _mm256_storeu_ps(means[k] + j, mean[k]);
+            _mm256_storeu_ps(variances[k] + j, variance[k]);
+            _mm256_storeu_ps(weights[k] + j, weight[k]);
+        }
+
+        // the background is the mean of the strongest mode
+        __m256 strongestWeight = weight[0];
+        __m256 strongestMean = mean[0];
+        for (int k = 1; k < K; k++) {
+            const __m256 isStronger = _mm256_cmp_ps(weight[k], strongestWeight, _CMP_GT_OQ);
+            strongestWeight = selectAVX2(strongestWeight, weight[k], isStronger);
+            strongestMean = selectAVX2(strongestMean, mean[k], isStronger);
+        }
+
+        _mm256_storeu_ps(background + j, strongestMean);
+        numSuppressed = _mm256_sub_epi32(numSuppressed, _mm256_castps_si256(_mm256_and_ps(inShadow, isValid)));
+    }
+
+    float* meanTails[K];
+    float* varianceTails[K];
+    float* weightTails[K];
+    for (int k = 0; k < K; k++) {
+        meanTails[k] = means[k] + j;
+        varianceTails[k] = variances[k] + j;
+        weightTails[k] = weights[k] + j;
+    }
+
+    return horizontalSumAVX2(numSuppressed) +
+            updateRowScalar<K>(depth + j, matches + j, shadow + j, meanTails, varianceTails, weightTails,
+                               background + j, cols - j, learningRate);
+}
+
+#endif // POSE_SIMD_X86
+
+BackgroundMixtureKernels BackgroundMixtureKernels::get(CpuFeatures::InstructionSet instructionSet)
+{
+    BackgroundMixtureKernels kernels;
+    kernels.instructionSet = CpuFeatures::IS_SCALAR;
+    kernels.classifyRow[0] = classifyRowScalar<1>;
+    kernels.classifyRow[1] = classifyRowScalar<2>;
+    kernels.classifyRow[2] = classifyRowScalar<3>;
+    kernels.classifyRow[3] = classifyRowScalar<4>;
+    kernels.updateRow[0] = updateRowScalar<1>;
+    kernels.updateRow[1] = updateRowScalar<2>;
+    kernels.updateRow[2] = updateRowScalar<3>;
+    kernels.updateRow[3] = updateRowScalar<4>;
+
+#ifdef POSE_SIMD_X86
+    switch (instructionSet) {
+    case CpuFeatures::IS_AVX512:
+        // there are no AVX-512 kernels, the AVX2 ones are used
+    case CpuFeatures::IS_AVX2:
+        kernels.instructionSet = CpuFeatures::IS_AVX2;
+        kernels.classifyRow[0] = classifyRowAVX2<1>;
+        kernels.classifyRow[1] = classifyRowAVX2<2>;
+        kernels.classifyRow[2] = classifyRowAVX2<3>;
+        kernels.classifyRow[3] = classifyRowAVX2<4>;
+        kernels.updateRow[0] = updateRowAVX2<1>;
+        kernels.updateRow[1] = updateRowAVX2<2>;
+        kernels.updateRow[2] = updateRowAVX2<3>;
+        kernels.updateRow[3] = updateRowAVX2<4>;
+        break;
+    case CpuFeatures::IS_AVX:
+        // there are no AVX kernels, the SSE4.1 ones are used
+    case CpuFeatures::IS_SSE41:
+        kernels.instructionSet = CpuFeatures::IS_SSE41;
+        kernels.classifyRow[0] = classifyRowSSE41<1>;
+        kernels.classifyRow[1] = classifyRowSSE41<2>;
+        kernels.classifyRow[2] = classifyRowSSE41<3>;
+        kernels.classifyRow[3] = classifyRowSSE41<4>;
+        kernels.updateRow[0] = updateRowSSE41<1>;
+        kernels.updateRow[1] = updateRowSSE41<2>;
+        kernels.updateRow[2] = updateRowSSE41<3>;
+        kernels.updateRow[3] = updateRowSSE41<4>;
+        break;
+    case CpuFeatures::IS_SCALAR:
+        break;
+    }
+#else
+    (void)instructionSet;
+#endif
+
+    return kernels;
+}
+}
@@ -0,0 +1,59 @@
+#ifndef BACKGROUNDMIXTUREKERNELS_H
+#define BACKGROUNDMIXTUREKERNELS_H
+
+#include <utils/cpufeatures.h>
+
+namespace pose
+{
+/**
+ * @brief Row kernels of the mixture of gaussians in BackgroundMixture. The number of modes is a
+ * template parameter, so the modes of a pixel stay in registers and the vector versions process
+ * 4 (SSE4.1) or 8 (AVX2) pixels at once with masks and blends instead of branches. Each kernel
+ * exists as a scalar fallback and as SSE4.1 and AVX2 versions, the best version is selected at
+ * runtime. All versions produce the same results.
+ */
+struct BackgroundMixtureKernels
+{
+    static const int MAX_MODES = 4;
+
+    /**
+     * @brief Variance of a newly created mode (in square meters).
+     */
+    static const float INITIAL_VARIANCE;
+
+    /**
+     * @brief Writes the foreground depth and the foreground mask (255) of all valid pixels that
+     * neither match a background mode nor are behind the farthest background mode. The matching
+     * mode of each pixel is written to matches, valid pixels without a matching mode are marked
+     * with the number of modes and invalid pixels with -1. The modes are given as one row pointer
+     * per mode. Returns the number of foreground pixels.
+     */
+    typedef int (*ClassifyRowFunc)(const float* depth, const float* const* means, const float* const* variances,
+                                   const float* const* weights, float* foreground, unsigned char* mask,
+                                   signed char* matches, int cols, float backgroundRatio, float foregroundDistance);
+
+    /**
+     * @brief Updates the modes of all pixels with the matches of the classification, except for
+     * the pixels inside of the shadow (non-zero), and writes the background, i.e. the mean of the
+     * strongest mode. Returns the number of valid pixels that were not updated because of the
+     * shadow.
+     */
+    typedef int (*UpdateRowFunc)(const float* depth, const signed char* matches, const unsigned char* shadow,
+                                 float* const* means, float* const* variances, float* const* weights,
+                                 float* background, int cols, float learningRate);
+
+    CpuFeatures::InstructionSet instructionSet;
+
+    // indexed by the number of modes - 1
+    ClassifyRowFunc classifyRow[MAX_MODES];
+    UpdateRowFunc updateRow[MAX_MODES];
+
+    /**
+     * @brief Get the kernels for the given instruction set or the best available if the
+     * instruction set is not supported by the build.
+     */
+    static BackgroundMixtureKernels get(CpuFeatures::InstructionSet instructionSet);
+};
+}
+
+#endif // BACKGROUNDMIXTUREKERNELS_H
@@ -0,0 +1,181 @@
+#include "backgroundsnapshot.h"
+#include "staticmap.h"
+#include "backgroundmixture.h"
+#include <utils/exception.h>
+#include <cstdio>
+#include <memory>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace pose
+{
+void BackgroundSnapshot::save(const std::string& filename, const BackgroundState& state)
+{
+    const std::string tempFilename = filename + ".tmp";
+
+    FILE* stream = fopen(tempFilename.c_str(), "wb");
+    if (!stream)
+        throw Exception("could not open background snapshot " + tempFilename);
+
+    const int rows = state.planes.empty() ? 0 : state.planes[0].rows;
+    const int cols = state.planes.empty() ? 0 : state.planes[0].cols;
+    const int numPlanes = state.planes.size();
+
+    bool success = true;
+    const unsigned int header[2] = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION };
+    const int size[4] = { state.model, rows, cols, numPlanes };
+    success &= fwrite(header, sizeof(header), 1, stream) == 1;
+    success &= fwrite(size, sizeof(size), 1, stream) == 1;
+
+    for (int k = 0; k < numPlanes && success; k++) {
+        const cv::Mat& plane = state.planes[k];
+        if (plane.rows != rows || plane.cols != cols) {
+            fclose(stream);
+            remove(tempFilename.c_str());
+            throw Exception("background snapshot planes must have the same size");
+        }
+
+        const int type = plane.type();
+        const size_t rowSize = plane.cols * plane.elemSize();
+        success &= fwrite(&type, sizeof(int), 1, stream) == 1;
+        for (int i = 0; i < rows && success; i++)
+            success &= fwrite(plane.ptr(i), rowSize, 1, stream) == 1;
+    }
+
+    success &= fclose(stream) == 0;
+
+    // replace the previous snapshot only if the new one is complete, the previous snapshot stays
+    // valid until it is replaced at once
+    // NOTE: rename does not replace existing files on windows
+    if (success) {
+#ifdef _WIN32
+        success = MoveFileExA(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        success = rename(tempFilename.c_str(), filename.c_str()) == 0;
+#endif
+    }
+
+    if (!success) {
+        remove(tempFilename.c_str());
+        throw Exception("could not write background snapshot " + filename);
+    }
+}
+
+// whether the number and type of the planes match the layout of the model
+static bool isValidLayout(int model, int numPlanes, int type)
+{
+    if (model == StaticMap::BM_RUNNING_AVERAGE)
+        return numPlanes == 2 && (type == CV_32F || type == CV_16U);
+
+    if (model == StaticMap::BM_MIXTURE) {
+        // the background is followed by the same number of means, variances and weights
+        const int numModes = (numPlanes - 1) / 3;
+        return numModes >= 1 && numModes <= BackgroundMixture::MAX_MODES && numPlanes == 1 + 3 * numModes &&
+               type == CV_32F;
+    }
+
+    return false;
+}
+
+bool BackgroundSnapshot::load(const std::string& filename, int rows, int cols, BackgroundState& state)
+{
+    std::unique_ptr<FILE, int (*)(FILE*)> stream(fopen(filename.c_str(), "rb"), fclose);
+    if (!stream)
+        return false;
+
+    unsigned int header[2];
+    int size[4];
+    if (fread(header, sizeof(header), 1, stream.get()) != 1 || fread(size, sizeof(size), 1, stream.get()) != 1)
+        return false;
+
+    if (header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION || size[1] != rows || size[2] != cols)
+        return false;
+
+    // the type of the first plane is needed to check the layout, all planes have the same type
+    int type;
+    if (fread(&type, sizeof(int), 1, stream.get()) != 1 || !isValidLayout(size[0], size[3], type))
+        return false;
+
+    BackgroundState loadedState;
+    loadedState.model = size[0];
+    loadedState.planes.resize(size[3]);
+
+    for (int k = 0; k < size[3]; k++) {
+        int planeType = type;
+        if (k > 0 && (fread(&planeType, sizeof(int), 1, stream.get()) != 1 || planeType != type))
+            return false;
+
+        cv::Mat& plane = loadedState.planes[k];
+        plane.create(rows, cols, type);
+        const size_t rowSize = plane.cols * plane.elemSize();
+        for (int i = 0; i < plane.rows; i++) {
+            if (fread(plane.ptr(i), rowSize, 1, stream.get()) != 1)
+                return false;
+        }
+    }
+
+    state = loadedState;
+    return true;
+}
+
+BackgroundSnapshotWriter::BackgroundSnapshotWriter(std::string filename)
+    : m_filename(filename),
+      m_hasState(false)
+{
+    m_terminateThread = false;
+    m_thread = new boost::thread(&BackgroundSnapshotWriter::writeLoop, this);
+}
+
+BackgroundSnapshotWriter::~BackgroundSnapshotWriter()
+{
+    // signal the thread to exit, it writes the pending state first
+    m_mutex.lock();
+    m_terminateThread = true;
+    m_condition.notify_one();
+    m_mutex.unlock();
+    m_thread->join();
+    delete m_thread;
+}
+
+void BackgroundSnapshotWriter::write(BackgroundState& state)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+
+    // replace a state that has not been written yet
+    m_state.model = state.model;
+    m_state.planes.swap(state.planes);
+    m_hasState = true;
+
+    m_condition.notify_one();
+}
+
+void BackgroundSnapshotWriter::writeLoop()
+{
+    BackgroundState state;
+
+    while (true) {
+        // wait until there is a new state
+        boost::mutex::scoped_lock lock(m_mutex);
+        while (!m_hasState && !m_terminateThread)
+            m_condition.wait(lock);
+
+        if (!m_hasState && m_terminateThread)
+            break;
+
+        state.model = m_state.model;
+        state.planes.swap(m_state.planes);
+        m_hasState = false;
+        lock.unlock();
+
+        try {
+            BackgroundSnapshot::save(m_filename, state);
+        }
+        catch (const Exception& exception) {
+            printf("Exception: %s", exception.what());
+        }
+    }
+}
+}
@@ -0,0 +1,91 @@
+#ifndef BACKGROUNDSNAPSHOT_H
+#define BACKGROUNDSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace pose
+{
+/**
+ * @brief The state of a background model, i.e. everything that is needed to continue the
+ * segmentation after a restart. The meaning of the planes depends on the model (see StaticMap).
+ */
+struct BackgroundState
+{
+    int model;
+    std::vector<cv::Mat> planes;
+};
+
+/**
+ * @brief Reads and writes background states as binary files with the following layout (all
+ * values in native byte order):
+ *
+ *   uint32  magic (SNAPSHOT_MAGIC)
+ *   uint32  version (SNAPSHOT_VERSION)
+ *   int32   model
+ *   int32   rows
+ *   int32   cols
+ *   int32   number of planes
+ *   for each plane:
+ *     int32   type (OpenCV type of the plane)
+ *     bytes   rows * cols * element size of the plane, row by row
+ */
+class BackgroundSnapshot
+{
+public:
+    static const unsigned int SNAPSHOT_MAGIC = 0x53474250;   // "PBGS"
+    static const unsigned int SNAPSHOT_VERSION = 1;
+
+    /**
+     * @brief Write the state to the file. The file is written under a temporary name first and
+     * then renamed, so an existing snapshot is never left partially written.
+     */
+    static void save(const std::string& filename, const BackgroundState& state);
+
+    /**
+     * @brief Read a state from the file. Returns false if the file does not exist, has a different
+     * version, does not contain a complete snapshot, or if the header does not describe a state of
+     * the given size with the planes of a known model (see StaticMap::getState). Nothing is
+     * allocated before the header has been checked.
+     */
+    static bool load(const std::string& filename, int rows, int cols, BackgroundState& state);
+};
+
+/**
+ * @brief Writes background snapshots on a separate thread, so that the processing is not blocked
+ * by the file system. Only the most recent state is kept if the thread can not keep up.
+ */
+class BackgroundSnapshotWriter
+{
+public:
+    BackgroundSnapshotWriter(std::string filename);
+
+    /**
+     * @brief Writes the pending state, if there is any, before the thread is stopped.
+     */
+    ~BackgroundSnapshotWriter();
+
+    /**
+     * @brief Queue the state to be written. The state is taken over by the writer.
+     */
+    void write(BackgroundState& state);
+
+private:
+    void writeLoop();
+
+    std::string m_filename;
+
+    BackgroundState m_state;
+    bool m_hasState;
+    boost::thread* m_thread;
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    bool m_terminateThread;
+};
+}
+
+#endif // BACKGROUNDSNAPSHOT_H
@@ -0,0 +1,217 @@
+#include "componenttable.h"
+#include <utils/cpufeatures.h>
+#include <Eigen/Eigenvalues>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+// ---------------------------------------------------------------------------------------------
+// sums of the points of a span, in the order x, y, z, xx, xy, xz, yy, yz, zz, the partial sums of
+// a span are accumulated in float and added to the double sums of the component
+// ---------------------------------------------------------------------------------------------
+
+typedef void (*SumPointsFunc)(const cv::Vec3f* points, int count, double* sums);
+
+static void sumPointsScalar(const cv::Vec3f* points, int count, double* sums)
+{
+    float partial[9] = { 0 };
+
+    for (int k = 0; k < count; k++) {
+        const float x = points[k][0];
+        const float y = points[k][1];
+        const float z = points[k][2];
+
+        partial[0] += x;
+        partial[1] += y;
+        partial[2] += z;
+        partial[3] += x * x;
+        partial[4] += x * y;
+        partial[5] += x * z;
+        partial[6] += y * y;
+        partial[7] += y * z;
+        partial[8] += z * z;
+    }
+
+    for (int k = 0; k < 9; k++)
+        sums[k] += partial[k];
+}
+
+#ifdef POSE_SIMD_X86
+
+POSE_TARGET("sse4.1")
+static void sumPointsSSE41(const cv::Vec3f* points, int count, double* sums)
+{
+    const float* p = &points[0][0];
+    const int numValues = 3 * count;
+
+    // 4 points are 3 vectors of interleaved x, y and z, so the component of every lane repeats
+    // after 3 vectors. The products of a value with the next and the second next value contain
+    // xy, yz and xz in the lanes of x and y. The loop stops 2 values early to not read beyond the
+    // span.
+    __m128 sum[3], squares[3], nextProducts[3], secondProducts[3];
+    for (int k = 0; k < 3; k++)
+        sum[k] = squares[k] = nextProducts[k] = secondProducts[k] = _mm_setzero_ps();
+
+    int i = 0;
+    for (; i + 14 <= numValues; i += 12) {
+        for (int k = 0; k < 3; k++) {
+            const __m128 v = _mm_loadu_ps(p + i + 4 * k);
+            sum[k] = _mm_add_ps(sum[k], v);
+            squares[k] = _mm_add_ps(squares[k], _mm_mul_ps(v, v));
+            nextProducts[k] = _mm_add_ps(nextProducts[k], _mm_mul_ps(v, _mm_loadu_ps(p + i + 4 * k + 1)));
+            secondProducts[k] = _mm_add_ps(secondProducts[k], _mm_mul_ps(v, _mm_loadu_ps(p + i + 4 * k + 2)));
+        }
+    }
+
+    float lanes[4][12];
+    for (int k = 0; k < 3; k++) {
+        _mm_storeu_ps(lanes[0] + 4 * k, sum[k]);
+        _mm_storeu_ps(lanes[1] + 4 * k, squares[k]);
+        _mm_storeu_ps(lanes[2] + 4 * k, nextProducts[k]);
+        _mm_storeu_ps(lanes[3] + 4 * k, secondProducts[k]);
+    }
+
+    float partial[9] = { 0 };
+    for (int k = 0; k < 12; k++) {
+        const int component = k % 3;
+        partial[component] += lanes[0][k];
+        partial[component == 0 ? 3 : component == 1 ? 6 : 8] += lanes[1][k];
+
+        if (component == 0) {
+            partial[4] += lanes[2][k];
+            partial[5] += lanes[3][k];
+        } else if (component == 1) {
+            partial[7] += lanes[2][k];
+        }
+    }
+
+    for (int k = 0; k < 9; k++)
+        sums[k] += partial[k];
+
+    sumPointsScalar(points + i / 3, count - i / 3, sums);
+}
+
+#endif // POSE_SIMD_X86
+
+// sum of the integers [0, n]
+static inline double sumTo(double n)
+{
+    return n * (n + 1) / 2;
+}
+
+// sum of the squares of the integers [0, n]
+static inline double sumSquaresTo(double n)
+{
+    return n * (n + 1) * (2 * n + 1) / 6;
+}
+
+int ComponentTable::size() const
+{
+    return ids.size();
+}
+
+void ComponentTable::clear()
+{
+    ids.clear();
+    areas.clear();
+    boundingBoxes2d.clear();
+    boundingBoxes3d.clear();
+    centers.clear();
+    centers3d.clear();
+    centerDepths.clear();
+    covariances.clear();
+    covariances3d.clear();
+    principalAxes.clear();
+    principalAxes3d.clear();
+    spans.clear();
+    spanOffsets.clear();
+    neighbors.clear();
+    borderLengths.clear();
+    depthGaps.clear();
+    adjacencyOffsets.clear();
+}
+
+void ComponentTable::add(unsigned int id, int area, const BoundingBox2D& boundingBox2d,
+                         const BoundingBox3D& boundingBox3d, const cv::Point2f& center, float centerDepth)
+{
+    ids.push_back(id);
+    areas.push_back(area);
+    boundingBoxes2d.push_back(boundingBox2d);
+    boundingBoxes3d.push_back(boundingBox3d);
+    centers.push_back(center);
+    centers3d.push_back(cv::Point3f());
+    centerDepths.push_back(centerDepth);
+    covariances.push_back(cv::Vec3f());
+    covariances3d.push_back(cv::Vec6f());
+    principalAxes.push_back(cv::Point2f());
+    principalAxes3d.push_back(cv::Point3f());
+}
+
+void ComponentTable::computeMoments(const cv::Mat& pointCloud, int begin, int end)
+{
+    SumPointsFunc sumPoints = sumPointsScalar;
+#ifdef POSE_SIMD_X86
+    if (CpuFeatures::getInstructionSet() >= CpuFeatures::IS_SSE41)
+        sumPoints = sumPointsSSE41;
+#endif
+
+    for (int k = begin; k < end; k++) {
+        double sums2d[5] = { 0 };   // x, y, xx, xy, yy
+        double sums3d[9] = { 0 };
+
+        for (int s = spanOffsets[k]; s < spanOffsets[k + 1]; s++) {
+            const BitMask::Run& span = spans[s];
+            const double length = span.end - span.begin;
+            const double sumX = sumTo(span.end - 1) - sumTo(span.begin - 1);
+
+            // the pixel moments of a span have a closed form
+            sums2d[0] += sumX;
+            sums2d[1] += length * span.row;
+            sums2d[2] += sumSquaresTo(span.end - 1) - sumSquaresTo(span.begin - 1);
+            sums2d[3] += sumX * span.row;
+            sums2d[4] += length * span.row * span.row;
+
+            sumPoints(pointCloud.ptr<cv::Vec3f>(span.row) + span.begin, span.end - span.begin, sums3d);
+        }
+
+        const double area = areas[k];
+        const double meanX = sums2d[0] / area;
+        const double meanY = sums2d[1] / area;
+        const double xx = sums2d[2] / area - meanX * meanX;
+        const double xy = sums2d[3] / area - meanX * meanY;
+        const double yy = sums2d[4] / area - meanY * meanY;
+        covariances[k] = cv::Vec3f((float)xx, (float)xy, (float)yy);
+
+        // the major axis of the ellipse with the same second moments
+        const double angle = 0.5 * std::atan2(2 * xy, xx - yy);
+        principalAxes[k] = cv::Point2f((float)std::cos(angle), (float)std::sin(angle));
+
+        const double mean[3] = { sums3d[0] / area, sums3d[1] / area, sums3d[2] / area };
+        centers3d[k] = cv::Point3f((float)mean[0], (float)mean[1], (float)mean[2]);
+
+        Eigen::Matrix3f covariance;
+        covariance(0, 0) = (float)(sums3d[3] / area - mean[0] * mean[0]);
+        covariance(0, 1) = covariance(1, 0) = (float)(sums3d[4] / area - mean[0] * mean[1]);
+        covariance(0, 2) = covariance(2, 0) = (float)(sums3d[5] / area - mean[0] * mean[2]);
+        covariance(1, 1) = (float)(sums3d[6] / area - mean[1] * mean[1]);
+        covariance(1, 2) = covariance(2, 1) = (float)(sums3d[7] / area - mean[1] * mean[2]);
+        covariance(2, 2) = (float)(sums3d[8] / area - mean[2] * mean[2]);
+
+        cv::Vec6f& covariance3d = covariances3d[k];
+        covariance3d[0] = covariance(0, 0);
+        covariance3d[1] = covariance(0, 1);
+        covariance3d[2] = covariance(0, 2);
+        covariance3d[3] = covariance(1, 1);
+        covariance3d[4] = covariance(1, 2);
+        covariance3d[5] = covariance(2, 2);
+
+        // the eigenvalues are sorted in increasing order
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
+        const Eigen::Vector3f axis = solver.eigenvectors().col(2);
+        principalAxes3d[k] = cv::Point3f(axis(0), axis(1), axis(2));
+    }
+}
+}
@@ -0,0 +1,67 @@
+#ifndef COMPONENTTABLE_H
+#define COMPONENTTABLE_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <utils/boundingbox2d.h>
+#include <utils/boundingbox3d.h>
+#include <utils/bitmask.h>
+
+namespace pose
+{
+/**
+ * @brief Statistics of the connected components of a frame with one column per statistic. The
+ * components are in raster order of their first pixel, the label of the component at the index k
+ * is ids[k], which is k + 1 unless the labels are kept stable across frames.
+ */
+struct ComponentTable
+{
+    std::vector<unsigned int>   ids;
+    std::vector<int>            areas;
+    std::vector<BoundingBox2D>  boundingBoxes2d;
+    std::vector<BoundingBox3D>  boundingBoxes3d;
+
+    // mean pixel position and mean point (first moments divided by the area)
+    std::vector<cv::Point2f>    centers;
+    std::vector<cv::Point3f>    centers3d;
+    std::vector<float>          centerDepths;       // depth at the pixel of the center
+
+    // central second moments divided by the area, (xx, xy, yy) and (xx, xy, xz, yy, yz, zz)
+    std::vector<cv::Vec3f>      covariances;
+    std::vector<cv::Vec6f>      covariances3d;
+
+    // unit direction of the largest extent, i.e. the orientation of the component
+    std::vector<cv::Point2f>    principalAxes;
+    std::vector<cv::Point3f>    principalAxes3d;
+
+    // the spans of the component at index k are [spanOffsets[k], spanOffsets[k + 1]) in raster order
+    std::vector<BitMask::Run>   spans;
+    std::vector<int>            spanOffsets;
+
+    // the components that touch the component at index k without being connected to it (their
+    // depth differs too much) are [adjacencyOffsets[k], adjacencyOffsets[k + 1]) of the neighbor
+    // columns, with the number of neighboring pixel pairs on the border and the smallest depth
+    // difference across it
+    std::vector<int>            neighbors;          // index of the neighbor
+    std::vector<int>            borderLengths;
+    std::vector<float>          depthGaps;
+    std::vector<int>            adjacencyOffsets;
+
+    int size() const;
+    void clear();
+
+    /**
+     * @brief Appends a component, the moments are left empty until computeMoments is called.
+     */
+    void add(unsigned int id, int area, const BoundingBox2D& boundingBox2d, const BoundingBox3D& boundingBox3d,
+             const cv::Point2f& center, float centerDepth);
+
+    /**
+     * @brief Computes the second moments, the 3D center and the principal axes of the components
+     * [begin, end) from their spans. Different ranges can be computed in parallel.
+     */
+    void computeMoments(const cv::Mat& pointCloud, int begin, int end);
+};
+}
+
+#endif // COMPONENTTABLE_H
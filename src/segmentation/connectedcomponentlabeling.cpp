@@ -1,15 +1,164 @@
 #include "connectedcomponentlabeling.h"
 #include <utils/utils.h>
-#include <stack>
-#include <queue>
+#include <utils/threadpool.h>
+#include <utils/cpufeatures.h>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
 
 namespace pose
 {
+// ---------------------------------------------------------------------------------------------
+// neighbor predicates, each compares the pixels of two rows at the same index, the left neighbors
+// are compared by passing the row shifted by one pixel
+// ---------------------------------------------------------------------------------------------
+
+static void connectRowDepthScalar(const float* depth, const float* otherDepth, const cv::Vec3f*,
+                                  const cv::Vec3f*, uchar* connected, int cols, float maxDistance)
+{
+    for (int j = 0; j < cols; j++) {
+        const bool isConnected = depth[j] > 0 && otherDepth[j] > 0 && std::abs(depth[j] - otherDepth[j]) <= maxDistance;
+        connected[j] = isConnected ? 255 : 0;
+    }
+}
+
+static void connectRowEuclideanScalar(const float* depth, const float* otherDepth, const cv::Vec3f* points,
+                                      const cv::Vec3f* otherPoints, uchar* connected, int cols, float maxDistance)
+{
+    const float maxSquaredDistance = maxDistance * maxDistance;
+
+    for (int j = 0; j < cols; j++) {
+        const float dx = points[j][0] - otherPoints[j][0];
+        const float dy = points[j][1] - otherPoints[j][1];
+        const float dz = points[j][2] - otherPoints[j][2];
+
+        const bool isConnected = depth[j] > 0 && otherDepth[j] > 0 && dx * dx + dy * dy + dz * dz <= maxSquaredDistance;
+        connected[j] = isConnected ? 255 : 0;
+    }
+}
+
+#ifdef POSE_SIMD_X86
+
+POSE_TARGET("sse4.1")
+static inline void storeConnectedSSE41(uchar* connected, __m128 isConnected)
+{
+    // all bits set (-1) saturates to 0xff
+    const __m128i words = _mm_packs_epi32(_mm_castps_si128(isConnected), _mm_castps_si128(isConnected));
+    const int bytes = _mm_cvtsi128_si32(_mm_packs_epi16(words, words));
+    memcpy(connected, &bytes, sizeof(int));
+}
+
+POSE_TARGET("sse4.1")
+static void connectRowDepthSSE41(const float* depth, const float* otherDepth, const cv::Vec3f* points,
+                                 const cv::Vec3f* otherPoints, uchar* connected, int cols, float maxDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 distance = _mm_set1_ps(maxDistance);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 d = _mm_loadu_ps(depth + j);
+        const __m128 other = _mm_loadu_ps(otherDepth + j);
+        const __m128 diff = _mm_andnot_ps(signMask, _mm_sub_ps(d, other));
+
+        const __m128 isValid = _mm_and_ps(_mm_cmpgt_ps(d, zero), _mm_cmpgt_ps(other, zero));
+        storeConnectedSSE41(connected + j, _mm_and_ps(isValid, _mm_cmple_ps(diff, distance)));
+    }
+
+    connectRowDepthScalar(depth + j, otherDepth + j, points + j, otherPoints + j, connected + j, cols - j, maxDistance);
+}
+
+POSE_TARGET("sse4.1")
+static void connectRowEuclideanSSE41(const float* depth, const float* otherDepth, const cv::Vec3f* points,
+                                     const cv::Vec3f* otherPoints, uchar* connected, int cols, float maxDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maxSquaredDistance = _mm_set1_ps(maxDistance * maxDistance);
+    const float* p = &points[0][0];
+    const float* q = &otherPoints[0][0];
+
+    // each point is loaded with the x of the next point as fourth element, so that the differences
+    // of 4 points can be transposed into x, y and z vectors, the last point is done by the scalar
+    // version to not read beyond the row
+    int j = 0;
+    for (; j + 5 <= cols; j += 4) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(p + 3 * j), _mm_loadu_ps(q + 3 * j));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(p + 3 * j + 3), _mm_loadu_ps(q + 3 * j + 3));
+        __m128 d2 = _mm_sub_ps(_mm_loadu_ps(p + 3 * j + 6), _mm_loadu_ps(q + 3 * j + 6));
+        __m128 d3 = _mm_sub_ps(_mm_loadu_ps(p + 3 * j + 9), _mm_loadu_ps(q + 3 * j + 9));
+        _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+        const __m128 squaredDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+
+        const __m128 d = _mm_loadu_ps(depth + j);
+        const __m128 other = _mm_loadu_ps(otherDepth + j);
+        const __m128 isValid = _mm_and_ps(_mm_cmpgt_ps(d, zero), _mm_cmpgt_ps(other, zero));
+        storeConnectedSSE41(connected + j, _mm_and_ps(isValid, _mm_cmple_ps(squaredDistance, maxSquaredDistance)));
+    }
+
+    connectRowEuclideanScalar(depth + j, otherDepth + j, points + j, otherPoints + j, connected + j, cols - j, maxDistance);
+}
+
+#endif // POSE_SIMD_X86
+
+// NOTE: the union-find is shared by all bands. While a band is labelled, only that band accesses
+// its labels. When the bands are merged, the links are set with a compare-and-swap on the roots and
+// always point to the smaller label, so the root of a component is its first label in raster order
+// no matter in which order the borders are merged. Compressing a path only changes the parent of a
+// label that is not a root to one of its ancestors, which is safe while other threads merge.
+static inline int findRoot(std::atomic<int>* parents, int label)
+{
+    int parent = parents[label].load(std::memory_order_relaxed);
+    while (parent != label) {
+        const int grandParent = parents[parent].load(std::memory_order_relaxed);
+        if (grandParent != parent)
+            parents[label].store(grandParent, std::memory_order_relaxed);
+
+        label = parent;
+        parent = grandParent;
+    }
+    return label;
+}
+
+static inline void merge(std::atomic<int>* parents, int label, int otherLabel)
+{
+    while (true) {
+        int root = findRoot(parents, label);
+        int otherRoot = findRoot(parents, otherLabel);
+        if (root == otherRoot)
+            return;
+
+        // the smaller label becomes the root, retry if the larger root has been linked meanwhile
+        if (root > otherRoot)
+            std::swap(root, otherRoot);
+        if (parents[otherRoot].compare_exchange_weak(otherRoot, root))
+            return;
+    }
+}
+
 ConnectedComponentLabeling::ConnectedComponentLabeling()
     : Module("ConnectedComponentLabeling"),
-      m_maxDistance(0.1f)
+      m_isColoredLabelMapValid(false),
+      m_hasComponents(false),
+      m_maxDistance(0.1f),
+      m_minArea(2),
+      m_minMetricArea(0),
+      m_fx(0),
+      m_fy(0),
+      m_maxComponents(0),
+      m_numRejectedComponents(0),
+      m_temporalLabels(false),
+      m_nextTemporalLabel(1),
+      m_connectRow(0)
 {
     setMaxDistance(0.3f);
+    setDistanceMode(DM_DEPTH);
+    setNumBands(ThreadPool::instance().getNumThreads());
 }
 
 ConnectedComponentLabeling::~ConnectedComponentLabeling()
@@ -21,11 +170,94 @@ void ConnectedComponentLabeling::setMaxDistance(float maxDistance)
     m_maxDistance = maxDistance;
 }
 
+void ConnectedComponentLabeling::setDistanceMode(DistanceMode mode)
+{
+    m_distanceMode = mode;
+}
+
+ConnectedComponentLabeling::DistanceMode ConnectedComponentLabeling::getDistanceMode() const
+{
+    return m_distanceMode;
+}
+
+void ConnectedComponentLabeling::setMinArea(int minArea)
+{
+    m_minArea = std::max(1, minArea);
+}
+
+void ConnectedComponentLabeling::setMinMetricArea(float minMetricArea)
+{
+    m_minMetricArea = std::max(0.0f, minMetricArea);
+}
+
+void ConnectedComponentLabeling::setFocalLength(float fx, float fy)
+{
+    m_fx = fx;
+    m_fy = fy;
+}
+
+void ConnectedComponentLabeling::setMaxComponents(int maxComponents)
+{
+    m_maxComponents = std::max(0, maxComponents);
+}
+
+int ConnectedComponentLabeling::getNumRejectedComponents() const
+{
+    return m_numRejectedComponents;
+}
+
+void ConnectedComponentLabeling::setTemporalLabels(bool enabled)
+{
+    if (enabled == m_temporalLabels)
+        return;
+
+    // start over, the last label map does not contain temporal labels
+    m_temporalLabels = enabled;
+    m_previousLabelMap.release();
+    m_nextTemporalLabel = 1;
+}
+
+bool ConnectedComponentLabeling::hasTemporalLabels() const
+{
+    return m_temporalLabels;
+}
+
+void ConnectedComponentLabeling::setNumBands(int numBands)
+{
+    m_numBands = std::max(1, numBands);
+}
+
 const std::vector<std::shared_ptr<ConnectedComponent>>& ConnectedComponentLabeling::getComponents() const
 {
+    if (m_hasComponents)
+        return m_components;
+
+    m_components.clear();
+    for (int k = 0; k < m_table.size(); k++) {
+        std::shared_ptr<ConnectedComponent> component(new ConnectedComponent());
+        component->id = m_table.ids[k];
+        component->area = m_table.areas[k];
+        component->boundingBox2d = m_table.boundingBoxes2d[k];
+        component->boundingBox3d = m_table.boundingBoxes3d[k];
+        component->centerOfMass = m_table.centers[k];
+        component->centerDepth = m_table.centerDepths[k];
+        component->spans.assign(m_table.spans.begin() + m_table.spanOffsets[k],
+                                m_table.spans.begin() + m_table.spanOffsets[k + 1]);
+
+        for (int n = m_table.adjacencyOffsets[k]; n < m_table.adjacencyOffsets[k + 1]; n++)
+            component->nearbyIds.push_back(m_table.ids[m_table.neighbors[n]]);
+        m_components.push_back(component);
+    }
+
+    m_hasComponents = true;
     return m_components;
 }
 
+const ComponentTable& ConnectedComponentLabeling::getComponentTable() const
+{
+    return m_table;
+}
+
 const cv::Mat& ConnectedComponentLabeling::getLabelMap() const
 {
     return m_labelMap;
@@ -33,142 +265,532 @@ const cv::Mat& ConnectedComponentLabeling::getLabelMap() const
 
 cv::Mat ConnectedComponentLabeling::getColoredLabelMap()
 {
-    Utils::getColoredLabelMap(m_labelMap, m_coloredLabelMap);
+    if (!m_isColoredLabelMapValid) {
+        Utils::getColoredLabelMap(m_labelMap, m_coloredLabelMap);
+        m_isColoredLabelMapValid = true;
+    }
     return m_coloredLabelMap;
 }
 
 void ConnectedComponentLabeling::process(const cv::Mat& foreground,
-                                         const cv::Mat& pointCloud)
+                                         const cv::Mat& pointCloud,
+                                         const BitMask* foregroundTiles,
+                                         int tileSize)
 {
     begin();
 
+    // keep the labels of the last frame to seed the new ones
+    if (m_temporalLabels)
+        std::swap(m_labelMap, m_previousLabelMap);
+
     // create a new label map
     if (foreground.cols != m_labelMap.cols || foreground.rows != m_labelMap.rows) {
         m_labelMap = cv::Mat(foreground.rows, foreground.cols, CV_32S);
-        m_tempMask = cv::Mat(foreground.rows + 2, foreground.cols + 2, CV_8UC1);
+        m_parents.reset(new std::atomic<int>[foreground.rows * foreground.cols + 1]);
+        m_finalLabels.resize(foreground.rows * foreground.cols + 1);
     }
-    m_labelMap.setTo(0);
 
+    m_table.clear();
     m_components.clear();
+    m_hasComponents = false;
+    m_isColoredLabelMapValid = false;
+    m_numRejectedComponents = 0;
+    m_parents[0] = 0;
+
+    // select the predicate of the neighbors
+    m_connectRow = m_distanceMode == DM_EUCLIDEAN ? connectRowEuclideanScalar : connectRowDepthScalar;
+#ifdef POSE_SIMD_X86
+    if (CpuFeatures::getInstructionSet() >= CpuFeatures::IS_SSE41)
+        m_connectRow = m_distanceMode == DM_EUCLIDEAN ? connectRowEuclideanSSE41 : connectRowDepthSSE41;
+#endif
+
+    // bands that are not processed (there are less rows than bands) stay empty
+    m_bands.resize(m_numBands);
+    for (Band& band : m_bands) {
+        band.begin = band.end = band.firstLabel = 0;
+        band.stats.clear();
+        band.spans.clear();
+        band.spanLabels.clear();
+        band.edges.clear();
+    }
 
-    // find connected components until each point has been labelled
-    unsigned int nextLabel = 1;
-    for (int i = 0; i < foreground.cols; i++) {
-        for (int j = 0; j < foreground.rows; j++) {
-            cv::Point curPoint(i, j);
-            const unsigned int& label = m_labelMap.at<unsigned int>(curPoint);
-            const float& depth = foreground.at<float>(curPoint);
-
-            if (depth > 0 && label == 0) {
-                findConnectedComponents(foreground, pointCloud, curPoint, nextLabel);
-                nextLabel++;
+    ThreadPool& threadPool = ThreadPool::instance();
+
+    // label each band on its own
+    threadPool.parallelFor(0, foreground.rows, m_numBands, [&](int band, int begin, int end) {
+        m_bands[band].begin = begin;
+        m_bands[band].end = end;
+        labelBand(foreground, pointCloud, foregroundTiles, tileSize, m_bands[band]);
+    });
+
+    // merge the labels across the borders between the bands, all borders at the same time
+    threadPool.parallelFor(1, m_numBands, m_numBands - 1, [&](int, int begin, int end) {
+        for (int band = begin; band < end; band++) {
+            if (m_bands[band].begin > 0)
+                mergeBorder(foreground, pointCloud, m_bands[band]);
+        }
+    });
+
+    createComponents(foreground);
+    createAdjacency();
+
+    // replace the provisional labels with the final ones and collect the spans of equal labels
+    threadPool.parallelFor(0, foreground.rows, m_numBands, [&](int band, int begin, int end) {
+        std::vector<BitMask::Run>& spans = m_bands[band].spans;
+        std::vector<int>& spanLabels = m_bands[band].spanLabels;
+        spans.clear();
+        spanLabels.clear();
+
+        for (int i = begin; i < end; i++) {
+            int* labelRow = m_labelMap.ptr<int>(i);
+            int spanLabel = 0;
+
+            for (int j = 0; j < foreground.cols; j++) {
+                const int label = m_finalLabels[labelRow[j]];
+                labelRow[j] = label;
+
+                if (label == spanLabel)
+                    continue;
+
+                if (spanLabel != 0)
+                    spans.back().end = j;
+                if (label != 0) {
+                    BitMask::Run span = { i, j, foreground.cols };
+                    spans.push_back(span);
+                    spanLabels.push_back(label);
+                }
+                spanLabel = label;
             }
         }
+    });
+
+    // sort the spans by their component, the bands are in raster order, so are the spans of each
+    // component
+    std::vector<int>& spanOffsets = m_table.spanOffsets;
+    spanOffsets.assign(m_table.size() + 1, 0);
+    for (const Band& band : m_bands) {
+        for (int label : band.spanLabels)
+            spanOffsets[label]++;
+    }
+    for (int k = 0; k < m_table.size(); k++)
+        spanOffsets[k + 1] += spanOffsets[k];
+
+    m_table.spans.resize(spanOffsets.back());
+    std::vector<int> nextSpans(spanOffsets.begin(), spanOffsets.end() - 1);
+    for (const Band& band : m_bands) {
+        for (size_t k = 0; k < band.spans.size(); k++)
+            m_table.spans[nextSpans[band.spanLabels[k] - 1]++] = band.spans[k];
     }
 
-    // get nearby components
-    //for (size_t i = 0; i < m_components.size(); i++) {
-    //    std::shared_ptr<ConnectedComponent>& component = m_components[i];
-    //    component->nearbyIds = findNearbyComponents(component->id);
-    //}
+    // the moments of the components are independent of each other
+    threadPool.parallelFor(0, m_table.size(), m_numBands, [&](int, int begin, int end) {
+        m_table.computeMoments(pointCloud, begin, end);
+    });
+
+    if (m_temporalLabels)
+        assignTemporalLabels();
 
     end();
 }
 
-void ConnectedComponentLabeling::findConnectedComponents(const cv::Mat& foreground,
-                                                         const cv::Mat& pointCloud,
-                                                         const cv::Point& seed,
-                                                         unsigned int label)
+void ConnectedComponentLabeling::addEdge(std::vector<Edge>& edges, int label, int otherLabel, float depthGap)
 {
-    m_tempMask.setTo(0);
+    // a border along a row shows up as the same pair of labels again and again
+    if (!edges.empty() && edges.back().label == label && edges.back().otherLabel == otherLabel) {
+        edges.back().length++;
+        edges.back().depthGap = std::min(edges.back().depthGap, depthGap);
+        return;
+    }
+
+    Edge edge = { label, otherLabel, 1, depthGap };
+    edges.push_back(edge);
+}
+
+void ConnectedComponentLabeling::createAdjacency()
+{
+    // the edges of the final labels, in both directions
+    std::vector<Edge> edges;
+    for (const Band& band : m_bands) {
+        for (const Edge& edge : band.edges) {
+            const int label = m_finalLabels[edge.label];
+            const int otherLabel = m_finalLabels[edge.otherLabel];
+            if (label == 0 || otherLabel == 0 || label == otherLabel)
+                continue;
+
+            Edge finalEdge = { label - 1, otherLabel - 1, edge.length, edge.depthGap };
+            edges.push_back(finalEdge);
+            std::swap(finalEdge.label, finalEdge.otherLabel);
+            edges.push_back(finalEdge);
+        }
+    }
 
-    int flags = 4 | (255 << 8) | cv::FLOODFILL_MASK_ONLY;
-    cv::floodFill(foreground, m_tempMask, seed, cv::Scalar(0), 0, cv::Scalar(m_maxDistance), cv::Scalar(m_maxDistance), flags);
+    std::sort(edges.begin(), edges.end(), [](const Edge& edge, const Edge& other) {
+        return edge.label < other.label || (edge.label == other.label && edge.otherLabel < other.otherLabel);
+    });
 
-    int size = 0;
+    // combine the edges of the same pair of components
+    std::vector<int>& offsets = m_table.adjacencyOffsets;
+    offsets.assign(m_table.size() + 1, 0);
 
-    // initialize bounding box
-    float bbMinDepth = 1000;
-    float bbMaxDepth = 0;
-    cv::Point bbMinPoint(foreground.cols, foreground.rows);
-    cv::Point bbMaxPoint(0, 0);
+    for (size_t k = 0; k < edges.size(); k++) {
+        const Edge& edge = edges[k];
+        if (k > 0 && edge.label == edges[k - 1].label && edge.otherLabel == edges[k - 1].otherLabel) {
+            m_table.borderLengths.back() += edge.length;
+            m_table.depthGaps.back() = std::min(m_table.depthGaps.back(), edge.depthGap);
+            continue;
+        }
 
-    cv::Point3f bbMinPoint3d(1000, 1000, 1000);
-    cv::Point3f bbMaxPoint3d(-1000, -1000, -1);
+        m_table.neighbors.push_back(edge.otherLabel);
+        m_table.borderLengths.push_back(edge.length);
+        m_table.depthGaps.push_back(edge.depthGap);
+        offsets[edge.label + 1]++;
+    }
+
+    for (int k = 0; k < m_table.size(); k++)
+        offsets[k + 1] += offsets[k];
+}
+
+void ConnectedComponentLabeling::assignTemporalLabels()
+{
+    struct Vote
+    {
+        int count;
+        int index;
+        unsigned int label;
+
+        bool operator<(const Vote& other) const {
+            if (count != other.count)
+                return count > other.count;
+            if (index != other.index)
+                return index < other.index;
+            return label < other.label;
+        }
+    };
+
+    const int numComponents = m_table.size();
+    const bool hasPreviousLabels = m_previousLabelMap.size() == m_labelMap.size();
+
+    // count the pixels of each component per label of the last frame, the components are labelled
+    // in parallel, the votes of each component are only a few since the components barely move
+    std::vector<std::vector<Vote>> votes(numComponents);
+    if (hasPreviousLabels) {
+        ThreadPool::instance().parallelFor(0, numComponents, m_numBands, [&](int, int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                std::vector<Vote>& componentVotes = votes[k];
+
+                for (int s = m_table.spanOffsets[k]; s < m_table.spanOffsets[k + 1]; s++) {
+                    const BitMask::Run& span = m_table.spans[s];
+                    const int* previousRow = m_previousLabelMap.ptr<int>(span.row);
+
+                    for (int j = span.begin; j < span.end;) {
+                        // count runs of the same label at once
+                        const int label = previousRow[j];
+                        const int runBegin = j;
+                        while (j < span.end && previousRow[j] == label)
+                            j++;
+
+                        if (label == 0)
+                            continue;
+
+                        auto it = componentVotes.begin();
+                        while (it != componentVotes.end() && it->label != (unsigned int)label)
+                            it++;
+
+                        if (it == componentVotes.end()) {
+                            Vote vote = { 0, k, (unsigned int)label };
+                            it = componentVotes.insert(componentVotes.end(), vote);
+                        }
+                        it->count += j - runBegin;
+                    }
+                }
+            }
+        });
+    }
 
-    float m10 = 0, m01 = 0;
+    std::vector<Vote> allVotes;
+    for (const std::vector<Vote>& componentVotes : votes)
+        allVotes.insert(allVotes.end(), componentVotes.begin(), componentVotes.end());
 
-    for (int i = 1; i < m_tempMask.rows - 1; i++) {
-        const uchar* maskRow = m_tempMask.ptr<uchar>(i);
-        unsigned int* labelRow = m_labelMap.ptr<unsigned int>(i - 1);
-        const float* foregroundRow = foreground.ptr<float>(i - 1);
-        const cv::Vec3f* pointsRow = pointCloud.ptr<cv::Vec3f>(i - 1);
+    // the largest overlaps take their labels first, so that on a split the largest part keeps the
+    // label and on a merge the component keeps the label of its largest part
+    std::sort(allVotes.begin(), allVotes.end());
 
-        for (int j = 1; j < m_tempMask.cols - 1; j++) {
-            uchar maskVal = maskRow[j];
-            float foregroundVal = foregroundRow[j - 1];
-            const cv::Vec3f& pointVal = pointsRow[j - 1];
+    std::vector<unsigned int>& ids = m_table.ids;
+    std::fill(ids.begin(), ids.end(), 0u);
+    std::vector<unsigned int> takenLabels;
 
-            if (maskVal > 0) {
-                labelRow[j - 1] = label;
+    for (const Vote& vote : allVotes) {
+        if (ids[vote.index] != 0 || std::find(takenLabels.begin(), takenLabels.end(), vote.label) != takenLabels.end())
+            continue;
 
-                // update 2d bounding box
-                {
-                    if (foregroundVal < bbMinDepth)
-                        bbMinDepth = foregroundVal;
-                    if (foregroundVal > bbMaxDepth)
-                        bbMaxDepth = foregroundVal;
+        ids[vote.index] = vote.label;
+        takenLabels.push_back(vote.label);
+    }
 
-                    if (j - 1 < bbMinPoint.x)
-                        bbMinPoint.x = j - 1;
-                    if (j - 1 > bbMaxPoint.x)
-                        bbMaxPoint.x = j - 1;
+    // new components, and the smaller parts of splits, get labels that have not been used yet
+    for (unsigned int& id : ids) {
+        if (id == 0)
+            id = m_nextTemporalLabel++;
+    }
 
-                    if (i - 1 < bbMinPoint.y)
-                        bbMinPoint.y = i - 1;
-                    if (i - 1 > bbMaxPoint.y)
-                        bbMaxPoint.y = i - 1;
-                }
+    // write the temporal labels over the ones of this frame
+    ThreadPool::instance().parallelFor(0, numComponents, m_numBands, [&](int, int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            for (int s = m_table.spanOffsets[k]; s < m_table.spanOffsets[k + 1]; s++) {
+                const BitMask::Run& span = m_table.spans[s];
+                int* labelRow = m_labelMap.ptr<int>(span.row);
+                std::fill(labelRow + span.begin, labelRow + span.end, (int)ids[k]);
+            }
+        }
+    });
+}
 
-                // update 3d bounding box
-                {
-                    if (pointVal[0] < bbMinPoint3d.x)
-                        bbMinPoint3d.x = pointVal[0];
-                    if (pointVal[0] > bbMaxPoint3d.x)
-                        bbMaxPoint3d.x = pointVal[0];
-
-                    if (pointVal[1] < bbMinPoint3d.y)
-                        bbMinPoint3d.y = pointVal[1];
-                    if (pointVal[1] > bbMaxPoint3d.y)
-                        bbMaxPoint3d.y = pointVal[1];
-
-                    if (pointVal[2] < bbMinPoint3d.z)
-                        bbMinPoint3d.z = pointVal[2];
-                    if (pointVal[2] > bbMaxPoint3d.z)
-                        bbMaxPoint3d.z = pointVal[2];
-                }
+void ConnectedComponentLabeling::labelBand(const cv::Mat& foreground, const cv::Mat& pointCloud,
+                                           const BitMask* foregroundTiles, int tileSize, Band& band)
+{
+    std::atomic<int>* parents = m_parents.get();
+    band.firstLabel = band.begin * foreground.cols + 1;
+
+    std::vector<uchar> isLeftConnected(foreground.cols, 0);
+    std::vector<uchar> isUpperConnected(foreground.cols, 0);
+
+    // give each foreground pixel the label of its left or upper neighbor if they are close enough,
+    // or a new provisional label otherwise, and merge the labels if it connects both neighbors, the
+    // first row of the band is merged with the band above afterwards
+    for (int i = band.begin; i < band.end; i++) {
+        const float* foregroundRow = foreground.ptr<float>(i);
+        const float* upperForegroundRow = foreground.ptr<float>(std::max(0, i - 1));
+        const cv::Vec3f* pointsRow = pointCloud.ptr<cv::Vec3f>(i);
+        const cv::Vec3f* upperPointsRow = pointCloud.ptr<cv::Vec3f>(std::max(0, i - 1));
+        int* labelRow = m_labelMap.ptr<int>(i);
+        const int* upperLabelRow = m_labelMap.ptr<int>(std::max(0, i - 1));
+
+        // evaluate the predicate for the whole row at once
+        m_connectRow(foregroundRow + 1, foregroundRow, pointsRow + 1, pointsRow, &isLeftConnected[1],
+                     foreground.cols - 1, m_maxDistance);
+        if (i > band.begin) {
+            m_connectRow(foregroundRow, upperForegroundRow, pointsRow, upperPointsRow, &isUpperConnected[0],
+                         foreground.cols, m_maxDistance);
+        }
 
-                m10 += j - 1;
-                m01 += i - 1;
+        for (int j = 0; j < foreground.cols; j++) {
+            // skip the rest of the tile if it does not contain any foreground
+            if (foregroundTiles && !foregroundTiles->get(i / tileSize, j / tileSize)) {
+                const int tileEnd = std::min(foreground.cols, (j / tileSize + 1) * tileSize);
+                std::fill(labelRow + j, labelRow + tileEnd, 0);
+                j = tileEnd - 1;
+                continue;
+            }
+
+            const float depth = foregroundRow[j];
+            if (!(depth > 0)) {
+                labelRow[j] = 0;
+                continue;
+            }
 
-                size++;
+            // connected neighbors are always foreground, so they have a label
+            const int left = isLeftConnected[j] ? labelRow[j - 1] : 0;
+            const int upper = i > band.begin && isUpperConnected[j] ? upperLabelRow[j] : 0;
+
+            int label = left ? left : upper;
+            if (left && upper && left != upper)
+                merge(parents, left, upper);
+
+            const cv::Vec3f& point = pointsRow[j];
+            if (!label) {
+                label = band.firstLabel + band.stats.size();
+                parents[label].store(label, std::memory_order_relaxed);
+
+                ComponentStats stats;
+                stats.area = 0;
+                stats.minPoint = stats.maxPoint = cv::Point(j, i);
+                stats.minDepth = stats.maxDepth = depth;
+                stats.minPoint3d = stats.maxPoint3d = cv::Point3f(point[0], point[1], point[2]);
+                stats.m10 = stats.m01 = 0;
+                stats.squaredDepthSum = 0;
+                band.stats.push_back(stats);
             }
+
+            labelRow[j] = label;
+
+            // neighbors that are foreground but too far away border on another component, or on the
+            // same one if it is connected through other pixels
+            if (j > 0 && !isLeftConnected[j] && labelRow[j - 1] != 0)
+                addEdge(band.edges, labelRow[j - 1], label, std::abs(depth - foregroundRow[j - 1]));
+            if (i > band.begin && !isUpperConnected[j] && upperLabelRow[j] != 0)
+                addEdge(band.edges, upperLabelRow[j], label, std::abs(depth - upperForegroundRow[j]));
+
+            // the statistics are collected per provisional label and combined afterwards
+            ComponentStats& stats = band.stats[label - band.firstLabel];
+            stats.area++;
+            stats.minPoint.x = std::min(stats.minPoint.x, j);
+            stats.maxPoint.x = std::max(stats.maxPoint.x, j);
+            stats.maxPoint.y = i;
+            stats.minDepth = std::min(stats.minDepth, depth);
+            stats.maxDepth = std::max(stats.maxDepth, depth);
+            stats.minPoint3d.x = std::min(stats.minPoint3d.x, point[0]);
+            stats.minPoint3d.y = std::min(stats.minPoint3d.y, point[1]);
+            stats.minPoint3d.z = std::min(stats.minPoint3d.z, point[2]);
+            stats.maxPoint3d.x = std::max(stats.maxPoint3d.x, point[0]);
+            stats.maxPoint3d.y = std::max(stats.maxPoint3d.y, point[1]);
+            stats.maxPoint3d.z = std::max(stats.maxPoint3d.z, point[2]);
+            stats.m10 += j;
+            stats.m01 += i;
+            stats.squaredDepthSum += depth * depth;
         }
     }
+}
 
-    if (size > 1) {
-        // create a new component
-        std::shared_ptr<ConnectedComponent> component(new ConnectedComponent());
-        component->id = label;
-        component->area = size;
-        component->boundingBox2d = BoundingBox2D(bbMinPoint, bbMaxPoint, bbMinDepth, bbMaxDepth);
-        component->boundingBox3d = BoundingBox3D(bbMinPoint3d, bbMaxPoint3d);
+void ConnectedComponentLabeling::mergeBorder(const cv::Mat& foreground, const cv::Mat& pointCloud, Band& band)
+{
+    const int row = band.begin;
+    const int* labelRow = m_labelMap.ptr<int>(row);
+    const int* upperLabelRow = m_labelMap.ptr<int>(row - 1);
+    const float* foregroundRow = foreground.ptr<float>(row);
+    const float* upperForegroundRow = foreground.ptr<float>(row - 1);
+
+    std::vector<uchar> isConnected(foreground.cols);
+    m_connectRow(foregroundRow, upperForegroundRow, pointCloud.ptr<cv::Vec3f>(row),
+                 pointCloud.ptr<cv::Vec3f>(row - 1), &isConnected[0], foreground.cols, m_maxDistance);
+
+    for (int j = 0; j < foreground.cols; j++) {
+        if (isConnected[j])
+            merge(m_parents.get(), labelRow[j], upperLabelRow[j]);
+        else if (labelRow[j] != 0 && upperLabelRow[j] != 0)
+            addEdge(band.edges, upperLabelRow[j], labelRow[j], std::abs(foregroundRow[j] - upperForegroundRow[j]));
+    }
+}
 
-        // compute center of mass
-        component->centerOfMass = cv::Point2f((float)(m10 / size), (float)(m01 / size));
-        component->centerDepth = foreground.at<float>(cv::Point((int)component->centerOfMass.x, (int)component->centerOfMass.y));
+ConnectedComponentLabeling::ComponentStats& ConnectedComponentLabeling::getStats(int label, int band)
+{
+    // the label is either in the given band or in one above
+    while (label < m_bands[band].firstLabel)
+        band--;
+    return m_bands[band].stats[label - m_bands[band].firstLabel];
+}
 
-        m_components.push_back(component);
+void ConnectedComponentLabeling::createComponents(const cv::Mat& foreground)
+{
+    std::atomic<int>* parents = m_parents.get();
+    const int numBands = m_bands.size();
+
+    // combine the statistics of all provisional labels of a component in its root, the root is
+    // always the smallest label, i.e. the first one in raster order
+    for (int band = 0; band < numBands; band++) {
+        const int firstLabel = m_bands[band].firstLabel;
+        const int endLabel = firstLabel + m_bands[band].stats.size();
+
+        for (int label = firstLabel; label < endLabel; label++) {
+            const int root = findRoot(parents, label);
+            if (root == label)
+                continue;
+
+            ComponentStats& stats = getStats(root, band);
+            const ComponentStats& other = m_bands[band].stats[label - firstLabel];
+            stats.area += other.area;
+            stats.minPoint.x = std::min(stats.minPoint.x, other.minPoint.x);
+            stats.minPoint.y = std::min(stats.minPoint.y, other.minPoint.y);
+            stats.maxPoint.x = std::max(stats.maxPoint.x, other.maxPoint.x);
+            stats.maxPoint.y = std::max(stats.maxPoint.y, other.maxPoint.y);
+            stats.minDepth = std::min(stats.minDepth, other.minDepth);
+            stats.maxDepth = std::max(stats.maxDepth, other.maxDepth);
+            stats.minPoint3d.x = std::min(stats.minPoint3d.x, other.minPoint3d.x);
+            stats.minPoint3d.y = std::min(stats.minPoint3d.y, other.minPoint3d.y);
+            stats.minPoint3d.z = std::min(stats.minPoint3d.z, other.minPoint3d.z);
+            stats.maxPoint3d.x = std::max(stats.maxPoint3d.x, other.maxPoint3d.x);
+            stats.maxPoint3d.y = std::max(stats.maxPoint3d.y, other.maxPoint3d.y);
+            stats.maxPoint3d.z = std::max(stats.maxPoint3d.z, other.maxPoint3d.z);
+            stats.m10 += other.m10;
+            stats.m01 += other.m01;
+            stats.squaredDepthSum += other.squaredDepthSum;
+        }
+    }
+
+    // a pixel at the depth d covers d^2 / (fx * fy) square meters
+    const bool hasMetricArea = m_minMetricArea > 0 && m_fx > 0 && m_fy > 0;
+    const double minSquaredDepthSum = m_minMetricArea * (double)m_fx * m_fy;
+
+    // collect the roots of the components that are large enough, the pixels of all other
+    // components are cleared by the relabelling
+    std::vector<int> roots;
+    std::vector<const ComponentStats*> rootStats;
+    int numComponents = 0;
+
+    for (int band = 0; band < numBands; band++) {
+        const int firstLabel = m_bands[band].firstLabel;
+        const int endLabel = firstLabel + m_bands[band].stats.size();
+
+        for (int label = firstLabel; label < endLabel; label++) {
+            if (findRoot(parents, label) != label)
+                continue;
+
+            numComponents++;
+            const ComponentStats& stats = m_bands[band].stats[label - firstLabel];
+            if (stats.area < m_minArea || (hasMetricArea && stats.squaredDepthSum < minSquaredDepthSum)) {
+                m_finalLabels[label] = 0;
+                continue;
+            }
+
+            roots.push_back(label);
+            rootStats.push_back(&stats);
+        }
+    }
+
+    // only keep the largest components, the ones with the same area as the smallest one that is
+    // kept are taken in raster order
+    std::vector<bool> isKept(roots.size(), true);
+    if (m_maxComponents > 0 && (int)roots.size() > m_maxComponents) {
+        std::vector<int> areas(roots.size());
+        for (size_t k = 0; k < roots.size(); k++)
+            areas[k] = rootStats[k]->area;
+
+        std::nth_element(areas.begin(), areas.begin() + m_maxComponents - 1, areas.end(), std::greater<int>());
+        const int minKeptArea = areas[m_maxComponents - 1];
+
+        int numLarger = 0;
+        for (int area : areas)
+            numLarger += area > minKeptArea;
+
+        int numEqual = m_maxComponents - numLarger;
+        for (size_t k = 0; k < roots.size(); k++) {
+            const int area = rootStats[k]->area;
+            isKept[k] = area > minKeptArea || (area == minKeptArea && numEqual-- > 0);
+        }
+    }
+
+    // number the components in the order of their roots, which is the same for any number of bands
+    m_finalLabels[0] = 0;
+    unsigned int nextLabel = 1;
+
+    for (size_t k = 0; k < roots.size(); k++) {
+        if (!isKept[k]) {
+            m_finalLabels[roots[k]] = 0;
+            continue;
+        }
+
+        // add a new component
+        const ComponentStats& stats = *rootStats[k];
+        const cv::Point2f centerOfMass((float)(stats.m10 / stats.area), (float)(stats.m01 / stats.area));
+        const float centerDepth = foreground.at<float>(cv::Point((int)centerOfMass.x, (int)centerOfMass.y));
+
+        m_table.add(nextLabel, stats.area,
+                    BoundingBox2D(stats.minPoint, stats.maxPoint, stats.minDepth, stats.maxDepth),
+                    BoundingBox3D(stats.minPoint3d, stats.maxPoint3d), centerOfMass, centerDepth);
+        m_finalLabels[roots[k]] = nextLabel++;
+    }
+
+    m_numRejectedComponents = numComponents - m_table.size();
+
+    // the other labels of a component take the final label of its root
+    for (int band = 0; band < numBands; band++) {
+        const int firstLabel = m_bands[band].firstLabel;
+        const int endLabel = firstLabel + m_bands[band].stats.size();
+
+        for (int label = firstLabel; label < endLabel; label++) {
+            const int root = findRoot(parents, label);
+            if (root != label)
+                m_finalLabels[label] = m_finalLabels[root];
+        }
     }
 }
 }
@@ -3,9 +3,12 @@
 
 #include <opencv2/opencv.hpp>
 #include <memory>
+#include <atomic>
 #include <utils/boundingbox2d.h>
 #include <utils/boundingbox3d.h>
 #include <utils/module.h>
+#include <utils/bitmask.h>
+#include "componenttable.h"
 
 namespace pose
 {
@@ -17,36 +20,185 @@ struct ConnectedComponent
     BoundingBox2D   boundingBox2d;
     BoundingBox3D   boundingBox3d;
     int             area;
+    std::vector<BitMask::Run> spans;    // pixels of the component in raster order
+    std::vector<unsigned int> nearbyIds;    // components that touch this one, see ComponentTable
 };
 
 class ConnectedComponentLabeling
         : public Module
 {
 public:
+    enum DistanceMode {
+        DM_DEPTH,       // difference of the depth values
+        DM_EUCLIDEAN    // 3D distance of the points of the point cloud
+    };
+
     ConnectedComponentLabeling();
     ~ConnectedComponentLabeling();
 
+    /**
+     * @brief Sets the maximum distance (in meters) of two neighboring pixels (4-connectivity) to be
+     * part of the same component, see setDistanceMode.
+     */
     void setMaxDistance(float maxDistance);
 
+    /**
+     * @brief Selects how the distance of two neighboring pixels is measured. The depth difference
+     * grows with the distance to the camera on slanted surfaces, the 3D distance does not.
+     */
+    void setDistanceMode(DistanceMode mode);
+    DistanceMode getDistanceMode() const;
+
+    /**
+     * @brief Sets the minimum number of pixels of a component, smaller components are rejected and
+     * their pixels are 0 in the label map. Defaults to 2, i.e. single pixels are rejected.
+     */
+    void setMinArea(int minArea);
+
+    /**
+     * @brief Sets the minimum area (in square meters) of a component, i.e. the sum of the areas the
+     * pixels cover at their depth, which requires the focal length. 0 disables the check (default).
+     */
+    void setMinMetricArea(float minMetricArea);
+
+    /**
+     * @brief Sets the focal length (in pixels) of the camera that is used for the metric area.
+     */
+    void setFocalLength(float fx, float fy);
+
+    /**
+     * @brief Sets the maximum number of components, only the largest ones are kept if there are
+     * more. 0 means no limit (default).
+     */
+    void setMaxComponents(int maxComponents);
+
+    /**
+     * @brief The number of components of the last frame that have been rejected by the minimum
+     * area or the maximum number of components.
+     */
+    int getNumRejectedComponents() const;
+
+    /**
+     * @brief Keeps the labels stable across frames. Each component takes the label of the
+     * component of the last frame it overlaps most, if it is not taken by a component with a larger
+     * overlap. When a component splits, the smaller parts get new labels, when components merge,
+     * the result keeps the label of the largest overlap. Labels are not reused. Disabled by
+     * default, i.e. the labels are numbered in raster order in each frame.
+     */
+    void setTemporalLabels(bool enabled);
+    bool hasTemporalLabels() const;
+
+    /**
+     * @brief Sets the number of horizontal bands the image is split into to be labelled in
+     * parallel on the shared thread pool. Defaults to the number of threads of the pool. The
+     * result does not depend on the number of bands.
+     */
+    void setNumBands(int numBands);
+
+    /**
+     * @brief The components as objects, they are created from the component table on the first
+     * call after each frame.
+     */
     const std::vector<std::shared_ptr<ConnectedComponent>>& getComponents() const;
+
+    /**
+     * @brief The statistics of all components of the last frame in contiguous columns.
+     */
+    const ComponentTable& getComponentTable() const;
     const cv::Mat& getLabelMap() const;
     cv::Mat getColoredLabelMap();
 
+    /**
+     * @brief Label the connected components of the foreground. The labels are numbered in the
+     * order the components first appear in raster order (see setTemporalLabels), rejected
+     * components (see setMinArea, setMinMetricArea and setMaxComponents) are not kept and their
+     * pixels are 0 in the label map. If a map of the tiles that contain foreground (one bit per
+     * tile of tileSize x tileSize pixels) is given, all other tiles are skipped. The pixels of
+     * each component are also given as horizontal spans, so that the following steps do not have
+     * to search the label map, and the components that touch each other as adjacency lists.
+     */
     void process(const cv::Mat& foreground,
-                 const cv::Mat& pointCloud);
+                 const cv::Mat& pointCloud,
+                 const BitMask* foregroundTiles = 0,
+                 int tileSize = 0);
 
 private:
-    void findConnectedComponents(const cv::Mat& foreground,
-                                 const cv::Mat& pointcloud,
-                                 const cv::Point& seed,
-                                 unsigned int label);
+    struct ComponentStats
+    {
+        int         area;
+        cv::Point   minPoint;
+        cv::Point   maxPoint;
+        float       minDepth;
+        float       maxDepth;
+        cv::Point3f minPoint3d;
+        cv::Point3f maxPoint3d;
+        double      m10;
+        double      m01;
+        double      squaredDepthSum;
+    };
+
+    // neighboring pixels of two labels that are not connected
+    struct Edge
+    {
+        int     label;
+        int     otherLabel;
+        int     length;
+        float   depthGap;
+    };
+
+    struct Band
+    {
+        int begin;
+        int end;
+        int firstLabel;
+        std::vector<ComponentStats> stats;  // of the labels [firstLabel, firstLabel + stats.size())
+        std::vector<BitMask::Run> spans;    // spans of the final labels
+        std::vector<int> spanLabels;
+        std::vector<Edge> edges;            // of the provisional labels, including the upper border
+    };
+
+    /**
+     * @brief Sets connected[j] to 255 if the pixel j of both rows is foreground and their distance
+     * is within the maximum distance, to 0 otherwise.
+     */
+    typedef void (*ConnectRowFunc)(const float* depth, const float* otherDepth, const cv::Vec3f* points,
+                                   const cv::Vec3f* otherPoints, uchar* connected, int cols, float maxDistance);
+
+    void labelBand(const cv::Mat& foreground, const cv::Mat& pointCloud, const BitMask* foregroundTiles,
+                   int tileSize, Band& band);
+    void mergeBorder(const cv::Mat& foreground, const cv::Mat& pointCloud, Band& band);
+    static void addEdge(std::vector<Edge>& edges, int label, int otherLabel, float depthGap);
+    ComponentStats& getStats(int label, int band);
+    void createComponents(const cv::Mat& foreground);
+    void createAdjacency();
+    void assignTemporalLabels();
 
     cv::Mat m_labelMap;
+    cv::Mat m_previousLabelMap;
     cv::Mat m_coloredLabelMap;
-    cv::Mat m_tempMask;
-    std::vector<std::shared_ptr<ConnectedComponent> > m_components;
+    bool m_isColoredLabelMapValid;     // the colored label map is only updated once per label map
+    ComponentTable m_table;
+    mutable std::vector<std::shared_ptr<ConnectedComponent> > m_components;
+    mutable bool m_hasComponents;
+
+    // union-find of the provisional labels, each band starts its labels at the index of its first
+    // pixel + 1, so the labels of all bands fit into one entry per pixel, label 0 is the background
+    std::unique_ptr<std::atomic<int>[]> m_parents;
+    std::vector<int> m_finalLabels;
+    std::vector<Band> m_bands;
 
     float m_maxDistance;
+    int m_minArea;
+    float m_minMetricArea;
+    float m_fx;
+    float m_fy;
+    int m_maxComponents;
+    int m_numRejectedComponents;
+    bool m_temporalLabels;
+    unsigned int m_nextTemporalLabel;
+    DistanceMode m_distanceMode;
+    ConnectRowFunc m_connectRow;
+    int m_numBands;
 };
 }
 
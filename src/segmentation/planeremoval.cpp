@@ -0,0 +1,556 @@
+#include "planeremoval.h"
+#include <utils/cpufeatures.h>
+#include <utils/threadpool.h>
+#include <Eigen/Eigenvalues>
+#include <cassert>
+#include <limits>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+// distance in pixels between the sampled points of the plane detection
+static const int sampleStep = 8;
+// number of RANSAC hypotheses for each plane
+static const int ransacIterations = 200;
+// number of RANSAC hypotheses of a periodic detection in each frame
+static const int ransacIterationsPerFrame = 50;
+// number of inlier pixels of each plane that are checked to validate it in the next frames
+static const int maxSupport = 256;
+// minimum ratio of these pixels that have to fit the plane for it to be valid
+static const float minSupportRatio = 0.5f;
+
+// ---------------------------------------------------------------------------------------------
+// integral image rows, the 4 sums of each entry (x, y, z, count) are one AVX vector
+// ---------------------------------------------------------------------------------------------
+
+static void integralRowScalar(const cv::Vec3f* points, const double* above, double* row, int cols)
+{
+    double sum[4] = { 0, 0, 0, 0 };
+    std::fill(row, row + 4, 0.0);
+
+    for (int j = 0; j < cols; j++) {
+        const cv::Vec3f& point = points[j];
+        if (point[2] > 0) {
+            sum[0] += point[0];
+            sum[1] += point[1];
+            sum[2] += point[2];
+            sum[3] += 1;
+        }
+
+        for (int k = 0; k < 4; k++)
+            row[4 * (j + 1) + k] = above[4 * (j + 1) + k] + sum[k];
+    }
+}
+
+#ifdef POSE_SIMD_X86
+POSE_TARGET("avx")
+static inline __m256d integralValueAVX(__m128 point)
+{
+    // x, y, z and 1 of a valid point, widening the floats is exact like in the scalar version
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 value = _mm_blend_ps(point, _mm_set1_ps(1.0f), 0x8);
+    const __m128 valid = _mm_cmpgt_ps(_mm_shuffle_ps(point, point, _MM_SHUFFLE(2, 2, 2, 2)), zero);
+    return _mm256_cvtps_pd(_mm_and_ps(value, valid));
+}
+
+POSE_TARGET("avx")
+static void integralRowAVX(const cv::Vec3f* points, const double* above, double* row, int cols)
+{
+    __m256d sum = _mm256_setzero_pd();
+    _mm256_storeu_pd(row, sum);
+
+    // the 4 floats loaded for a point end with the x of the next point, which is replaced by 1
+    int j = 0;
+    for (; j + 1 < cols; j++) {
+        sum = _mm256_add_pd(sum, integralValueAVX(_mm_loadu_ps(&points[j][0])));
+        _mm256_storeu_pd(row + 4 * (j + 1), _mm256_add_pd(_mm256_loadu_pd(above + 4 * (j + 1)), sum));
+    }
+
+    for (; j < cols; j++) {
+        sum = _mm256_add_pd(sum, integralValueAVX(_mm_set_ps(0, points[j][2], points[j][1], points[j][0])));
+        _mm256_storeu_pd(row + 4 * (j + 1), _mm256_add_pd(_mm256_loadu_pd(above + 4 * (j + 1)), sum));
+    }
+}
+#endif
+
+// the rows [begin, end) of the tiles that contain foreground, empty if there are none
+static void getForegroundRows(const BitMask& foregroundTiles, int tileSize, int rows, int& begin, int& end)
+{
+    begin = rows;
+    end = 0;
+
+    for (int i = 0; i < foregroundTiles.rows(); i++) {
+        const uint64_t* tileRow = foregroundTiles.row(i);
+        if (std::find_if(tileRow, tileRow + foregroundTiles.wordsPerRow(), [](uint64_t word) { return word != 0; }) ==
+                tileRow + foregroundTiles.wordsPerRow())
+            continue;
+
+        begin = std::min(begin, i * tileSize);
+        end = std::min(rows, (i + 1) * tileSize);
+    }
+}
+
+PlaneRemoval::PlaneRemoval()
+    : Module("PlaneRemoval"),
+      m_integralStride(0),
+      m_integralBegin(0),
+      m_integralEnd(0),
+      m_hasDetected(false),
+      m_framesSinceDetection(0),
+      m_removedPixels(0)
+{
+    setEnabled(true);
+    setDistanceThreshold(0.03f);
+    setAngleThreshold(20.0f);
+    setNormalRadius(4);
+    setMaxPlanes(3);
+    setMinPlaneRatio(0.1f);
+    setDetectionInterval(30);
+    setNumBands(ThreadPool::instance().getNumThreads());
+
+    m_detection.isRunning = false;
+}
+
+PlaneRemoval::~PlaneRemoval()
+{
+}
+
+void PlaneRemoval::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void PlaneRemoval::setDistanceThreshold(float distance)
+{
+    m_distanceThreshold = distance;
+}
+
+void PlaneRemoval::setAngleThreshold(float angle)
+{
+    m_minCosAngle = std::cos(angle * (float)CV_PI / 180.0f);
+}
+
+void PlaneRemoval::setNormalRadius(int radius)
+{
+    m_normalRadius = std::max(1, radius);
+}
+
+void PlaneRemoval::setMaxPlanes(int maxPlanes)
+{
+    m_maxPlanes = maxPlanes;
+}
+
+void PlaneRemoval::setMinPlaneRatio(float ratio)
+{
+    m_minPlaneRatio = ratio;
+}
+
+void PlaneRemoval::setDetectionInterval(int frames)
+{
+    m_detectionInterval = std::max(1, frames);
+}
+
+void PlaneRemoval::setNumBands(int numBands)
+{
+    m_numBands = std::max(1, numBands);
+}
+
+const std::vector<PlaneRemoval::Plane>& PlaneRemoval::getPlanes() const
+{
+    return m_planes;
+}
+
+const cv::Mat& PlaneRemoval::getForeground() const
+{
+    return m_foreground;
+}
+
+int PlaneRemoval::getRemovedPixels() const
+{
+    return m_removedPixels;
+}
+
+void PlaneRemoval::process(const cv::Mat& foreground,
+                           const cv::Mat& pointCloud,
+                           const BitMask* foregroundTiles,
+                           int tileSize)
+{
+    begin();
+
+    m_removedPixels = 0;
+    if (!m_enabled) {
+        m_foreground = foreground;
+        end();
+        return;
+    }
+
+    // the planes are detected again at once if they do not fit the scene anymore, e.g. because the
+    // camera has been moved; the periodic detection finds planes that have not been visible
+    // before, it is spread over several frames to avoid a latency spike
+    m_framesSinceDetection++;
+    const bool detectNow = !m_hasDetected || (!m_planes.empty() && !validatePlanes(pointCloud));
+    const bool detectPeriodically = !detectNow && !m_detection.isRunning &&
+            m_framesSinceDetection >= m_detectionInterval;
+
+    // the samples of a detection need the normals of the whole point cloud
+    m_integralBegin = m_integralEnd = 0;
+    if (detectNow || detectPeriodically) {
+        computeIntegralImage(pointCloud, 0, pointCloud.rows);
+        startDetection(pointCloud);
+    }
+
+    if (m_detection.isRunning) {
+        const int maxIterations = detectNow ? std::numeric_limits<int>::max() : ransacIterationsPerFrame;
+        if (continueDetection(maxIterations)) {
+            m_planes.swap(m_detection.planes);
+            m_planeSupport.swap(m_detection.planeSupport);
+            m_hasDetected = true;
+            m_framesSinceDetection = 0;
+        }
+    }
+
+    // only the rows of the foreground tiles (and the windows of their normals) are needed
+    int foregroundBegin = 0;
+    int foregroundEnd = foreground.rows;
+    if (foregroundTiles)
+        getForegroundRows(*foregroundTiles, tileSize, foreground.rows, foregroundBegin, foregroundEnd);
+
+    if (m_planes.empty() || foregroundBegin >= foregroundEnd) {
+        m_foreground = foreground;
+        end();
+        return;
+    }
+
+    if (m_integralEnd == 0) {
+        computeIntegralImage(pointCloud, std::max(0, foregroundBegin - m_normalRadius),
+                             std::min(pointCloud.rows, foregroundEnd + m_normalRadius));
+    }
+
+    if (m_foreground.data == foreground.data || m_foreground.size() != foreground.size())
+        m_foreground = cv::Mat(foreground.rows, foreground.cols, CV_32F);
+
+    // remove all foreground pixels that are on one of the planes, the normal is only estimated
+    // for pixels that are close to a plane
+    std::vector<int> removedPixels(m_numBands, 0);
+    ThreadPool::instance().parallelFor(0, foreground.rows, m_numBands, [&](int band, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const float* foregroundRow = foreground.ptr<float>(i);
+            const cv::Vec3f* pointsRow = pointCloud.ptr<cv::Vec3f>(i);
+            float* outputRow = m_foreground.ptr<float>(i);
+
+            for (int j = 0; j < foreground.cols; j++) {
+                outputRow[j] = foregroundRow[j];
+                if (foregroundRow[j] <= 0)
+                    continue;
+
+                const cv::Point3f point(pointsRow[j][0], pointsRow[j][1], pointsRow[j][2]);
+                bool hasNormal = false;
+                cv::Point3f normal;
+
+                for (const Plane& plane : m_planes) {
+                    if (std::abs(plane.normal.dot(point) + plane.distance) >= m_distanceThreshold)
+                        continue;
+
+                    if (!hasNormal && !computeNormal(pointCloud, j, i, normal))
+                        break;
+                    hasNormal = true;
+
+                    if (plane.normal.dot(normal) >= m_minCosAngle) {
+                        outputRow[j] = 0;
+                        removedPixels[band]++;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    for (int removed : removedPixels)
+        m_removedPixels += removed;
+
+    end();
+}
+
+void PlaneRemoval::computeIntegralImage(const cv::Mat& pointCloud, int begin, int end)
+{
+    // the sums start at the first row, the box sums only need the rows of the windows
+    m_integralBegin = begin;
+    m_integralEnd = end;
+    m_integralStride = 4 * (pointCloud.cols + 1);
+    m_integral.resize(m_integralStride * (end - begin + 1));
+    std::fill(m_integral.begin(), m_integral.begin() + m_integralStride, 0.0);
+
+    void (*integralRow)(const cv::Vec3f*, const double*, double*, int) = integralRowScalar;
+#ifdef POSE_SIMD_X86
+    if (CpuFeatures::getInstructionSet() >= CpuFeatures::IS_AVX)
+        integralRow = integralRowAVX;
+#endif
+
+    // each band sums its rows starting from zero (the first row of the integral image), then the
+    // sums of all bands above are added to the rows of each band
+    const int numBands = std::max(1, std::min(m_numBands, end - begin));
+    std::vector<int> bandEnds(numBands, begin);
+    ThreadPool::instance().parallelFor(begin, end, numBands, [&](int band, int bandBegin, int bandEnd) {
+        for (int i = bandBegin; i < bandEnd; i++) {
+            const double* above = i == bandBegin ? &m_integral[0] : &m_integral[(i - begin) * m_integralStride];
+            integralRow(pointCloud.ptr<cv::Vec3f>(i), above, &m_integral[(i - begin + 1) * m_integralStride],
+                        pointCloud.cols);
+        }
+        bandEnds[band] = bandEnd;
+    });
+
+    if (numBands == 1)
+        return;
+
+    m_bandSums.assign(numBands * m_integralStride, 0.0);
+    for (int band = 1; band < numBands; band++) {
+        const double* above = &m_bandSums[(band - 1) * m_integralStride];
+        const double* last = &m_integral[(bandEnds[band - 1] - begin) * m_integralStride];
+        double* sums = &m_bandSums[band * m_integralStride];
+        for (int k = 0; k < m_integralStride; k++)
+            sums[k] = above[k] + last[k];
+    }
+
+    ThreadPool::instance().parallelFor(begin, end, numBands, [&](int band, int bandBegin, int bandEnd) {
+        if (band == 0)
+            return;
+
+        const double* sums = &m_bandSums[band * m_integralStride];
+        for (int i = bandBegin; i < bandEnd; i++) {
+            double* row = &m_integral[(i - begin + 1) * m_integralStride];
+            for (int k = 0; k < m_integralStride; k++)
+                row[k] += sums[k];
+        }
+    });
+}
+
+static inline void boxMean(const double* integral, int stride, int x0, int y0, int x1, int y1,
+                           cv::Point3f& mean, double& count)
+{
+    const double* topLeft = integral + y0 * stride + 4 * x0;
+    const double* topRight = integral + y0 * stride + 4 * x1;
+    const double* bottomLeft = integral + y1 * stride + 4 * x0;
+    const double* bottomRight = integral + y1 * stride + 4 * x1;
+
+    double sum[4];
+    for (int k = 0; k < 4; k++)
+        sum[k] = bottomRight[k] - bottomLeft[k] - topRight[k] + topLeft[k];
+
+    count = sum[3];
+    if (count > 0.5)
+        mean = cv::Point3f((float)(sum[0] / count), (float)(sum[1] / count), (float)(sum[2] / count));
+}
+
+bool PlaneRemoval::computeNormal(const cv::Mat& pointCloud, int x, int y, cv::Point3f& normal) const
+{
+    const int r = m_normalRadius;
+    const int x0 = std::max(0, x - r);
+    const int x1 = std::min(pointCloud.cols, x + r + 1);
+    const int y0 = std::max(0, y - r);
+    const int y1 = std::min(pointCloud.rows, y + r + 1);
+
+    // the integral image only covers the rows that have been needed in this frame
+    if (y0 < m_integralBegin || y1 > m_integralEnd)
+        return false;
+
+    // the gradients are the differences between the mean points of the windows on both sides
+    cv::Point3f left, right, top, bottom;
+    double leftCount = 0, rightCount = 0, topCount = 0, bottomCount = 0;
+    const double* integral = &m_integral[0];
+    const int b = m_integralBegin;
+
+    boxMean(integral, m_integralStride, x0, y0 - b, x, y1 - b, left, leftCount);
+    boxMean(integral, m_integralStride, x + 1, y0 - b, x1, y1 - b, right, rightCount);
+    boxMean(integral, m_integralStride, x0, y0 - b, x1, y - b, top, topCount);
+    boxMean(integral, m_integralStride, x0, y + 1 - b, x1, y1 - b, bottom, bottomCount);
+
+    if (leftCount < 0.5 || rightCount < 0.5 || topCount < 0.5 || bottomCount < 0.5)
+        return false;
+
+    normal = (right - left).cross(bottom - top);
+    const float length = std::sqrt(normal.dot(normal));
+    if (length < 1e-9f)
+        return false;
+
+    // point the normal towards the camera
+    const cv::Vec3f& point = pointCloud.at<cv::Vec3f>(y, x);
+    normal *= (normal.x * point[0] + normal.y * point[1] + normal.z * point[2] > 0 ? -1.0f : 1.0f) / length;
+
+    return true;
+}
+
+bool PlaneRemoval::isOnPlane(const Plane& plane, const cv::Point3f& point, const cv::Point3f& normal) const
+{
+    return std::abs(plane.normal.dot(point) + plane.distance) < m_distanceThreshold &&
+            plane.normal.dot(normal) >= m_minCosAngle;
+}
+
+bool PlaneRemoval::validatePlanes(const cv::Mat& pointCloud) const
+{
+    // check whether the pixels that were on the plane when it was detected still are, pixels that
+    // are hidden behind a user do not fit anymore, so only a part of them has to fit
+    for (size_t k = 0; k < m_planes.size(); k++) {
+        const Plane& plane = m_planes[k];
+        const std::vector<cv::Point>& support = m_planeSupport[k];
+
+        int numFitting = 0;
+        for (const cv::Point& pixel : support) {
+            const cv::Vec3f& point = pointCloud.at<cv::Vec3f>(pixel.y, pixel.x);
+            const float distance = plane.normal.x * point[0] + plane.normal.y * point[1] +
+                    plane.normal.z * point[2] + plane.distance;
+            if (point[2] > 0 && std::abs(distance) < m_distanceThreshold)
+                numFitting++;
+        }
+
+        if (numFitting < minSupportRatio * support.size())
+            return false;
+    }
+
+    return true;
+}
+
+bool PlaneRemoval::fitPlane(const std::vector<Sample>& samples, const std::vector<int>& inliers, Plane& plane) const
+{
+    if (inliers.size() < 3)
+        return false;
+
+    // least squares plane through the centroid, the normal is the direction of the least variance
+    Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+    for (int index : inliers) {
+        const cv::Point3f& point = samples[index].point;
+        centroid += Eigen::Vector3d(point.x, point.y, point.z);
+    }
+    centroid /= (double)inliers.size();
+
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for (int index : inliers) {
+        const cv::Point3f& point = samples[index].point;
+        const Eigen::Vector3d diff = Eigen::Vector3d(point.x, point.y, point.z) - centroid;
+        covariance += diff * diff.transpose();
+    }
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    if (solver.info() != Eigen::Success)
+        return false;
+
+    Eigen::Vector3d normal = solver.eigenvectors().col(0);
+    if (normal.dot(centroid) > 0)
+        normal = -normal;
+
+    plane.normal = cv::Point3f((float)normal.x(), (float)normal.y(), (float)normal.z());
+    plane.distance = (float)-normal.dot(centroid);
+    return true;
+}
+
+void PlaneRemoval::startDetection(const cv::Mat& pointCloud)
+{
+    Detection& detection = m_detection;
+    detection.samples.clear();
+    detection.planes.clear();
+    detection.planeSupport.clear();
+    detection.bestInliers = 0;
+    detection.iterations = 0;
+    detection.isRunning = true;
+
+    // oriented points on a sparse grid
+    for (int y = sampleStep / 2; y < pointCloud.rows; y += sampleStep) {
+        for (int x = sampleStep / 2; x < pointCloud.cols; x += sampleStep) {
+            Sample sample;
+            const cv::Vec3f& point = pointCloud.at<cv::Vec3f>(y, x);
+            if (point[2] <= 0 || !computeNormal(pointCloud, x, y, sample.normal))
+                continue;
+
+            sample.pixel = cv::Point(x, y);
+            sample.point = cv::Point3f(point[0], point[1], point[2]);
+            detection.samples.push_back(sample);
+        }
+    }
+
+    detection.isUsed.assign(detection.samples.size(), false);
+    detection.minInliers = std::max(3, (int)(m_minPlaneRatio * detection.samples.size()));
+}
+
+bool PlaneRemoval::continueDetection(int maxIterations)
+{
+    // the samples are kept from the frame the detection has been started in, so the planes are
+    // the same as if they had been detected at once
+    Detection& detection = m_detection;
+    const std::vector<Sample>& samples = detection.samples;
+    std::vector<bool>& isUsed = detection.isUsed;
+    std::vector<int> inliers;
+
+    while (!samples.empty() && (int)detection.planes.size() < m_maxPlanes) {
+        // every oriented point defines a plane, so a single sample is enough for a hypothesis
+        std::uniform_int_distribution<int> distribution(0, samples.size() - 1);
+        for (; detection.iterations < ransacIterations && maxIterations > 0; detection.iterations++, maxIterations--) {
+            const int index = distribution(m_random);
+            if (isUsed[index])
+                continue;
+
+            Plane plane;
+            plane.normal = samples[index].normal;
+            plane.distance = -plane.normal.dot(samples[index].point);
+
+            int numInliers = 0;
+            for (size_t k = 0; k < samples.size(); k++)
+                numInliers += !isUsed[k] && isOnPlane(plane, samples[k].point, samples[k].normal);
+
+            if (numInliers > detection.bestInliers) {
+                detection.bestPlane = plane;
+                detection.bestInliers = numInliers;
+            }
+        }
+
+        // continue with the hypotheses in the next frame
+        if (detection.iterations < ransacIterations)
+            return false;
+
+        const Plane bestPlane = detection.bestPlane;
+        const int bestInliers = detection.bestInliers;
+        detection.bestInliers = 0;
+        detection.iterations = 0;
+
+        if (bestInliers < detection.minInliers)
+            break;
+
+        // refine the plane with all inliers and collect the inliers of the refined plane
+        inliers.clear();
+        for (size_t k = 0; k < samples.size(); k++) {
+            if (!isUsed[k] && isOnPlane(bestPlane, samples[k].point, samples[k].normal))
+                inliers.push_back(k);
+        }
+
+        Plane plane;
+        if (!fitPlane(samples, inliers, plane))
+            break;
+
+        inliers.clear();
+        for (size_t k = 0; k < samples.size(); k++) {
+            if (!isUsed[k] && isOnPlane(plane, samples[k].point, samples[k].normal))
+                inliers.push_back(k);
+        }
+
+        if ((int)inliers.size() < detection.minInliers)
+            break;
+
+        // keep an evenly distributed subset of the inliers to validate the plane later on
+        std::vector<cv::Point> support;
+        const int step = std::max(1, (int)inliers.size() / maxSupport);
+        for (size_t k = 0; k < inliers.size(); k++) {
+            isUsed[inliers[k]] = true;
+            if (k % step == 0)
+                support.push_back(samples[inliers[k]].pixel);
+        }
+
+        plane.numInliers = inliers.size();
+        detection.planes.push_back(plane);
+        detection.planeSupport.push_back(support);
+    }
+
+    detection.isRunning = false;
+    return true;
+}
+}
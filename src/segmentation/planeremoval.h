@@ -0,0 +1,159 @@
+#ifndef PLANEREMOVAL_H
+#define PLANEREMOVAL_H
+
+#include <opencv2/opencv.hpp>
+#include <utils/module.h>
+#include <utils/bitmask.h>
+#include <random>
+
+namespace pose
+{
+/**
+ * @brief Removes foreground pixels that lie on the dominant planes of the scene, i.e. the floor
+ * and the walls. Otherwise feet merge with the floor and users touching a wall merge with it.
+ *
+ * The normals are estimated from the organized point cloud with the average 3d gradient of an
+ * integral image. The planes are detected by RANSAC on a sparse grid of oriented points, kept
+ * across frames and only detected again if they do not fit the point cloud anymore or after a
+ * certain number of frames. The periodic detection is spread over several frames, the current
+ * planes are used until it is complete.
+ */
+class PlaneRemoval
+        : public Module
+{
+public:
+    /**
+     * @brief A plane with normal * p + distance = 0, the normal points towards the camera.
+     */
+    struct Plane
+    {
+        cv::Point3f normal;
+        float distance;
+        int numInliers;
+    };
+
+    PlaneRemoval();
+    ~PlaneRemoval();
+
+    /**
+     * @brief If disabled, the foreground is passed through unchanged.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Sets the maximum distance of a point from a plane (in meters) to be part of it.
+     */
+    void setDistanceThreshold(float distance);
+
+    /**
+     * @brief Sets the maximum angle between the normal of a point and a plane (in degrees) for
+     * the point to be part of the plane.
+     */
+    void setAngleThreshold(float angle);
+
+    /**
+     * @brief Sets the size of the windows that are used to estimate the normals, i.e. the
+     * gradient is taken between two windows of radius x (2 * radius + 1) pixels.
+     */
+    void setNormalRadius(int radius);
+
+    void setMaxPlanes(int maxPlanes);
+
+    /**
+     * @brief Sets the minimum ratio of the sampled points that a plane has to contain.
+     */
+    void setMinPlaneRatio(float ratio);
+
+    /**
+     * @brief Sets the number of frames after which the planes are detected again, even if the
+     * current planes still fit.
+     */
+    void setDetectionInterval(int frames);
+
+    /**
+     * @brief Sets the number of horizontal bands the integral image and the foreground are split
+     * into to be processed in parallel on the shared thread pool. Defaults to the number of
+     * threads of the pool.
+     */
+    void setNumBands(int numBands);
+
+    const std::vector<Plane>& getPlanes() const;
+    const cv::Mat& getForeground() const;
+
+    /**
+     * @brief Get the number of foreground pixels that have been removed in the last frame.
+     */
+    int getRemovedPixels() const;
+
+    /**
+     * @brief Removes the foreground pixels on the planes. If a map of the tiles that contain
+     * foreground (one bit per tile of tileSize x tileSize pixels) is given, the normals are only
+     * prepared for the rows of these tiles.
+     */
+    void process(const cv::Mat& foreground,
+                 const cv::Mat& pointCloud,
+                 const BitMask* foregroundTiles = 0,
+                 int tileSize = 0);
+
+private:
+    struct Sample
+    {
+        cv::Point pixel;
+        cv::Point3f point;
+        cv::Point3f normal;
+    };
+
+    // state of a plane detection that can be spread over several frames
+    struct Detection
+    {
+        std::vector<Sample> samples;
+        std::vector<bool> isUsed;
+        int minInliers;
+        std::vector<Plane> planes;
+        std::vector<std::vector<cv::Point>> planeSupport;
+
+        // best hypothesis of the plane that is searched currently
+        Plane bestPlane;
+        int bestInliers;
+        int iterations;
+        bool isRunning;
+    };
+
+    void computeIntegralImage(const cv::Mat& pointCloud, int begin, int end);
+    bool computeNormal(const cv::Mat& pointCloud, int x, int y, cv::Point3f& normal) const;
+    bool validatePlanes(const cv::Mat& pointCloud) const;
+    void startDetection(const cv::Mat& pointCloud);
+    bool continueDetection(int maxIterations);
+    bool fitPlane(const std::vector<Sample>& samples, const std::vector<int>& inliers, Plane& plane) const;
+    bool isOnPlane(const Plane& plane, const cv::Point3f& point, const cv::Point3f& normal) const;
+
+    cv::Mat m_foreground;
+
+    // sums of x, y, z and the number of valid points from the first row of the integral image on,
+    // (rows + 1) x (cols + 1) entries
+    std::vector<double> m_integral;
+    std::vector<double> m_bandSums;
+    int m_integralStride;
+    int m_integralBegin;
+    int m_integralEnd;
+
+    std::vector<Plane> m_planes;
+    std::vector<std::vector<cv::Point>> m_planeSupport;
+    Detection m_detection;
+    bool m_hasDetected;
+    int m_framesSinceDetection;
+    std::minstd_rand m_random;
+
+    bool    m_enabled;
+    float   m_distanceThreshold;
+    float   m_minCosAngle;
+    int     m_normalRadius;
+    int     m_maxPlanes;
+    float   m_minPlaneRatio;
+    int     m_detectionInterval;
+    int     m_numBands;
+    int     m_removedPixels;
+};
+}
+
+#endif // PLANEREMOVAL_H
@@ -1,16 +1,109 @@
 #include "staticmap.h"
+#include "staticmapkernels.h"
+#include "backgroundmixture.h"
+#include "backgroundsnapshot.h"
+#include <utils/exception.h>
+#include <utils/threadpool.h>
+#include <cassert>
+#include <cstring>
+#include <limits>
 
 namespace pose
 {
+static_assert(64 % StaticMap::TILE_SIZE == 0, "tiles must not cross the words of a bit mask");
+
+// bits of one tile in a word of a bit mask
+static const uint64_t tileMask = (uint64_t(1) << StaticMap::TILE_SIZE) - 1;
+
+// Marks the runs of invalid pixels that are adjacent to a foreground pixel and the margin pixels on
+// both sides of them. The projector and the camera are displaced horizontally, so the shadow of an
+// object is always a horizontal run next to it.
+static void computeShadowRow(const float* depth, const uchar* mask, uchar* shadow, int cols, int margin)
+{
+    memset(shadow, 0, cols);
+
+    int j = 0;
+    while (j < cols) {
+        if (depth[j] > 0) {
+            j++;
+            continue;
+        }
+
+        const int runBegin = j;
+        while (j < cols && !(depth[j] > 0))
+            j++;
+        const int runEnd = j;
+
+        // look for foreground next to the run, allowing for some mixed pixels in between
+        bool isAdjacent = false;
+        for (int k = std::max(0, runBegin - margin - 1); k < runBegin && !isAdjacent; k++)
+            isAdjacent = mask[k] != 0;
+        for (int k = runEnd; k < std::min(cols, runEnd + margin + 1) && !isAdjacent; k++)
+            isAdjacent = mask[k] != 0;
+
+        if (isAdjacent) {
+            const int shadowBegin = std::max(0, runBegin - margin);
+            const int shadowEnd = std::min(cols, runEnd + margin);
+            memset(shadow + shadowBegin, 255, shadowEnd - shadowBegin);
+        }
+    }
+}
+
+// The foreground mask of the unchanged tiles is kept from the frame they were classified in, but
+// the tiles tolerate a few pixels that become valid or invalid. The foreground depth follows the
+// current frame, so a pixel that has become invalid (its point is at the origin now) is not part
+// of the foreground until it is valid again.
+static void refreshRetainedRow(const float* depth, float* foreground, const uchar* mask, int begin, int end)
+{
+    for (int j = begin; j < end; j++)
+        foreground[j] = mask[j] && depth[j] > 0 ? depth[j] : 0;
+}
+
+// refreshes the retained foreground of all columns outside of the changed spans
+static void refreshRetainedSpans(const float* depth, float* foreground, const uchar* mask, int cols,
+                                 const std::vector<cv::Vec2i>& spans)
+{
+    int begin = 0;
+    for (const cv::Vec2i& span : spans) {
+        refreshRetainedRow(depth, foreground, mask, begin, span[0]);
+        begin = span[1];
+    }
+
+    refreshRetainedRow(depth, foreground, mask, begin, cols);
+}
+
+#ifndef NDEBUG
+// the foreground only consists of valid pixels of the mask at their current depth
+static bool isForegroundValid(const float* depth, const float* foreground, const uchar* mask, int cols)
+{
+    for (int j = 0; j < cols; j++) {
+        if (foreground[j] != (mask[j] && depth[j] > 0 ? depth[j] : 0))
+            return false;
+    }
+
+    return true;
+}
+#endif
+
 StaticMap::StaticMap()
-    : Module("StaticMap")
+    : Module("StaticMap"),
+      m_backgroundModel(BM_RUNNING_AVERAGE),
+      m_backgroundStorage(BS_FLOAT),
+      m_mixture(new BackgroundMixture())
 {
     m_updateFrames = 0;
+    m_suppressedPixels = 0;
+    m_totalSuppressedPixels = 0;
+    setShadowEnabled(true);
+    setShadowMargin(3);
+    setTileSkipEnabled(true);
+    setTileTolerance(0.05f);
     setBackgroundResetRatio(0.2f);
     setBackgroundLockedRatio(0.05f);
     setUpdateDelayFrames(10);
     setForegroundDistance(0.1f);
     setMinRatio(320);
+    setNumBands(ThreadPool::instance().getNumThreads());
 }
 
 StaticMap::~StaticMap()
@@ -42,13 +135,226 @@ void StaticMap::setMinRatio(int minRatio)
     m_minRatio = minRatio;
 }
 
+void StaticMap::setNumBands(int numBands)
+{
+    m_numBands = std::max(1, numBands);
+}
+
+void StaticMap::setShadowEnabled(bool enabled)
+{
+    m_shadowEnabled = enabled;
+}
+
+void StaticMap::setShadowMargin(int margin)
+{
+    m_shadowMargin = std::max(0, margin);
+}
+
+void StaticMap::setTileSkipEnabled(bool enabled)
+{
+    m_tileSkipEnabled = enabled;
+}
+
+void StaticMap::setTileTolerance(float tolerance)
+{
+    m_tileTolerance = tolerance;
+}
+
+void StaticMap::setBackgroundModel(BackgroundModel model)
+{
+    if (model == m_backgroundModel)
+        return;
+
+    // force the creation of a new initial background with the next frame
+    m_backgroundModel = model;
+    m_background = cv::Mat();
+    m_fixedBackground = cv::Mat();
+}
+
+StaticMap::BackgroundModel StaticMap::getBackgroundModel() const
+{
+    return m_backgroundModel;
+}
+
+void StaticMap::setBackgroundStorage(BackgroundStorage storage)
+{
+    if (storage == m_backgroundStorage)
+        return;
+
+    m_backgroundStorage = storage;
+    if (m_backgroundModel != BM_RUNNING_AVERAGE)
+        return;
+
+    // continue with the converted running average, the count saturates in 16 bits
+    if (storage == BS_FIXED16 && !m_background.empty()) {
+        m_background.convertTo(m_fixedBackground, CV_16U, StaticMapKernels::FIXED_POINT_SCALE);
+        m_count.convertTo(m_fixedCount, CV_16U);
+        m_background = cv::Mat();
+        m_count = cv::Mat();
+    }
+    else if (storage == BS_FLOAT && !m_fixedBackground.empty()) {
+        m_fixedBackground.convertTo(m_background, CV_32F, 1.0 / StaticMapKernels::FIXED_POINT_SCALE);
+        m_fixedCount.convertTo(m_count, CV_32F);
+        m_fixedBackground = cv::Mat();
+        m_fixedCount = cv::Mat();
+    }
+}
+
+StaticMap::BackgroundStorage StaticMap::getBackgroundStorage() const
+{
+    return m_backgroundStorage;
+}
+
+BackgroundMixture& StaticMap::getBackgroundMixture()
+{
+    return *m_mixture;
+}
+
+bool StaticMap::isFixedPoint() const
+{
+    return m_backgroundModel == BM_RUNNING_AVERAGE && m_backgroundStorage == BS_FIXED16;
+}
+
 void StaticMap::reset()
 {
     m_background.setTo(0);
+    m_fixedBackground.setTo(0);
+}
+
+void StaticMap::allocate(int rows, int cols)
+{
+    m_foreground = cv::Mat(rows, cols, CV_32F);
+    m_rawForeground = cv::Mat(rows, cols, CV_32F);
+    m_foregroundMask = cv::Mat(rows, cols, CV_8U);
+    m_shadow = cv::Mat(rows, cols, CV_8U);
+
+    // only the planes of the selected storage are kept
+    if (isFixedPoint()) {
+        m_fixedBackground = cv::Mat(rows, cols, CV_16U);
+        m_fixedCount = cv::Mat(rows, cols, CV_16U);
+        m_background = cv::Mat();
+        m_count = cv::Mat();
+    }
+    else {
+        m_count = cv::Mat(rows, cols, CV_32F);
+        m_fixedBackground = cv::Mat();
+        m_fixedCount = cv::Mat();
+    }
+
+    m_maskBits.create(rows, cols);
+    m_tempBits.create(rows, cols);
+
+    // all tiles have to be processed in the first frame
+    const int tilesX = (cols + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (rows + TILE_SIZE - 1) / TILE_SIZE;
+    m_tileSignatures.assign(tilesX * tilesY, TileSignature());
+    m_dirtyTiles.create(tilesY, tilesX);
+    m_foregroundTiles.create(tilesY, tilesX);
+    m_allTilesDirty = true;
+    m_minSize = cols * rows / m_minRatio;
+}
+
+void StaticMap::getState(BackgroundState& state) const
+{
+    state.model = m_backgroundModel;
+    state.planes.clear();
+
+    if (isFixedPoint()) {
+        state.planes.push_back(m_fixedBackground.clone());
+        state.planes.push_back(m_fixedCount.clone());
+    }
+    else if (m_backgroundModel == BM_MIXTURE) {
+        state.planes.push_back(m_background.clone());
+        for (const cv::Mat& mean : m_mixture->getMeans())
+            state.planes.push_back(mean.clone());
+        for (const cv::Mat& variance : m_mixture->getVariances())
+            state.planes.push_back(variance.clone());
+        for (const cv::Mat& weight : m_mixture->getWeights())
+            state.planes.push_back(weight.clone());
+    }
+    else {
+        state.planes.push_back(m_background.clone());
+        state.planes.push_back(m_count.clone());
+    }
+}
+
+void StaticMap::setState(const BackgroundState& state)
+{
+    if (state.planes.empty())
+        throw Exception("invalid background state");
+
+    // the planes are floats, only the running average might be stored in 16 bits
+    const int rows = state.planes[0].rows;
+    const int cols = state.planes[0].cols;
+    const int type = state.planes[0].type();
+    for (const cv::Mat& plane : state.planes) {
+        if (plane.rows != rows || plane.cols != cols || plane.type() != type)
+            throw Exception("invalid background state");
+    }
+
+    if (type != CV_32F && !(type == CV_16U && state.model == BM_RUNNING_AVERAGE))
+        throw Exception("invalid background state");
+
+    if (state.model == BM_MIXTURE) {
+        // the background is followed by the same number of means, variances and weights
+        const int numModes = (state.planes.size() - 1) / 3;
+        if (numModes < 1 || numModes > BackgroundMixture::MAX_MODES || (int)state.planes.size() != 1 + 3 * numModes)
+            throw Exception("invalid background state");
+
+        m_mixture->setNumModes(numModes);
+        std::vector<cv::Mat>& means = m_mixture->getMeans();
+        std::vector<cv::Mat>& variances = m_mixture->getVariances();
+        std::vector<cv::Mat>& weights = m_mixture->getWeights();
+        for (int k = 0; k < numModes; k++) {
+            means.push_back(state.planes[1 + k].clone());
+            variances.push_back(state.planes[1 + numModes + k].clone());
+            weights.push_back(state.planes[1 + 2 * numModes + k].clone());
+        }
+
+        m_backgroundModel = BM_MIXTURE;
+        allocate(rows, cols);
+        m_count.setTo(0);
+        state.planes[0].copyTo(m_background);
+    }
+    else if (state.model == BM_RUNNING_AVERAGE) {
+        if (state.planes.size() != 2)
+            throw Exception("invalid background state");
+
+        // restore the state in its own storage and convert it to the configured one
+        const BackgroundStorage storage = m_backgroundStorage;
+        m_backgroundModel = BM_RUNNING_AVERAGE;
+        m_backgroundStorage = type == CV_16U ? BS_FIXED16 : BS_FLOAT;
+        allocate(rows, cols);
+
+        if (isFixedPoint()) {
+            state.planes[0].copyTo(m_fixedBackground);
+            state.planes[1].copyTo(m_fixedCount);
+        }
+        else {
+            state.planes[0].copyTo(m_background);
+            state.planes[1].copyTo(m_count);
+        }
+
+        setBackgroundStorage(storage);
+    }
+    else {
+        throw Exception("invalid background model");
+    }
+}
+
+bool StaticMap::hasBackground() const
+{
+    return isFixedPoint() ? !m_fixedBackground.empty() : !m_background.empty();
 }
 
 const cv::Mat& StaticMap::getBackground() const
 {
+    // the 16 bit background is only converted when it is requested
+    if (isFixedPoint()) {
+        m_fixedBackground.convertTo(m_convertedBackground, CV_32F, 1.0 / StaticMapKernels::FIXED_POINT_SCALE);
+        return m_convertedBackground;
+    }
+
     return m_background;
 }
 
@@ -57,68 +363,58 @@ const cv::Mat& StaticMap::getForeground() const
     return m_foreground;
 }
 
-void StaticMap::process(const cv::Mat& depthMap)
+const cv::Mat& StaticMap::getShadow() const
 {
-    begin();
+    return m_shadow;
+}
 
-    if (depthMap.cols != m_background.cols || depthMap.rows != m_background.rows) {
-        m_foreground = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
-        m_foregroundMask = cv::Mat(depthMap.rows, depthMap.cols, CV_8U);
-        m_count = cv::Mat(depthMap.rows, depthMap.cols, CV_32F);
-        m_tempContour = cv::Mat(depthMap.rows, depthMap.cols, CV_8U);
-        m_minSize = depthMap.cols * depthMap.rows / m_minRatio;
-        m_count.setTo(0);
+const BitMask& StaticMap::getDirtyTiles() const
+{
+    return m_dirtyTiles;
+}
 
-        // create an initial background
-        depthMap.copyTo(m_background);
-    }
-    m_foreground.setTo(0);
-    m_foregroundMask.setTo(0);
+const BitMask& StaticMap::getForegroundTiles() const
+{
+    return m_foregroundTiles;
+}
 
-    // update the background model
-    for (int i = 0; i < depthMap.cols; i++) {
-        for (int j = 0; j < depthMap.rows; j++) {
-            const cv::Point point(i, j);
-            const float& dist = depthMap.at<float>(point);
-            float& background = m_background.at<float>(point);
-            unsigned int& count = m_count.at<unsigned int>(point);
+int StaticMap::getSuppressedPixels() const
+{
+    return m_suppressedPixels;
+}
 
-            // update background model with running average
-            if (dist > 0 && dist > background - m_foregroundDistance) {
-                // cumulative moving average
-                background = background + ((dist - background) / (count + 1));
+long long StaticMap::getTotalSuppressedPixels() const
+{
+    return m_totalSuppressedPixels;
+}
 
-                count++;
-            }
+void StaticMap::process(const cv::Mat& depthMap)
+{
+    begin();
 
-            // create foreground mask
-            if (dist > 0 && dist < background - m_foregroundDistance) {
-                float& foreground = m_foreground.at<float>(point);
-                uchar& foregroundMask = m_foregroundMask.at<uchar>(point);
-                foreground = dist;
-                foregroundMask = 255;
-            }
+    const cv::Mat& background = isFixedPoint() ? m_fixedBackground : m_background;
+    if (depthMap.cols != background.cols || depthMap.rows != background.rows) {
+        allocate(depthMap.rows, depthMap.cols);
+
+        // create an initial background
+        if (isFixedPoint()) {
+            m_fixedCount.setTo(0);
+            depthMap.convertTo(m_fixedBackground, CV_16U, StaticMapKernels::FIXED_POINT_SCALE);
+        }
+        else {
+            m_count.setTo(0);
+            depthMap.copyTo(m_background);
+            if (m_backgroundModel == BM_MIXTURE)
+                m_mixture->reset(depthMap);
         }
     }
 
-    // filter contours, i.e. filter noise and only take the strongest contours
-    filterContours();
+    if (m_backgroundModel == BM_MIXTURE)
+        updateMixture(depthMap);
+    else
+        updateRunningAverage(depthMap);
 
-    // everything that is not taken as foreground object is added back to the background
-    // NOTE: this step balances the noise and stabilizes the background model
-    for (int i = 0; i < m_foreground.cols; i++) {
-        for (int j = 0; j < m_foreground.rows; j++) {
-            cv::Point point(i, j);
-            const float& dist = depthMap.at<float>(point);
-            const float& foreground = m_foreground.at<float>(point);
-            float& background = m_background.at<float>(point);
-            unsigned int& count = m_count.at<unsigned int>(point);
-
-            // add value to the background
-            if (foreground == 0 && dist != 0)
-                background = background + ((dist - background) / (count));
-        }
-    }
+    m_allTilesDirty = false;
 
     // percentage of points that have been updated in the background model
     /*float pointsChangedRatio = pointsChanged / (float)totalNumPoints;
@@ -140,30 +436,331 @@ void StaticMap::process(const cv::Mat& depthMap)
     end();
 }
 
-void StaticMap::filterContours()
+void StaticMap::updateRunningAverage(const cv::Mat& depthMap)
 {
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
+    // select the best row kernels for this CPU
+    const StaticMapKernels kernels = StaticMapKernels::get(CpuFeatures::getInstructionSet());
+    ThreadPool& threadPool = ThreadPool::instance();
+    const bool isFixed = isFixedPoint();
+
+    // create the foreground and foreground mask, the shadow and update the background model with
+    // a cumulative moving average outside of the shadow for all tiles that have changed, the mask
+    // of the other tiles is kept and their foreground only follows the current depth
+    // NOTE: each row is classified first, since its shadow depends on the foreground, but all three
+    // steps are done per row while it is still in the cache
+    // NOTE: the background model is independent for each pixel, so the rows of tiles are processed
+    // in bands
+    std::vector<int> suppressedPixels(m_numBands, 0);
+    threadPool.parallelFor(0, m_dirtyTiles.rows(), m_numBands, [&](int band, int tileBegin, int tileEnd) {
+        std::vector<TileSignature> signatures;
+        std::vector<cv::Vec2i> spans;
+
+        for (int tileRow = tileBegin; tileRow < tileEnd; tileRow++) {
+            detectChanges(depthMap, tileRow, signatures, spans);
+            const bool isRowDirty = spans.size() == 1 && spans[0][0] == 0 && spans[0][1] == depthMap.cols;
+
+            const int rowEnd = std::min(depthMap.rows, (tileRow + 1) * TILE_SIZE);
+            for (int i = tileRow * TILE_SIZE; i < rowEnd; i++) {
+                const float* depthRow = depthMap.ptr<float>(i);
+                float* foregroundRow = m_rawForeground.ptr<float>(i);
+                uchar* maskRow = m_foregroundMask.ptr<uchar>(i);
+                uchar* shadowRow = m_shadow.ptr<uchar>(i);
+
+                refreshRetainedSpans(depthRow, foregroundRow, maskRow, depthMap.cols, spans);
+                if (spans.empty())
+                    continue;
+
+                int numForeground = 0;
+                for (const cv::Vec2i& span : spans) {
+                    const int o = span[0];
+                    if (isFixed) {
+                        numForeground += kernels.classifyRowFixed16(depthRow + o, m_fixedBackground.ptr<ushort>(i) + o,
+                                                                    foregroundRow + o, maskRow + o,
+                                                                    span[1] - o, m_foregroundDistance);
+                    }
+                    else {
+                        numForeground += kernels.classifyRow(depthRow + o, m_background.ptr<float>(i) + o,
+                                                             foregroundRow + o, maskRow + o,
+                                                             span[1] - o, m_foregroundDistance);
+                    }
+                }
+                assert(isForegroundValid(depthRow, foregroundRow, maskRow, depthMap.cols));
+
+                // the shadow depends on the foreground of the unchanged tiles as well, so it always
+                // covers the whole row
+                if (m_shadowEnabled && (numForeground > 0 || !isRowDirty))
+                    computeShadowRow(depthRow, maskRow, shadowRow, depthMap.cols, m_shadowMargin);
+                else
+                    memset(shadowRow, 0, depthMap.cols);
+
+                for (const cv::Vec2i& span : spans) {
+                    const int o = span[0];
+                    if (isFixed) {
+                        suppressedPixels[band] += kernels.updateRowFixed16(depthRow + o, m_fixedBackground.ptr<ushort>(i) + o,
+                                                                           m_fixedCount.ptr<ushort>(i) + o, shadowRow + o,
+                                                                           span[1] - o, m_foregroundDistance);
+                    }
+                    else {
+                        suppressedPixels[band] += kernels.updateRow(depthRow + o, m_background.ptr<float>(i) + o,
+                                                                    m_count.ptr<float>(i) + o, shadowRow + o,
+                                                                    span[1] - o, m_foregroundDistance);
+                    }
+                }
+            }
+        }
+    });
+    updateSuppressedPixels(suppressedPixels);
+
+    // filter noise and only take the components that are big enough
+    filterComponents();
+
+    // everything of the changed tiles that is not taken as foreground object is added back to the
+    // background
+    // NOTE: this step balances the noise and stabilizes the background model
+    threadPool.parallelFor(0, m_dirtyTiles.rows(), m_numBands, [&](int, int tileBegin, int tileEnd) {
+        std::vector<cv::Vec2i> spans;
+
+        for (int tileRow = tileBegin; tileRow < tileEnd; tileRow++) {
+            getDirtySpans(tileRow, depthMap.cols, spans);
+
+            const int rowEnd = std::min(depthMap.rows, (tileRow + 1) * TILE_SIZE);
+            for (int i = tileRow * TILE_SIZE; i < rowEnd && !spans.empty(); i++) {
+                for (const cv::Vec2i& span : spans) {
+                    const int o = span[0];
+                    if (isFixed) {
+                        kernels.addBackRowFixed16(depthMap.ptr<float>(i) + o, m_foreground.ptr<float>(i) + o,
+                                                  m_shadow.ptr<uchar>(i) + o, m_fixedBackground.ptr<ushort>(i) + o,
+                                                  m_fixedCount.ptr<ushort>(i) + o, span[1] - o);
+                    }
+                    else {
+                        kernels.addBackRow(depthMap.ptr<float>(i) + o, m_foreground.ptr<float>(i) + o,
+                                           m_shadow.ptr<uchar>(i) + o, m_background.ptr<float>(i) + o,
+                                           m_count.ptr<float>(i) + o, span[1] - o);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void StaticMap::updateMixture(const cv::Mat& depthMap)
+{
+    // the number of modes might have been changed
+    if (!m_mixture->isInitialized()) {
+        m_mixture->reset(depthMap);
+        m_allTilesDirty = true;
+    }
+
+    // select the best row kernels for this CPU
+    m_mixture->setInstructionSet(CpuFeatures::getInstructionSet());
+    m_mixture->setForegroundDistance(m_foregroundDistance);
+
+    // create the foreground and foreground mask, the shadow and update the mixture model outside
+    // of the shadow for all tiles that have changed, the modes of each pixel are independent of
+    // the other pixels, so the rows of tiles are processed in bands
+    std::vector<int> suppressedPixels(m_numBands, 0);
+    ThreadPool::instance().parallelFor(0, m_dirtyTiles.rows(), m_numBands, [&](int band, int tileBegin, int tileEnd) {
+        std::vector<TileSignature> signatures;
+        std::vector<cv::Vec2i> spans;
+        std::vector<signed char> matches(depthMap.cols);
 
-    // perform an opening to supress noise
-    cv::erode(m_foregroundMask, m_foregroundMask, element);
-    cv::dilate(m_foregroundMask, m_foregroundMask, element);
+        for (int tileRow = tileBegin; tileRow < tileEnd; tileRow++) {
+            detectChanges(depthMap, tileRow, signatures, spans);
+            const bool isRowDirty = spans.size() == 1 && spans[0][0] == 0 && spans[0][1] == depthMap.cols;
 
-    // find contours in the noise-reduced mask
-    m_contours.clear();
-    cv::findContours(m_foregroundMask, m_contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE);
+            const int rowEnd = std::min(depthMap.rows, (tileRow + 1) * TILE_SIZE);
+            for (int i = tileRow * TILE_SIZE; i < rowEnd; i++) {
+                const float* depthRow = depthMap.ptr<float>(i);
+                float* foregroundRow = m_rawForeground.ptr<float>(i);
+                uchar* maskRow = m_foregroundMask.ptr<uchar>(i);
+                uchar* shadowRow = m_shadow.ptr<uchar>(i);
 
-    // create a binary mask that contains only contours that are big enough
-    m_tempContour.setTo(1);
-    #pragma omp parallel for
-    for (int i = 0; i < (int)m_contours.size(); i++) {
-        // compute the number of contour pixels
-        double area = cv::contourArea(m_contours[i]);
+                refreshRetainedSpans(depthRow, foregroundRow, maskRow, depthMap.cols, spans);
+                if (spans.empty())
+                    continue;
 
-        // only draw contours that are big enough
-        if (area > m_minSize)
-            cv::drawContours(m_tempContour, m_contours, i, cv::Scalar::all(0), CV_FILLED);
+                int numForeground = 0;
+                for (const cv::Vec2i& span : spans)
+                    numForeground += m_mixture->classifyRow(depthMap, m_rawForeground, m_foregroundMask, i, span[0], span[1], &matches[0]);
+                assert(isForegroundValid(depthRow, foregroundRow, maskRow, depthMap.cols));
+
+                // the shadow depends on the foreground of the unchanged tiles as well, so it always
+                // covers the whole row
+                if (m_shadowEnabled && (numForeground > 0 || !isRowDirty))
+                    computeShadowRow(depthRow, maskRow, shadowRow, depthMap.cols, m_shadowMargin);
+                else
+                    memset(shadowRow, 0, depthMap.cols);
+
+                for (const cv::Vec2i& span : spans)
+                    suppressedPixels[band] += m_mixture->updateRow(depthMap, m_background, i, span[0], span[1], &matches[0], shadowRow);
+            }
+        }
+    });
+    updateSuppressedPixels(suppressedPixels);
+
+    // filter noise and only take the components that are big enough
+    // NOTE: the mixture learns every observation itself, so nothing is added back afterwards
+    filterComponents();
+}
+
+void StaticMap::detectChanges(const cv::Mat& depthMap, int tileRow, std::vector<TileSignature>& signatures,
+                              std::vector<cv::Vec2i>& spans)
+{
+    const int tilesX = m_dirtyTiles.cols();
+    const int rowEnd = std::min(depthMap.rows, (tileRow + 1) * TILE_SIZE);
+
+    // compute the signature of each tile of the row, the minimum and maximum only take valid
+    // pixels into account
+    signatures.assign(tilesX, TileSignature());
+    for (TileSignature& signature : signatures) {
+        signature.minDepth = std::numeric_limits<float>::max();
+        signature.maxDepth = 0;
+        signature.sum = 0;
+        signature.numValid = 0;
+    }
+
+    for (int i = tileRow * TILE_SIZE; i < rowEnd; i++) {
+        const float* depthRow = depthMap.ptr<float>(i);
+
+        for (int tile = 0; tile < tilesX; tile++) {
+            TileSignature& signature = signatures[tile];
+            const int colEnd = std::min(depthMap.cols, (tile + 1) * TILE_SIZE);
+
+            for (int j = tile * TILE_SIZE; j < colEnd; j++) {
+                const float dist = depthRow[j];
+                const bool valid = dist > 0;
+                signature.minDepth = std::min(signature.minDepth, valid ? dist : std::numeric_limits<float>::max());
+                signature.maxDepth = std::max(signature.maxDepth, valid ? dist : 0.0f);
+                signature.sum += valid ? dist : 0.0f;
+                signature.numValid += valid;
+            }
+        }
     }
 
-    m_foreground.setTo(0, m_tempContour);
+    // a tile has changed if its signature differs from the one it had when it was processed the
+    // last time by more than the noise, comparing against that frame avoids missing slow changes
+    const int maxValidChange = TILE_SIZE * TILE_SIZE / 16;
+    TileSignature* references = &m_tileSignatures[tileRow * tilesX];
+
+    for (int tile = 0; tile < tilesX; tile++) {
+        const TileSignature& signature = signatures[tile];
+        TileSignature& reference = references[tile];
+
+        const float mean = signature.numValid > 0 ? signature.sum / signature.numValid : 0;
+        const float referenceMean = reference.numValid > 0 ? reference.sum / reference.numValid : 0;
+
+        const bool isDirty = m_allTilesDirty || !m_tileSkipEnabled ||
+                std::abs(signature.numValid - reference.numValid) > maxValidChange ||
+                std::abs(signature.minDepth - reference.minDepth) > m_tileTolerance ||
+                std::abs(signature.maxDepth - reference.maxDepth) > m_tileTolerance ||
+                std::abs(mean - referenceMean) > m_tileTolerance;
+
+        m_dirtyTiles.set(tileRow, tile, isDirty);
+        if (isDirty)
+            reference = signature;
+    }
+
+    getDirtySpans(tileRow, depthMap.cols, spans);
+}
+
+void StaticMap::getDirtySpans(int tileRow, int cols, std::vector<cv::Vec2i>& spans) const
+{
+    // merge adjacent dirty tiles into column ranges, so that the row kernels work on long spans
+    spans.clear();
+
+    const int tilesX = m_dirtyTiles.cols();
+    for (int tile = 0; tile < tilesX; tile++) {
+        if (!m_dirtyTiles.get(tileRow, tile))
+            continue;
+
+        const int colBegin = tile * TILE_SIZE;
+        const int colEnd = std::min(cols, colBegin + TILE_SIZE);
+        if (!spans.empty() && spans.back()[1] == colBegin)
+            spans.back()[1] = colEnd;
+        else
+            spans.push_back(cv::Vec2i(colBegin, colEnd));
+    }
+}
+
+void StaticMap::updateSuppressedPixels(const std::vector<int>& bandSuppressedPixels)
+{
+    m_suppressedPixels = 0;
+    for (int suppressedPixels : bandSuppressedPixels)
+        m_suppressedPixels += suppressedPixels;
+    m_totalSuppressedPixels += m_suppressedPixels;
+}
+
+void StaticMap::filterComponents()
+{
+    cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(5, 5));
+
+    ThreadPool& threadPool = ThreadPool::instance();
+
+    // pack the mask and find the tiles that contain foreground, the filtered foreground is always a
+    // subset of the mask
+    threadPool.parallelFor(0, m_foregroundTiles.rows(), m_numBands, [&](int, int tileBegin, int tileEnd) {
+        std::vector<uint64_t> tileBits(m_maskBits.wordsPerRow());
+
+        for (int tileRow = tileBegin; tileRow < tileEnd; tileRow++) {
+            const int rowBegin = tileRow * TILE_SIZE;
+            const int rowEnd = std::min(m_foregroundMask.rows, rowBegin + TILE_SIZE);
+            m_maskBits.fromMat(m_foregroundMask, rowBegin, rowEnd);
+
+            std::fill(tileBits.begin(), tileBits.end(), 0);
+            for (int i = rowBegin; i < rowEnd; i++) {
+                const uint64_t* bits = m_maskBits.row(i);
+                for (int w = 0; w < m_maskBits.wordsPerRow(); w++)
+                    tileBits[w] |= bits[w];
+            }
+
+            for (int tile = 0; tile < m_foregroundTiles.cols(); tile++) {
+                const int bit = tile * TILE_SIZE;
+                m_foregroundTiles.set(tileRow, tile, ((tileBits[bit / 64] >> (bit % 64)) & tileMask) != 0);
+            }
+        }
+    });
+
+    // perform an opening to supress noise on the bit mask, each band reads the rows around it, so
+    // every step has to be finished for all bands before the next one starts
+    threadPool.parallelFor(0, m_foregroundMask.rows, m_numBands, [&](int, int begin, int end) {
+        BitMask::erode(m_maskBits, m_tempBits, element, begin, end);
+    });
+
+    // the runs of the noise-reduced mask are extracted right after the rows of a band are done
+    std::vector<std::vector<BitMask::Run>> bandRuns(m_numBands);
+    threadPool.parallelFor(0, m_foregroundMask.rows, m_numBands, [&](int band, int begin, int end) {
+        BitMask::dilate(m_tempBits, m_maskBits, element, begin, end);
+        m_maskBits.getRuns(begin, end, bandRuns[band]);
+    });
+
+    m_runs.clear();
+    for (const std::vector<BitMask::Run>& runs : bandRuns)
+        m_runs.insert(m_runs.end(), runs.begin(), runs.end());
+
+    // label the runs with a union-find, this is a single pass over the runs in raster order that
+    // also counts the pixels of each component
+    BitMask::labelRuns(m_runs, m_runLabels, m_componentAreas);
+
+    // index of the first run of each row
+    m_rowRuns.assign(m_foregroundMask.rows + 1, 0);
+    for (const BitMask::Run& run : m_runs)
+        m_rowRuns[run.row + 1]++;
+    for (int i = 0; i < m_foregroundMask.rows; i++)
+        m_rowRuns[i + 1] += m_rowRuns[i];
+
+    // only keep the foreground of the components that are big enough
+    threadPool.parallelFor(0, m_foregroundMask.rows, m_numBands, [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const float* rawForegroundRow = m_rawForeground.ptr<float>(i);
+            float* foregroundRow = m_foreground.ptr<float>(i);
+
+            std::fill(foregroundRow, foregroundRow + m_foreground.cols, 0.0f);
+            for (int k = m_rowRuns[i]; k < m_rowRuns[i + 1]; k++) {
+                const BitMask::Run& run = m_runs[k];
+                if (m_componentAreas[m_runLabels[k]] > m_minSize)
+                    std::copy(rawForegroundRow + run.begin, rawForegroundRow + run.end, foregroundRow + run.begin);
+            }
+        }
+    });
 }
 }
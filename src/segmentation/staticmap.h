@@ -3,11 +3,8 @@
 
 #include <opencv2/opencv.hpp>
 #include <utils/module.h>
-
-// TODO: compute normals and cluster normals by their direction to filter out walls and the floor
-
-// TODO: create a "shadow" map, i.e. a map indicating which black areas are adjacent to a foreground
-// object and don't update the background model at areas that are inside the shadow map
+#include <utils/bitmask.h>
+#include <memory>
 
 // TODO: when tracking connected components, add back components to the background model that have not
 // been identified as a human body.
@@ -17,10 +14,28 @@
 
 namespace pose
 {
+class BackgroundMixture;
+struct BackgroundState;
+
 class StaticMap
         : public Module
 {
 public:
+    enum BackgroundModel {
+        BM_RUNNING_AVERAGE, // cumulative moving average with a single depth per pixel
+        BM_MIXTURE          // mixture of gaussians with multiple depth modes per pixel
+    };
+
+    enum BackgroundStorage {
+        BS_FLOAT,           // 32 bit float background and count
+        BS_FIXED16          // 16 bit fixed-point background and 16 bit saturating count
+    };
+
+    /**
+     * @brief Size of the square tiles that are used to detect the changed regions of a frame.
+     */
+    static const int TILE_SIZE = 16;
+
     StaticMap();
     ~StaticMap();
 
@@ -52,21 +67,144 @@ public:
 
     void setMinRatio(int minRatio);
 
+    /**
+     * @brief Sets the number of horizontal bands the image is split into to be processed in
+     * parallel on the shared thread pool. Defaults to the number of threads of the pool.
+     */
+    void setNumBands(int numBands);
+
+    /**
+     * @brief Enables the shadow map. The shadow contains the runs of invalid pixels in each row
+     * that are adjacent to the foreground, i.e. the area the projector can not see because of a
+     * foreground object, plus a margin of the valid pixels at their borders. The depth at the
+     * borders of the shadow is unreliable, so the background is not updated inside the shadow.
+     */
+    void setShadowEnabled(bool enabled);
+
+    /**
+     * @brief Sets the number of pixels the shadow is extended on both sides of an invalid run.
+     * A run is also adjacent to the foreground if there are at most this many pixels in between.
+     */
+    void setShadowMargin(int margin);
+
+    /**
+     * @brief Enables the change detection. Each tile keeps the minimum, maximum and mean of its
+     * valid depth values and the number of valid pixels of the frame it was processed the last
+     * time. Tiles whose signature is still within the tolerance are neither classified nor
+     * learned by the background model, they keep their foreground of that frame.
+     */
+    void setTileSkipEnabled(bool enabled);
+
+    /**
+     * @brief Sets the maximum difference of the depth values of a tile signature (in meters) that
+     * is considered as noise.
+     */
+    void setTileTolerance(float tolerance);
+
+    /**
+     * @brief Selects the background model. Switching the model discards the current background.
+     */
+    void setBackgroundModel(BackgroundModel model);
+    BackgroundModel getBackgroundModel() const;
+
+    /**
+     * @brief Selects how the running average is stored. The 16 bit storage halves the memory that
+     * is read and written for each pixel, the current background is converted. The mixture model
+     * is always stored as floats.
+     */
+    void setBackgroundStorage(BackgroundStorage storage);
+    BackgroundStorage getBackgroundStorage() const;
+
+    /**
+     * @brief Gives access to the mixture model to configure it, e.g. the number of modes.
+     */
+    BackgroundMixture& getBackgroundMixture();
+
+    /**
+     * @brief Copy the state of the background model, e.g. to write a snapshot. For the running
+     * average these are the background and the count (CV_16U for the 16 bit storage), for the
+     * mixture the background followed by the means, variances and weights of all modes.
+     */
+    void getState(BackgroundState& state) const;
+
+    /**
+     * @brief Continue with the given state of a background model instead of creating an initial
+     * background from the next frame. This also selects the model of the state, a running
+     * average is converted to the configured storage (see setBackgroundStorage).
+     */
+    void setState(const BackgroundState& state);
+
+    /**
+     * @brief Check whether a background has been created or restored, without converting it.
+     */
+    bool hasBackground() const;
+
+    /**
+     * @brief Get the background depth. The 16 bit background is converted to floats on each call.
+     */
     const cv::Mat& getBackground() const;
     const cv::Mat& getForeground() const;
+    const cv::Mat& getShadow() const;
+
+    /**
+     * @brief Get the tiles that have been processed in the last frame, one bit per tile.
+     */
+    const BitMask& getDirtyTiles() const;
+
+    /**
+     * @brief Get the tiles that contain foreground pixels in the last frame, one bit per tile.
+     * All other tiles can be skipped when looking for foreground.
+     */
+    const BitMask& getForegroundTiles() const;
+
+    /**
+     * @brief Get the number of valid pixels of the last frame that have not been learned by the
+     * background model because they are inside the shadow, i.e. the pixels that would have been
+     * phantom foreground after the foreground object left.
+     */
+    int getSuppressedPixels() const;
+    long long getTotalSuppressedPixels() const;
 
     void process(const cv::Mat& depthMap);
 
 private:
+    struct TileSignature
+    {
+        float minDepth;
+        float maxDepth;
+        float sum;
+        int numValid;
+    };
+
+    bool isFixedPoint() const;
     void reset();
-    void filterContours();
+    void allocate(int rows, int cols);
+    void updateRunningAverage(const cv::Mat& depthMap);
+    void updateMixture(const cv::Mat& depthMap);
+    void detectChanges(const cv::Mat& depthMap, int tileRow, std::vector<TileSignature>& signatures,
+                       std::vector<cv::Vec2i>& spans);
+    void getDirtySpans(int tileRow, int cols, std::vector<cv::Vec2i>& spans) const;
+    void updateSuppressedPixels(const std::vector<int>& bandSuppressedPixels);
+    void filterComponents();
 
     cv::Mat m_background;
     cv::Mat m_foreground;
+    cv::Mat m_rawForeground;
     cv::Mat m_foregroundMask;
+    cv::Mat m_shadow;
     cv::Mat m_count;
-    std::vector<std::vector<cv::Point>> m_contours;
-    cv::Mat m_tempContour;
+    cv::Mat m_fixedBackground;
+    cv::Mat m_fixedCount;
+    mutable cv::Mat m_convertedBackground;
+    std::vector<BitMask::Run> m_runs;
+    std::vector<int> m_runLabels;
+    std::vector<int> m_componentAreas;
+    std::vector<int> m_rowRuns;
+    BitMask m_maskBits;
+    BitMask m_tempBits;
+    BitMask m_dirtyTiles;
+    BitMask m_foregroundTiles;
+    std::vector<TileSignature> m_tileSignatures;
 
     int     m_updateFrames;
     int     m_updateDelayFrames;
@@ -76,6 +214,18 @@ private:
     float   m_foregroundDistance;
     int     m_minSize;
     int     m_minRatio;
+    int     m_numBands;
+    bool    m_shadowEnabled;
+    int     m_shadowMargin;
+    int     m_suppressedPixels;
+    long long m_totalSuppressedPixels;
+    bool    m_tileSkipEnabled;
+    float   m_tileTolerance;
+    bool    m_allTilesDirty;
+
+    BackgroundModel m_backgroundModel;
+    BackgroundStorage m_backgroundStorage;
+    std::unique_ptr<BackgroundMixture> m_mixture;
 };
 }
 
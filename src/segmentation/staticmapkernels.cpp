@@ -0,0 +1,850 @@
+#include "staticmapkernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+// ---------------------------------------------------------------------------------------------
+// scalar fallback, also used for the remaining pixels at the end of each row
+// ---------------------------------------------------------------------------------------------
+
+static int classifyRowScalar(const float* depth, const float* background, float* foreground,
+                             unsigned char* mask, int cols, float foregroundDistance)
+{
+    int numForeground = 0;
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+        const float threshold = background[j] - foregroundDistance;
+
+        // create foreground mask
+        const bool isForeground = dist > 0 && dist < threshold;
+        foreground[j] = isForeground ? dist : 0;
+        mask[j] = isForeground ? 255 : 0;
+        numForeground += isForeground;
+    }
+
+    return numForeground;
+}
+
+static int updateRowScalar(const float* depth, float* background, float* count,
+                           const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    int numSuppressed = 0;
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+        const float bg = background[j];
+        const float threshold = bg - foregroundDistance;
+        const bool update = dist > 0 && dist > threshold;
+
+        // update background model with cumulative moving average
+        if (update && !shadow[j]) {
+            const float newCount = count[j] + 1;
+            background[j] = bg + (dist - bg) / newCount;
+            count[j] = newCount;
+        }
+
+        numSuppressed += update && shadow[j];
+    }
+
+    return numSuppressed;
+}
+
+static void addBackRowScalar(const float* depth, const float* foreground, const unsigned char* shadow,
+                             float* background, const float* count, int cols)
+{
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+
+        if (foreground[j] == 0 && dist != 0 && !shadow[j])
+            background[j] = background[j] + (dist - background[j]) / std::max(count[j], 1.0f);
+    }
+}
+
+// the 16 bit background stores the depth in fixed point, the count is saturated at the maximum of
+// the 16 bits
+static const float fixedPointScale = (float)StaticMapKernels::FIXED_POINT_SCALE;
+static const float fixedPointStep = 1.0f / StaticMapKernels::FIXED_POINT_SCALE;
+static const float maxFixedPoint = 65535.0f;
+
+static inline unsigned short storeFixed16(float value)
+{
+    // same order of operations as the vector versions, NaN is stored as 0
+    value = value > 0 ? value : 0;
+    value = value < maxFixedPoint ? value : maxFixedPoint;
+    return (unsigned short)lrintf(value);
+}
+
+static int classifyRowFixed16Scalar(const float* depth, const unsigned short* background, float* foreground,
+                                    unsigned char* mask, int cols, float foregroundDistance)
+{
+    int numForeground = 0;
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+        const float threshold = background[j] * fixedPointStep - foregroundDistance;
+
+        const bool isForeground = dist > 0 && dist < threshold;
+        foreground[j] = isForeground ? dist : 0;
+        mask[j] = isForeground ? 255 : 0;
+        numForeground += isForeground;
+    }
+
+    return numForeground;
+}
+
+static int updateRowFixed16Scalar(const float* depth, unsigned short* background, unsigned short* count,
+                                  const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    int numSuppressed = 0;
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+        const float bg = background[j] * fixedPointStep;
+        const float threshold = bg - foregroundDistance;
+        const bool update = dist > 0 && dist > threshold;
+
+        if (update && !shadow[j]) {
+            const float newCount = std::min(count[j] + 1.0f, maxFixedPoint);
+            background[j] = storeFixed16((bg + (dist - bg) / newCount) * fixedPointScale);
+            count[j] = (unsigned short)newCount;
+        }
+
+        numSuppressed += update && shadow[j];
+    }
+
+    return numSuppressed;
+}
+
+static void addBackRowFixed16Scalar(const float* depth, const float* foreground, const unsigned char* shadow,
+                                    unsigned short* background, const unsigned short* count, int cols)
+{
+    for (int j = 0; j < cols; j++) {
+        const float dist = depth[j];
+        const float bg = background[j] * fixedPointStep;
+
+        if (foreground[j] == 0 && dist != 0 && !shadow[j])
+            background[j] = storeFixed16((bg + (dist - bg) / std::max((float)count[j], 1.0f)) * fixedPointScale);
+    }
+}
+
+#ifdef POSE_SIMD_X86
+
+// ---------------------------------------------------------------------------------------------
+// SSE4.1, 4 pixels per vector, 16 pixels per iteration to pack the mask into 16 bytes
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("sse4.1")
+static inline __m128 loadShadowSSE41(const unsigned char* shadow)
+{
+    // widen 4 bytes to 4 lanes that are all set where the shadow is set
+    int bytes;
+    memcpy(&bytes, shadow, sizeof(int));
+    const __m128i shadow32 = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+    return _mm_castsi128_ps(_mm_cmpgt_epi32(shadow32, _mm_setzero_si128()));
+}
+
+POSE_TARGET("sse4.1")
+static inline int horizontalSumSSE41(__m128i sum)
+{
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+POSE_TARGET("sse4.1")
+static int classifyRowSSE41(const float* depth, const float* background, float* foreground,
+                            unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 distance = _mm_set1_ps(foregroundDistance);
+
+    // set lanes are -1, so subtracting the masks counts them
+    __m128i numForeground = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        __m128i masks[4];
+
+        for (int k = 0; k < 4; k++) {
+            const int o = j + k * 4;
+            const __m128 dist = _mm_loadu_ps(depth + o);
+            const __m128 threshold = _mm_sub_ps(_mm_loadu_ps(background + o), distance);
+
+            const __m128 isForeground = _mm_and_ps(_mm_cmpgt_ps(dist, zero), _mm_cmplt_ps(dist, threshold));
+
+            _mm_storeu_ps(foreground + o, _mm_and_ps(dist, isForeground));
+            masks[k] = _mm_castps_si128(isForeground);
+            numForeground = _mm_sub_epi32(numForeground, masks[k]);
+        }
+
+        // all bits set (-1) saturates to 0xff
+        const __m128i masks01 = _mm_packs_epi32(masks[0], masks[1]);
+        const __m128i masks23 = _mm_packs_epi32(masks[2], masks[3]);
+        _mm_storeu_si128((__m128i*)(mask + j), _mm_packs_epi16(masks01, masks23));
+    }
+
+    return horizontalSumSSE41(numForeground) +
+            classifyRowScalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("sse4.1")
+static int updateRowSSE41(const float* depth, float* background, float* count,
+                          const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 distance = _mm_set1_ps(foregroundDistance);
+
+    __m128i numSuppressed = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+        const __m128 bg = _mm_loadu_ps(background + j);
+        const __m128 c = _mm_loadu_ps(count + j);
+        const __m128 threshold = _mm_sub_ps(bg, distance);
+        const __m128 inShadow = loadShadowSSE41(shadow + j);
+
+        const __m128 wouldUpdate = _mm_and_ps(_mm_cmpgt_ps(dist, zero), _mm_cmpgt_ps(dist, threshold));
+        const __m128 update = _mm_andnot_ps(inShadow, wouldUpdate);
+
+        const __m128 newCount = _mm_add_ps(c, one);
+        const __m128 newBg = _mm_add_ps(bg, _mm_div_ps(_mm_sub_ps(dist, bg), newCount));
+
+        _mm_storeu_ps(background + j, _mm_blendv_ps(bg, newBg, update));
+        _mm_storeu_ps(count + j, _mm_blendv_ps(c, newCount, update));
+        numSuppressed = _mm_sub_epi32(numSuppressed, _mm_castps_si128(_mm_and_ps(inShadow, wouldUpdate)));
+    }
+
+    return horizontalSumSSE41(numSuppressed) +
+            updateRowScalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("sse4.1")
+static void addBackRowSSE41(const float* depth, const float* foreground, const unsigned char* shadow,
+                            float* background, const float* count, int cols)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+        const __m128 bg = _mm_loadu_ps(background + j);
+        const __m128 c = _mm_max_ps(_mm_loadu_ps(count + j), one);
+        const __m128 select = _mm_andnot_ps(loadShadowSSE41(shadow + j),
+                                            _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(foreground + j), zero),
+                                                       _mm_cmpneq_ps(dist, zero)));
+
+        const __m128 newBg = _mm_add_ps(bg, _mm_div_ps(_mm_sub_ps(dist, bg), c));
+        _mm_storeu_ps(background + j, _mm_blendv_ps(bg, newBg, select));
+    }
+
+    addBackRowScalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+POSE_TARGET("sse4.1")
+static inline __m128 loadFixed16SSE41(const unsigned short* values)
+{
+    return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)values)));
+}
+
+POSE_TARGET("sse4.1")
+static inline void storeFixed16SSE41(unsigned short* values, __m128 x)
+{
+    x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(maxFixedPoint));
+    const __m128i x32 = _mm_cvtps_epi32(x);
+    _mm_storel_epi64((__m128i*)values, _mm_packus_epi32(x32, x32));
+}
+
+POSE_TARGET("sse4.1")
+static int classifyRowFixed16SSE41(const float* depth, const unsigned short* background, float* foreground,
+                                   unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 step = _mm_set1_ps(fixedPointStep);
+    const __m128 distance = _mm_set1_ps(foregroundDistance);
+
+    __m128i numForeground = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        __m128i masks[4];
+
+        for (int k = 0; k < 4; k++) {
+            const int o = j + k * 4;
+            const __m128 dist = _mm_loadu_ps(depth + o);
+            const __m128 threshold = _mm_sub_ps(_mm_mul_ps(loadFixed16SSE41(background + o), step), distance);
+
+            const __m128 isForeground = _mm_and_ps(_mm_cmpgt_ps(dist, zero), _mm_cmplt_ps(dist, threshold));
+
+            _mm_storeu_ps(foreground + o, _mm_and_ps(dist, isForeground));
+            masks[k] = _mm_castps_si128(isForeground);
+            numForeground = _mm_sub_epi32(numForeground, masks[k]);
+        }
+
+        const __m128i masks01 = _mm_packs_epi32(masks[0], masks[1]);
+        const __m128i masks23 = _mm_packs_epi32(masks[2], masks[3]);
+        _mm_storeu_si128((__m128i*)(mask + j), _mm_packs_epi16(masks01, masks23));
+    }
+
+    return horizontalSumSSE41(numForeground) +
+            classifyRowFixed16Scalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("sse4.1")
+static int updateRowFixed16SSE41(const float* depth, unsigned short* background, unsigned short* count,
+                                 const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 maxCount = _mm_set1_ps(maxFixedPoint);
+    const __m128 scale = _mm_set1_ps(fixedPointScale);
+    const __m128 step = _mm_set1_ps(fixedPointStep);
+    const __m128 distance = _mm_set1_ps(foregroundDistance);
+
+    __m128i numSuppressed = _mm_setzero_si128();
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+        const __m128 bg = _mm_mul_ps(loadFixed16SSE41(background + j), step);
+        const __m128 c = loadFixed16SSE41(count + j);
+        const __m128 threshold = _mm_sub_ps(bg, distance);
+        const __m128 inShadow = loadShadowSSE41(shadow + j);
+
+        const __m128 wouldUpdate = _mm_and_ps(_mm_cmpgt_ps(dist, zero), _mm_cmpgt_ps(dist, threshold));
+        const __m128 update = _mm_andnot_ps(inShadow, wouldUpdate);
+
+        const __m128 newCount = _mm_min_ps(_mm_add_ps(c, one), maxCount);
+        const __m128 newBg = _mm_add_ps(bg, _mm_div_ps(_mm_sub_ps(dist, bg), newCount));
+
+        // the background that is not updated is stored again unchanged, since it is exact
+        storeFixed16SSE41(background + j, _mm_mul_ps(_mm_blendv_ps(bg, newBg, update), scale));
+        storeFixed16SSE41(count + j, _mm_blendv_ps(c, newCount, update));
+        numSuppressed = _mm_sub_epi32(numSuppressed, _mm_castps_si128(_mm_and_ps(inShadow, wouldUpdate)));
+    }
+
+    return horizontalSumSSE41(numSuppressed) +
+            updateRowFixed16Scalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("sse4.1")
+static void addBackRowFixed16SSE41(const float* depth, const float* foreground, const unsigned char* shadow,
+                                   unsigned short* background, const unsigned short* count, int cols)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(fixedPointScale);
+    const __m128 step = _mm_set1_ps(fixedPointStep);
+
+    int j = 0;
+    for (; j + 4 <= cols; j += 4) {
+        const __m128 dist = _mm_loadu_ps(depth + j);
+        const __m128 bg = _mm_mul_ps(loadFixed16SSE41(background + j), step);
+        const __m128 c = _mm_max_ps(loadFixed16SSE41(count + j), one);
+        const __m128 select = _mm_andnot_ps(loadShadowSSE41(shadow + j),
+                                            _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(foreground + j), zero),
+                                                       _mm_cmpneq_ps(dist, zero)));
+
+        const __m128 newBg = _mm_add_ps(bg, _mm_div_ps(_mm_sub_ps(dist, bg), c));
+        storeFixed16SSE41(background + j, _mm_mul_ps(_mm_blendv_ps(bg, newBg, select), scale));
+    }
+
+    addBackRowFixed16Scalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+// ---------------------------------------------------------------------------------------------
+// AVX2, 8 pixels per vector, 32 pixels per iteration to pack the mask into 32 bytes
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("avx2")
+static inline __m256 loadShadowAVX2(const unsigned char* shadow)
+{
+    // widen 8 bytes to 8 lanes that are all set where the shadow is set
+    const __m256i shadow32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)shadow));
+    return _mm256_castsi256_ps(_mm256_cmpgt_epi32(shadow32, _mm256_setzero_si256()));
+}
+
+POSE_TARGET("avx2")
+static inline int horizontalSumAVX2(__m256i sum)
+{
+    return horizontalSumSSE41(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+}
+
+POSE_TARGET("avx2")
+static int classifyRowAVX2(const float* depth, const float* background, float* foreground,
+                           unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 distance = _mm256_set1_ps(foregroundDistance);
+    const __m256i maskOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    // set lanes are -1, so subtracting the masks counts them
+    __m256i numForeground = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 32 <= cols; j += 32) {
+        __m256i masks[4];
+
+        for (int k = 0; k < 4; k++) {
+            const int o = j + k * 8;
+            const __m256 dist = _mm256_loadu_ps(depth + o);
+            const __m256 threshold = _mm256_sub_ps(_mm256_loadu_ps(background + o), distance);
+
+            const __m256 isForeground = _mm256_and_ps(_mm256_cmp_ps(dist, zero, _CMP_GT_OQ),
+                                                      _mm256_cmp_ps(dist, threshold, _CMP_LT_OQ));
+
+            _mm256_storeu_ps(foreground + o, _mm256_and_ps(dist, isForeground));
+            masks[k] = _mm256_castps_si256(isForeground);
+            numForeground = _mm256_sub_epi32(numForeground, masks[k]);
+        }
+
+        // the packs work on 128 bit lanes, so the 4 byte groups have to be reordered afterwards
+        const __m256i masks01 = _mm256_packs_epi32(masks[0], masks[1]);
+        const __m256i masks23 = _mm256_packs_epi32(masks[2], masks[3]);
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(masks01, masks23), maskOrder);
+        _mm256_storeu_si256((__m256i*)(mask + j), bytes);
+    }
+
+    return horizontalSumAVX2(numForeground) +
+            classifyRowScalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx2")
+static int updateRowAVX2(const float* depth, float* background, float* count,
+                         const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 distance = _mm256_set1_ps(foregroundDistance);
+
+    __m256i numSuppressed = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+        const __m256 bg = _mm256_loadu_ps(background + j);
+        const __m256 c = _mm256_loadu_ps(count + j);
+        const __m256 threshold = _mm256_sub_ps(bg, distance);
+        const __m256 inShadow = loadShadowAVX2(shadow + j);
+
+        const __m256 wouldUpdate = _mm256_and_ps(_mm256_cmp_ps(dist, zero, _CMP_GT_OQ),
+                                                 _mm256_cmp_ps(dist, threshold, _CMP_GT_OQ));
+        const __m256 update = _mm256_andnot_ps(inShadow, wouldUpdate);
+
+        const __m256 newCount = _mm256_add_ps(c, one);
+        const __m256 newBg = _mm256_add_ps(bg, _mm256_div_ps(_mm256_sub_ps(dist, bg), newCount));
+
+        _mm256_storeu_ps(background + j, _mm256_blendv_ps(bg, newBg, update));
+        _mm256_storeu_ps(count + j, _mm256_blendv_ps(c, newCount, update));
+        numSuppressed = _mm256_sub_epi32(numSuppressed, _mm256_castps_si256(_mm256_and_ps(inShadow, wouldUpdate)));
+    }
+
+    return horizontalSumAVX2(numSuppressed) +
+            updateRowScalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx2")
+static void addBackRowAVX2(const float* depth, const float* foreground, const unsigned char* shadow,
+                           float* background, const float* count, int cols)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+        const __m256 bg = _mm256_loadu_ps(background + j);
+        const __m256 c = _mm256_max_ps(_mm256_loadu_ps(count + j), one);
+        const __m256 select = _mm256_andnot_ps(loadShadowAVX2(shadow + j),
+                                               _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(foreground + j), zero, _CMP_EQ_OQ),
+                                                             _mm256_cmp_ps(dist, zero, _CMP_NEQ_UQ)));
+
+        const __m256 newBg = _mm256_add_ps(bg, _mm256_div_ps(_mm256_sub_ps(dist, bg), c));
+        _mm256_storeu_ps(background + j, _mm256_blendv_ps(bg, newBg, select));
+    }
+
+    addBackRowScalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+POSE_TARGET("avx2")
+static inline __m256 loadFixed16AVX2(const unsigned short* values)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)values)));
+}
+
+POSE_TARGET("avx2")
+static inline void storeFixed16AVX2(unsigned short* values, __m256 x)
+{
+    // the pack works on 128 bit lanes, so the two 64 bit halves of the result are gathered afterwards
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(maxFixedPoint));
+    const __m256i x32 = _mm256_cvtps_epi32(x);
+    const __m256i x16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(x32, x32), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i*)values, _mm256_castsi256_si128(x16));
+}
+
+POSE_TARGET("avx2")
+static int classifyRowFixed16AVX2(const float* depth, const unsigned short* background, float* foreground,
+                                  unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 step = _mm256_set1_ps(fixedPointStep);
+    const __m256 distance = _mm256_set1_ps(foregroundDistance);
+    const __m256i maskOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    __m256i numForeground = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 32 <= cols; j += 32) {
+        __m256i masks[4];
+
+        for (int k = 0; k < 4; k++) {
+            const int o = j + k * 8;
+            const __m256 dist = _mm256_loadu_ps(depth + o);
+            const __m256 threshold = _mm256_sub_ps(_mm256_mul_ps(loadFixed16AVX2(background + o), step), distance);
+
+            const __m256 isForeground = _mm256_and_ps(_mm256_cmp_ps(dist, zero, _CMP_GT_OQ),
+                                                      _mm256_cmp_ps(dist, threshold, _CMP_LT_OQ));
+
+            _mm256_storeu_ps(foreground + o, _mm256_and_ps(dist, isForeground));
+            masks[k] = _mm256_castps_si256(isForeground);
+            numForeground = _mm256_sub_epi32(numForeground, masks[k]);
+        }
+
+        const __m256i masks01 = _mm256_packs_epi32(masks[0], masks[1]);
+        const __m256i masks23 = _mm256_packs_epi32(masks[2], masks[3]);
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(masks01, masks23), maskOrder);
+        _mm256_storeu_si256((__m256i*)(mask + j), bytes);
+    }
+
+    return horizontalSumAVX2(numForeground) +
+            classifyRowFixed16Scalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx2")
+static int updateRowFixed16AVX2(const float* depth, unsigned short* background, unsigned short* count,
+                                const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 maxCount = _mm256_set1_ps(maxFixedPoint);
+    const __m256 scale = _mm256_set1_ps(fixedPointScale);
+    const __m256 step = _mm256_set1_ps(fixedPointStep);
+    const __m256 distance = _mm256_set1_ps(foregroundDistance);
+
+    __m256i numSuppressed = _mm256_setzero_si256();
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+        const __m256 bg = _mm256_mul_ps(loadFixed16AVX2(background + j), step);
+        const __m256 c = loadFixed16AVX2(count + j);
+        const __m256 threshold = _mm256_sub_ps(bg, distance);
+        const __m256 inShadow = loadShadowAVX2(shadow + j);
+
+        const __m256 wouldUpdate = _mm256_and_ps(_mm256_cmp_ps(dist, zero, _CMP_GT_OQ),
+                                                 _mm256_cmp_ps(dist, threshold, _CMP_GT_OQ));
+        const __m256 update = _mm256_andnot_ps(inShadow, wouldUpdate);
+
+        const __m256 newCount = _mm256_min_ps(_mm256_add_ps(c, one), maxCount);
+        const __m256 newBg = _mm256_add_ps(bg, _mm256_div_ps(_mm256_sub_ps(dist, bg), newCount));
+
+        storeFixed16AVX2(background + j, _mm256_mul_ps(_mm256_blendv_ps(bg, newBg, update), scale));
+        storeFixed16AVX2(count + j, _mm256_blendv_ps(c, newCount, update));
+        numSuppressed = _mm256_sub_epi32(numSuppressed, _mm256_castps_si256(_mm256_and_ps(inShadow, wouldUpdate)));
+    }
+
+    return horizontalSumAVX2(numSuppressed) +
+            updateRowFixed16Scalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx2")
+static void addBackRowFixed16AVX2(const float* depth, const float* foreground, const unsigned char* shadow,
+                                  unsigned short* background, const unsigned short* count, int cols)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(fixedPointScale);
+    const __m256 step = _mm256_set1_ps(fixedPointStep);
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256 dist = _mm256_loadu_ps(depth + j);
+        const __m256 bg = _mm256_mul_ps(loadFixed16AVX2(background + j), step);
+        const __m256 c = _mm256_max_ps(loadFixed16AVX2(count + j), one);
+        const __m256 select = _mm256_andnot_ps(loadShadowAVX2(shadow + j),
+                                               _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(foreground + j), zero, _CMP_EQ_OQ),
+                                                             _mm256_cmp_ps(dist, zero, _CMP_NEQ_UQ)));
+
+        const __m256 newBg = _mm256_add_ps(bg, _mm256_div_ps(_mm256_sub_ps(dist, bg), c));
+        storeFixed16AVX2(background + j, _mm256_mul_ps(_mm256_blendv_ps(bg, newBg, select), scale));
+    }
+
+    addBackRowFixed16Scalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+#ifdef POSE_SIMD_AVX512
+
+// ---------------------------------------------------------------------------------------------
+// AVX-512, 16 pixels per vector using mask registers
+// ---------------------------------------------------------------------------------------------
+
+POSE_TARGET("avx512f")
+static inline __mmask16 loadShadowAVX512(const unsigned char* shadow)
+{
+    const __m512i shadow32 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)shadow));
+    return _mm512_test_epi32_mask(shadow32, shadow32);
+}
+
+POSE_TARGET("avx512f")
+static int classifyRowAVX512(const float* depth, const float* background, float* foreground,
+                             unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 distance = _mm512_set1_ps(foregroundDistance);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    __m512i numForeground = _mm512_setzero_si512();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 threshold = _mm512_sub_ps(_mm512_loadu_ps(background + j), distance);
+
+        const __mmask16 valid = _mm512_cmp_ps_mask(dist, zero, _CMP_GT_OQ);
+        const __mmask16 isForeground = _mm512_mask_cmp_ps_mask(valid, dist, threshold, _CMP_LT_OQ);
+
+        _mm512_storeu_ps(foreground + j, _mm512_maskz_mov_ps(isForeground, dist));
+        _mm_storeu_si128((__m128i*)(mask + j), _mm512_cvtepi32_epi8(_mm512_maskz_set1_epi32(isForeground, 255)));
+        numForeground = _mm512_mask_add_epi32(numForeground, isForeground, numForeground, one);
+    }
+
+    return _mm512_reduce_add_epi32(numForeground) +
+            classifyRowScalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx512f")
+static int updateRowAVX512(const float* depth, float* background, float* count,
+                           const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 distance = _mm512_set1_ps(foregroundDistance);
+    const __m512i oneInt = _mm512_set1_epi32(1);
+
+    __m512i numSuppressed = _mm512_setzero_si512();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 bg = _mm512_loadu_ps(background + j);
+        const __m512 c = _mm512_loadu_ps(count + j);
+        const __m512 threshold = _mm512_sub_ps(bg, distance);
+        const __mmask16 inShadow = loadShadowAVX512(shadow + j);
+
+        const __mmask16 valid = _mm512_cmp_ps_mask(dist, zero, _CMP_GT_OQ);
+        const __mmask16 wouldUpdate = _mm512_mask_cmp_ps_mask(valid, dist, threshold, _CMP_GT_OQ);
+        const __mmask16 update = wouldUpdate & ~inShadow;
+
+        const __m512 newCount = _mm512_add_ps(c, one);
+        const __m512 newBg = _mm512_add_ps(bg, _mm512_div_ps(_mm512_sub_ps(dist, bg), newCount));
+
+        _mm512_storeu_ps(background + j, _mm512_mask_blend_ps(update, bg, newBg));
+        _mm512_storeu_ps(count + j, _mm512_mask_blend_ps(update, c, newCount));
+        numSuppressed = _mm512_mask_add_epi32(numSuppressed, wouldUpdate & inShadow, numSuppressed, oneInt);
+    }
+
+    return _mm512_reduce_add_epi32(numSuppressed) +
+            updateRowScalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx512f")
+static void addBackRowAVX512(const float* depth, const float* foreground, const unsigned char* shadow,
+                             float* background, const float* count, int cols)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 bg = _mm512_loadu_ps(background + j);
+        const __m512 c = _mm512_max_ps(_mm512_loadu_ps(count + j), one);
+        const __mmask16 select = _mm512_cmp_ps_mask(_mm512_loadu_ps(foreground + j), zero, _CMP_EQ_OQ) &
+                                 _mm512_cmp_ps_mask(dist, zero, _CMP_NEQ_UQ) &
+                                 ~loadShadowAVX512(shadow + j);
+
+        const __m512 newBg = _mm512_add_ps(bg, _mm512_div_ps(_mm512_sub_ps(dist, bg), c));
+        _mm512_storeu_ps(background + j, _mm512_mask_blend_ps(select, bg, newBg));
+    }
+
+    addBackRowScalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+POSE_TARGET("avx512f")
+static inline __m512 loadFixed16AVX512(const unsigned short* values)
+{
+    return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)values)));
+}
+
+POSE_TARGET("avx512f")
+static inline void storeFixed16AVX512(unsigned short* values, __m512 x)
+{
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_setzero_ps()), _mm512_set1_ps(maxFixedPoint));
+    _mm256_storeu_si256((__m256i*)values, _mm512_cvtepi32_epi16(_mm512_cvtps_epi32(x)));
+}
+
+POSE_TARGET("avx512f")
+static int classifyRowFixed16AVX512(const float* depth, const unsigned short* background, float* foreground,
+                                    unsigned char* mask, int cols, float foregroundDistance)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 step = _mm512_set1_ps(fixedPointStep);
+    const __m512 distance = _mm512_set1_ps(foregroundDistance);
+    const __m512i one = _mm512_set1_epi32(1);
+
+    __m512i numForeground = _mm512_setzero_si512();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 threshold = _mm512_sub_ps(_mm512_mul_ps(loadFixed16AVX512(background + j), step), distance);
+
+        const __mmask16 valid = _mm512_cmp_ps_mask(dist, zero, _CMP_GT_OQ);
+        const __mmask16 isForeground = _mm512_mask_cmp_ps_mask(valid, dist, threshold, _CMP_LT_OQ);
+
+        _mm512_storeu_ps(foreground + j, _mm512_maskz_mov_ps(isForeground, dist));
+        _mm_storeu_si128((__m128i*)(mask + j), _mm512_cvtepi32_epi8(_mm512_maskz_set1_epi32(isForeground, 255)));
+        numForeground = _mm512_mask_add_epi32(numForeground, isForeground, numForeground, one);
+    }
+
+    return _mm512_reduce_add_epi32(numForeground) +
+            classifyRowFixed16Scalar(depth + j, background + j, foreground + j, mask + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx512f")
+static int updateRowFixed16AVX512(const float* depth, unsigned short* background, unsigned short* count,
+                                  const unsigned char* shadow, int cols, float foregroundDistance)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 maxCount = _mm512_set1_ps(maxFixedPoint);
+    const __m512 scale = _mm512_set1_ps(fixedPointScale);
+    const __m512 step = _mm512_set1_ps(fixedPointStep);
+    const __m512 distance = _mm512_set1_ps(foregroundDistance);
+    const __m512i oneInt = _mm512_set1_epi32(1);
+
+    __m512i numSuppressed = _mm512_setzero_si512();
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 bg = _mm512_mul_ps(loadFixed16AVX512(background + j), step);
+        const __m512 c = loadFixed16AVX512(count + j);
+        const __m512 threshold = _mm512_sub_ps(bg, distance);
+        const __mmask16 inShadow = loadShadowAVX512(shadow + j);
+
+        const __mmask16 valid = _mm512_cmp_ps_mask(dist, zero, _CMP_GT_OQ);
+        const __mmask16 wouldUpdate = _mm512_mask_cmp_ps_mask(valid, dist, threshold, _CMP_GT_OQ);
+        const __mmask16 update = wouldUpdate & ~inShadow;
+
+        const __m512 newCount = _mm512_min_ps(_mm512_add_ps(c, one), maxCount);
+        const __m512 newBg = _mm512_add_ps(bg, _mm512_div_ps(_mm512_sub_ps(dist, bg), newCount));
+
+        storeFixed16AVX512(background + j, _mm512_mul_ps(_mm512_mask_blend_ps(update, bg, newBg), scale));
+        storeFixed16AVX512(count + j, _mm512_mask_blend_ps(update, c, newCount));
+        numSuppressed = _mm512_mask_add_epi32(numSuppressed, wouldUpdate & inShadow, numSuppressed, oneInt);
+    }
+
+    return _mm512_reduce_add_epi32(numSuppressed) +
+            updateRowFixed16Scalar(depth + j, background + j, count + j, shadow + j, cols - j, foregroundDistance);
+}
+
+POSE_TARGET("avx512f")
+static void addBackRowFixed16AVX512(const float* depth, const float* foreground, const unsigned char* shadow,
+                                    unsigned short* background, const unsigned short* count, int cols)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 scale = _mm512_set1_ps(fixedPointScale);
+    const __m512 step = _mm512_set1_ps(fixedPointStep);
+
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        const __m512 dist = _mm512_loadu_ps(depth + j);
+        const __m512 bg = _mm512_mul_ps(loadFixed16AVX512(background + j), step);
+        const __m512 c = _mm512_max_ps(loadFixed16AVX512(count + j), one);
+        const __mmask16 select = _mm512_cmp_ps_mask(_mm512_loadu_ps(foreground + j), zero, _CMP_EQ_OQ) &
+                                 _mm512_cmp_ps_mask(dist, zero, _CMP_NEQ_UQ) &
+                                 ~loadShadowAVX512(shadow + j);
+
+        const __m512 newBg = _mm512_add_ps(bg, _mm512_div_ps(_mm512_sub_ps(dist, bg), c));
+        storeFixed16AVX512(background + j, _mm512_mul_ps(_mm512_mask_blend_ps(select, bg, newBg), scale));
+    }
+
+    addBackRowFixed16Scalar(depth + j, foreground + j, shadow + j, background + j, count + j, cols - j);
+}
+
+#endif // POSE_SIMD_AVX512
+
+#endif // POSE_SIMD_X86
+
+StaticMapKernels StaticMapKernels::get(CpuFeatures::InstructionSet instructionSet)
+{
+    StaticMapKernels kernels;
+    kernels.instructionSet = CpuFeatures::IS_SCALAR;
+    kernels.classifyRow = classifyRowScalar;
+    kernels.updateRow = updateRowScalar;
+    kernels.addBackRow = addBackRowScalar;
+    kernels.classifyRowFixed16 = classifyRowFixed16Scalar;
+    kernels.updateRowFixed16 = updateRowFixed16Scalar;
+    kernels.addBackRowFixed16 = addBackRowFixed16Scalar;
+
+#ifdef POSE_SIMD_X86
+    switch (instructionSet) {
+    case CpuFeatures::IS_AVX512:
+#ifdef POSE_SIMD_AVX512
+        kernels.instructionSet = CpuFeatures::IS_AVX512;
+        kernels.classifyRow = classifyRowAVX512;
+        kernels.updateRow = updateRowAVX512;
+        kernels.addBackRow = addBackRowAVX512;
+        kernels.classifyRowFixed16 = classifyRowFixed16AVX512;
+        kernels.updateRowFixed16 = updateRowFixed16AVX512;
+        kernels.addBackRowFixed16 = addBackRowFixed16AVX512;
+        break;
+#endif
+        // without the AVX-512 kernels the AVX2 ones are used
+    case CpuFeatures::IS_AVX2:
+        kernels.instructionSet = CpuFeatures::IS_AVX2;
+        kernels.classifyRow = classifyRowAVX2;
+        kernels.updateRow = updateRowAVX2;
+        kernels.addBackRow = addBackRowAVX2;
+        kernels.classifyRowFixed16 = classifyRowFixed16AVX2;
+        kernels.updateRowFixed16 = updateRowFixed16AVX2;
+        kernels.addBackRowFixed16 = addBackRowFixed16AVX2;
+        break;
+    case CpuFeatures::IS_AVX:
+        // there are no AVX kernels, the SSE4.1 ones are used
+    case CpuFeatures::IS_SSE41:
+        kernels.instructionSet = CpuFeatures::IS_SSE41;
+        kernels.classifyRow = classifyRowSSE41;
+        kernels.updateRow = updateRowSSE41;
+        kernels.addBackRow = addBackRowSSE41;
+        kernels.classifyRowFixed16 = classifyRowFixed16SSE41;
+        kernels.updateRowFixed16 = updateRowFixed16SSE41;
+        kernels.addBackRowFixed16 = addBackRowFixed16SSE41;
+        break;
+    case CpuFeatures::IS_SCALAR:
+        break;
+    }
+#else
+    (void)instructionSet;
+#endif
+
+    return kernels;
+}
+}
@@ -0,0 +1,71 @@
+#ifndef STATICMAPKERNELS_H
+#define STATICMAPKERNELS_H
+
+#include <utils/cpufeatures.h>
+
+namespace pose
+{
+/**
+ * @brief Row kernels of the background model in StaticMap. Each kernel exists as a scalar
+ * fallback and as SSE4.1, AVX2 and AVX-512 versions, the best version is selected at runtime.
+ */
+struct StaticMapKernels
+{
+    /**
+     * @brief Writes the foreground depth and the foreground mask (255) of all pixels that are in
+     * front of the background model. All other foreground and mask values are set to 0. Returns
+     * the number of foreground pixels.
+     */
+    typedef int (*ClassifyRowFunc)(const float* depth, const float* background, float* foreground,
+                                   unsigned char* mask, int cols, float foregroundDistance);
+
+    /**
+     * @brief Updates the running average of all pixels that are behind or close to the background
+     * model and not inside the shadow (non-zero). Returns the number of pixels that would have
+     * been updated without the shadow.
+     */
+    typedef int (*UpdateRowFunc)(const float* depth, float* background, float* count,
+                                 const unsigned char* shadow, int cols, float foregroundDistance);
+
+    /**
+     * @brief Adds all valid pixels that are neither part of the foreground nor of the shadow back
+     * to the background model.
+     */
+    typedef void (*AddBackRowFunc)(const float* depth, const float* foreground, const unsigned char* shadow,
+                                   float* background, const float* count, int cols);
+
+    /**
+     * @brief Number of steps per meter of the 16 bit fixed-point background, i.e. it covers 0 to
+     * 16 meters with a resolution of 0.25 mm.
+     */
+    static const int FIXED_POINT_SCALE = 4096;
+
+    /**
+     * @brief Versions of the kernels above for the 16 bit background, the depth is stored in fixed
+     * point (see FIXED_POINT_SCALE) and the count saturates at 65535. The values are widened to
+     * floats, so the results only differ from the float kernels by the rounding of the background.
+     */
+    typedef int (*ClassifyRowFixed16Func)(const float* depth, const unsigned short* background, float* foreground,
+                                          unsigned char* mask, int cols, float foregroundDistance);
+    typedef int (*UpdateRowFixed16Func)(const float* depth, unsigned short* background, unsigned short* count,
+                                        const unsigned char* shadow, int cols, float foregroundDistance);
+    typedef void (*AddBackRowFixed16Func)(const float* depth, const float* foreground, const unsigned char* shadow,
+                                          unsigned short* background, const unsigned short* count, int cols);
+
+    CpuFeatures::InstructionSet instructionSet;
+    ClassifyRowFunc classifyRow;
+    UpdateRowFunc updateRow;
+    AddBackRowFunc addBackRow;
+    ClassifyRowFixed16Func classifyRowFixed16;
+    UpdateRowFixed16Func updateRowFixed16;
+    AddBackRowFixed16Func addBackRowFixed16;
+
+    /**
+     * @brief Get the kernels for the given instruction set or the best available if the
+     * instruction set is not supported by the build.
+     */
+    static StaticMapKernels get(CpuFeatures::InstructionSet instructionSet);
+};
+}
+
+#endif // STATICMAPKERNELS_H
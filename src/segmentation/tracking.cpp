@@ -3,11 +3,32 @@
 #include <utils/utils.h>
 
 #include <algorithm>
+#include <unordered_map>
 
 namespace pose
 {
+// raster order of the spans
+static bool isSpanBefore(const BitMask::Run& span, const BitMask::Run& other)
+{
+    return span.row < other.row || (span.row == other.row && span.begin < other.begin);
+}
+
+// removes the object from the cluster it has been assigned to
+static void leaveCluster(const std::shared_ptr<TrackingObject>& object)
+{
+    if (!object->assignedCluster)
+        return;
+
+    std::vector<std::shared_ptr<TrackingObject>>& objects = object->assignedCluster->clusterObjects;
+    objects.erase(std::remove(objects.begin(), objects.end(), object), objects.end());
+    object->assignedCluster.reset();
+}
+
 Tracking::Tracking()
-    : Module("Tracking")
+    : Module("Tracking"),
+      m_isColoredLabelMapValid(false),
+      m_temporalComponentLabels(false),
+      m_objectTracking(false)
 {
     setSearchRadius(0.1f);
     m_minBoundingBoxOverlap = 0.5f;
@@ -22,6 +43,22 @@ void Tracking::setSearchRadius(float radius)
     m_searchRadius = radius;
 }
 
+void Tracking::setTemporalComponentLabels(bool enabled)
+{
+    m_temporalComponentLabels = enabled;
+}
+
+void Tracking::setObjectTracking(bool enabled)
+{
+    if (enabled == m_objectTracking)
+        return;
+
+    // the single cluster and the tracked clusters do not continue each other
+    m_objectTracking = enabled;
+    m_trackingObjects.clear();
+    m_trackingClusters.clear();
+}
+
 const std::vector<std::shared_ptr<TrackingCluster>>& Tracking::getClusters() const
 {
     return m_trackingClusters;
@@ -34,7 +71,10 @@ const cv::Mat& Tracking::getLabelMap() const
 
 cv::Mat Tracking::getColoredLabelMap()
 {
-    Utils::getColoredLabelMap(m_labelMap, m_coloredLabelMap);
+    if (!m_isColoredLabelMapValid) {
+        Utils::getColoredLabelMap(m_labelMap, m_coloredLabelMap);
+        m_isColoredLabelMapValid = true;
+    }
     return m_coloredLabelMap;
 }
 
@@ -47,45 +87,68 @@ void Tracking::process(const cv::Mat& foreground,
 
     UNUSED(projectionMatrix);
 
+    UNUSED(labelMap);
+
     // create a new label map
     if (foreground.cols != m_labelMap.cols || foreground.rows != m_labelMap.rows) {
         m_labelMap = cv::Mat(foreground.rows, foreground.cols, CV_32S);
+        m_labelMap.setTo(0);
+        m_labelledSpans.clear();
     }
-    m_labelMap.setTo(0);
-
-    /*createAssignments(components);
-    //cluster();
-    cluster2();
-    //resolveSplits();
-    deleteLostObjects();
-    createLabelMap(labelMap);*/
-
-    if (m_trackingClusters.empty()) {
-        std::shared_ptr<TrackingCluster> cluster(new TrackingCluster());
-        cluster->id = 1;
-        cluster->frames = 1;
-        m_trackingClusters.push_back(cluster);
+    clearLabelMap();
+    m_isColoredLabelMapValid = false;
+
+    if (m_objectTracking) {
+        createAssignments(components);
+        cluster();
+        //resolveSplits();
+        deleteLostObjects();
+        createLabelMap();
     }
+    else {
+        if (m_trackingClusters.empty()) {
+            std::shared_ptr<TrackingCluster> cluster(new TrackingCluster());
+            cluster->id = 1;
+            cluster->frames = 1;
+            m_trackingClusters.push_back(cluster);
+        }
 
-    for (int i = 0; i < foreground.rows; i++) {
-        for (int j = 0; j < foreground.cols; j++) {
-            if (foreground.ptr<float>(i)[j] > 0)
-                m_labelMap.ptr<unsigned int>(i)[j] = 1;
+        // all components belong to the single cluster, only their spans are written
+        const std::shared_ptr<TrackingCluster>& cluster = m_trackingClusters[0];
+        cluster->spans.clear();
+        for (const std::shared_ptr<ConnectedComponent>& component : components)
+            cluster->spans.insert(cluster->spans.end(), component->spans.begin(), component->spans.end());
+
+        std::sort(cluster->spans.begin(), cluster->spans.end(), isSpanBefore);
+
+        for (const BitMask::Run& span : cluster->spans) {
+            unsigned int* labelRow = m_labelMap.ptr<unsigned int>(span.row);
+            std::fill(labelRow + span.begin, labelRow + span.end, cluster->id);
         }
+        m_labelledSpans = cluster->spans;
     }
 
     end();
 }
 
+void Tracking::clearLabelMap()
+{
+    // only the pixels that have been labelled in the last frame are cleared
+    for (const BitMask::Run& span : m_labelledSpans) {
+        unsigned int* labelRow = m_labelMap.ptr<unsigned int>(span.row);
+        std::fill(labelRow + span.begin, labelRow + span.end, 0);
+    }
+    m_labelledSpans.clear();
+}
+
 void Tracking::createAssignments(const std::vector<std::shared_ptr<ConnectedComponent>>& components)
 {
-    // This is a very simple but fast tracking algorithm. It is not optimal, since an optimal solution can only
-    // be retrieved by solving the assignment problem. However, it seems to be feasible in most ways. Assigning
-    // newly detected components to tracked objects works by means of a bounding box overlapping criterion and
-    // tracking movement is done by comparing the distances of bounding box planes, i.e. the six adjacent planes
-    // that define the bounding box. This guarantees that a still standing person that is temporally overlapped
-    // by another person can still be tracked, since one of the bounding box planes will not move while the other
-    // will adapt to the overlapping object.
+    // Assigning newly detected components to tracked objects works by comparing the distances of bounding box
+    // planes, i.e. the six adjacent planes that define the bounding box. This guarantees that a still standing
+    // person that is temporally overlapped by another person can still be tracked, since one of the bounding box
+    // planes will not move while the other will adapt to the overlapping object. The components are assigned by
+    // solving the assignment problem, i.e. with the smallest total distance, so the result does not depend on the
+    // order of the objects.
 
     // see https://github.com/WeatherGod/MHT
     // http://www.polymtl.ca/litiv/doc/TorabiBilodeauCRV2009.pdf    (mht blob tracking)
@@ -93,53 +156,76 @@ void Tracking::createAssignments(const std::vector<std::shared_ptr<ConnectedComp
 
     std::vector<bool> assignedComponents(components.size());
     assignedComponents.assign(assignedComponents.size(), false);
+    std::vector<bool> assignedObjects(m_trackingObjects.size(), false);
 
-    // try to find correspondences for already tracked objects
-    for (size_t i = 0; i < m_trackingObjects.size(); i++) {
-        std::shared_ptr<TrackingObject>& object = m_trackingObjects[i];
-        const std::shared_ptr<ConnectedComponent>& objectComponent = object->currentComponent;
+    // components that kept their label belong to the object of the last component with that label
+    if (m_temporalComponentLabels) {
+        for (size_t i = 0; i < m_trackingObjects.size(); i++) {
+            std::shared_ptr<TrackingObject>& object = m_trackingObjects[i];
 
-        // will store the selected nearest component
-        float minAnchorDist = std::numeric_limits<float>::infinity();
-        std::shared_ptr<ConnectedComponent> nearestComponent;
-        int nearestComponentIndex = -1;
+            for (size_t j = 0; j < components.size(); j++) {
+                if (assignedComponents[j] || components[j]->id != object->currentComponent->id)
+                    continue;
 
-        // go through all detected objects and try to find find one that matches
-        for (size_t j = 0; j < components.size(); j++) {
-            const std::shared_ptr<ConnectedComponent>& component = components[j];
+                object->frames++;
+                object->state = TrackingObject::TS_ACTIVE;
+                object->previousComponent = object->currentComponent;
+                object->currentComponent = components[j];
+                assignedComponents[j] = true;
+                assignedObjects[i] = true;
+                break;
+            }
+        }
+    }
 
-            // skip components that have already been assigned
-            if (assignedComponents[j] == true)
-                continue;
+    // only pairs of objects and components that are close enough can be assigned, leaving an object
+    // without a component costs as much as the search radius
+    m_assignment.reset(m_trackingObjects.size(), components.size());
+    m_assignment.setUnassignedCost(m_searchRadius);
 
-            // compute the overlap factor between new component and existing tracking object
-            //float overlapFactor1 = objectComponent->boundingBox2d.getOverlapFactor(component->boundingBox2d);
-            //float overlapFactor2 = component->boundingBox2d.getOverlapFactor(objectComponent->boundingBox2d);
+    // the candidates of each object are looked up in a grid over the components instead of
+    // comparing all pairs
+    std::vector<BoundingBox3D> componentBoxes(components.size());
+    for (size_t j = 0; j < components.size(); j++)
+        componentBoxes[j] = components[j]->boundingBox3d;
+    m_componentGrid.build(componentBoxes, m_searchRadius);
 
-            //if ((overlapFactor1 > m_minBoundingBoxOverlap || overlapFactor2 > m_minBoundingBoxOverlap)) {
-            if (true) {
-                // bounding boxes overlap at least the minimum value and they are similar in size
+    for (size_t i = 0; i < m_trackingObjects.size(); i++) {
+        if (assignedObjects[i])
+            continue;
 
-                float distance = Utils::distance(objectComponent->boundingBox3d, component->boundingBox3d, m_searchRadius);
+        const BoundingBox3D& objectBox = m_trackingObjects[i]->currentComponent->boundingBox3d;
+        m_componentGrid.query(objectBox, m_candidates);
 
-                if (distance < minAnchorDist && distance < m_searchRadius) {
-                    minAnchorDist = distance;
-                    nearestComponent = component;
-                    nearestComponentIndex = j;
-                }
-            }
+        for (int j : m_candidates) {
+            if (assignedComponents[j])
+                continue;
+
+            const float distance = Utils::distance(objectBox, components[j]->boundingBox3d, m_searchRadius);
+            if (distance < m_searchRadius)
+                m_assignment.add(i, j, distance);
         }
+    }
+
+    m_assignment.solve();
+
+    for (size_t i = 0; i < m_trackingObjects.size(); i++) {
+        if (assignedObjects[i])
+            continue;
+
+        std::shared_ptr<TrackingObject>& object = m_trackingObjects[i];
+        const int componentIndex = m_assignment.getColumn(i);
 
-        if (nearestComponent) {
-            // a nearest component has been found for this tracking object
+        if (componentIndex >= 0) {
+            // a nearby component has been assigned to this tracking object
             object->frames++;
             object->state = TrackingObject::TS_ACTIVE;
             object->previousComponent = object->currentComponent;
-            object->currentComponent = nearestComponent;
-            assignedComponents[nearestComponentIndex] = true;
+            object->currentComponent = components[componentIndex];
+            assignedComponents[componentIndex] = true;
         }
         else {
-            // no nearest object has been found, this object should be removed later
+            // no nearby component has been found, this object should be removed later
             object->state = TrackingObject::TS_LOST;
         }
     }
@@ -162,181 +248,77 @@ void Tracking::createAssignments(const std::vector<std::shared_ptr<ConnectedComp
 
 void Tracking::cluster()
 {
-    // find the biggest object
-    // find smaller objects that have some overlap
-    // assign all objects into the same cluster
+    // the objects whose components touch each other form a cluster, e.g. the body parts of a user
+    // that are split by depth discontinuities, starting with the biggest objects
 
     // only cluster objects that are either new and don't belong to any cluster,
     // or that belong to the same cluster
 
-    std::vector<unsigned int> assignedObjects;
-    assignedObjects.reserve(m_trackingObjects.size());
-    do {
-        // find biggest object
-        std::shared_ptr<TrackingObject> biggestObject;
-        for (size_t i = 0; i < m_trackingObjects.size(); i++) {
-            std::shared_ptr<TrackingObject>& object = m_trackingObjects[i];
-
-            bool hasBeenAssigned = std::find(assignedObjects.begin(), assignedObjects.end(), object->id) != assignedObjects.end();
-            if (!hasBeenAssigned) {
-                if (!biggestObject || object->currentComponent->area > biggestObject->currentComponent->area)
-                    biggestObject = object;
-            }
-        }
-
-        if (biggestObject) {
-            // find or create the associated cluster
-            std::shared_ptr<TrackingCluster> cluster;
-            if (biggestObject->assignedCluster) {
-                cluster = biggestObject->assignedCluster;
-                cluster->frames++;
-            }
-            else {
-                cluster = std::shared_ptr<TrackingCluster>(new TrackingCluster());
-                cluster->id = getNextFreeId(m_trackingClusters);
-                cluster->frames = 1;
-                cluster->clusterObjects.push_back(biggestObject);
-                biggestObject->assignedCluster = cluster;
-                m_trackingClusters.push_back(cluster);
-            }
-
-            // find smaller objects and merge them into the same cluster
-            for (size_t i = 0; i < m_trackingObjects.size(); i++) {
-                std::shared_ptr<TrackingObject>& object = m_trackingObjects[i];
-
-                bool hasBeenAssigned = std::find(assignedObjects.begin(), assignedObjects.end(), object->id) != assignedObjects.end();
-                if (object == biggestObject || hasBeenAssigned)
-                    continue;
-
-                // object can only be assigned if has either not been assigned before or if the cluster id is the same
-                //bool objectCanBeAssigned = !object->assignedCluster || object->assignedCluster->id == cluster->id;
-
-                // compute overlap and assign to cluster
-                float factor = 0;
-                //float overlapFactor = biggestObject->currentComponent->boundingBox2d.getOverlapFactor(object->currentComponent->boundingBox2d);
-                float overlapFactor = object->currentComponent->boundingBox2d.getOverlapFactor(biggestObject->currentComponent->boundingBox2d);
-                if (overlapFactor > factor) {
-                    bool isContained = std::find(cluster->clusterObjects.begin(), cluster->clusterObjects.end(), object) != cluster->clusterObjects.end();
-
-                    if (!isContained) {
-                        cluster->clusterObjects.push_back(object);
-                        object->assignedCluster = cluster;
-                    }
-                }
-                /*else
-                    object->assignedCluster.reset();*/
-            }
-
-            for (size_t i = 0; i < cluster->clusterObjects.size(); i++)
-                assignedObjects.push_back(cluster->clusterObjects[i]->id);
-        }
-    } while (assignedObjects.size() < m_trackingObjects.size());
-}
-
-void Tracking::cluster2()
-{
-    // release previous cluster assignments if bounding boxes do not overlap anymore
+    // lost objects still refer to a component of an earlier frame, they are deleted afterwards
+    std::unordered_map<unsigned int, size_t> objectIndices;
+    std::vector<size_t> order;
+    order.reserve(m_trackingObjects.size());
     for (size_t i = 0; i < m_trackingObjects.size(); i++) {
-        std::shared_ptr<TrackingObject>& object1 = m_trackingObjects[i];
-
-        for (size_t j = 0; j < m_trackingObjects.size(); j++) {
-            std::shared_ptr<TrackingObject>& object2 = m_trackingObjects[j];
-
-            if (object1 == object2 || object1->assignedCluster != object2->assignedCluster)
-                continue;
+        if (m_trackingObjects[i]->state == TrackingObject::TS_LOST)
+            continue;
 
-            // mark the compared object as not tracked
-            if (!object1->currentComponent->boundingBox2d.overlapsWith(object2->currentComponent->boundingBox2d)) {
-                object2->assignedCluster.reset();
-            }
-        }
+        objectIndices[m_trackingObjects[i]->currentComponent->id] = i;
+        order.push_back(i);
     }
 
-    // remove objects from clusters that are not tracked anymore
-    for (size_t i = 0; i < m_trackingClusters.size(); i++) {
-        std::shared_ptr<TrackingCluster>& cluster = m_trackingClusters[i];
+    std::stable_sort(order.begin(), order.end(), [this](size_t i, size_t j) {
+        return m_trackingObjects[i]->currentComponent->area > m_trackingObjects[j]->currentComponent->area;
+    });
 
-        for (auto it = cluster->clusterObjects.begin(); it != cluster->clusterObjects.end();) {
-            const std::shared_ptr<TrackingObject>& object = *it;
-            if (!object->assignedCluster)
-                it = cluster->clusterObjects.erase(it);
-            else
-                it++;
-        }
-    }
+    std::vector<bool> assignedObjects(m_trackingObjects.size(), false);
+    std::vector<size_t> pendingObjects;
+    std::vector<std::shared_ptr<TrackingCluster>> continuedClusters;
 
-    // create new cluster assignments for overlapping bounding boxes
-    for (size_t i = 0; i < m_trackingObjects.size(); i++) {
-        std::shared_ptr<TrackingObject>& object1 = m_trackingObjects[i];
+    for (size_t biggestIndex : order) {
+        if (assignedObjects[biggestIndex])
+            continue;
 
-        /*std::shared_ptr<TrackingCluster> cluster;
-        if (!object1->assignedCluster) {
+        // find or create the associated cluster, the objects of a cluster that no longer touch the
+        // objects that continued it form a new cluster
+        std::shared_ptr<TrackingObject>& biggestObject = m_trackingObjects[biggestIndex];
+        std::shared_ptr<TrackingCluster> cluster = biggestObject->assignedCluster;
+        if (cluster && std::find(continuedClusters.begin(), continuedClusters.end(), cluster) == continuedClusters.end()) {
+            cluster->frames++;
+        }
+        else {
+            leaveCluster(biggestObject);
             cluster = std::shared_ptr<TrackingCluster>(new TrackingCluster());
             cluster->id = getNextFreeId(m_trackingClusters);
             cluster->frames = 1;
-            cluster->clusterObjects.push_back(object1);
-            object1->assignedCluster = cluster;
+            cluster->clusterObjects.push_back(biggestObject);
+            biggestObject->assignedCluster = cluster;
             m_trackingClusters.push_back(cluster);
         }
-        else {
-            cluster = object1->assignedCluster;
-            cluster->frames++;
-        }*/
-
-        for (size_t j = 0; j < m_trackingObjects.size(); j++) {
-            std::shared_ptr<TrackingObject>& object2 = m_trackingObjects[j];
-
-            /*if (object1 == object2 || object2->assignedCluster != 0)
-                continue;
-
-            if (object1->currentComponent->boundingBox2d.overlapsWith(object2->currentComponent->boundingBox2d)) {
-                bool isContained = std::find(cluster->clusterObjects.begin(), cluster->clusterObjects.end(), object2) != cluster->clusterObjects.end();
-                if (!isContained)
-                    cluster->clusterObjects.push_back(object2);
-                object2->assignedCluster = cluster;
-            }*/
-
-            if (object1 == object2)// || object2->assignedCluster != 0)
-                continue;
+        continuedClusters.push_back(cluster);
 
-            if (object1->currentComponent->boundingBox2d.overlapsWith(object2->currentComponent->boundingBox2d)) {
-
-                std::shared_ptr<TrackingCluster> cluster;
-                if (object1->assignedCluster) {
-
-                }
-                else if (object2->assignedCluster) {
-
-                }
-                else {
-                    cluster = std::shared_ptr<TrackingCluster>(new TrackingCluster());
-                    cluster->id = getNextFreeId(m_trackingClusters);
-                    cluster->frames = 1;
-                    cluster->clusterObjects.push_back(object1);
-                    cluster->clusterObjects.push_back(object2);
-                    object1->assignedCluster = cluster;
-                    m_trackingClusters.push_back(cluster);
-                }
+        // add all objects that can be reached through touching components
+        assignedObjects[biggestIndex] = true;
+        pendingObjects.push_back(biggestIndex);
 
+        while (!pendingObjects.empty()) {
+            const std::shared_ptr<TrackingObject>& object = m_trackingObjects[pendingObjects.back()];
+            pendingObjects.pop_back();
 
+            for (unsigned int nearbyId : object->currentComponent->nearbyIds) {
+                auto it = objectIndices.find(nearbyId);
+                if (it == objectIndices.end() || assignedObjects[it->second])
+                    continue;
 
-                if (!object1->assignedCluster) {
-                    cluster = std::shared_ptr<TrackingCluster>(new TrackingCluster());
-                    cluster->id = getNextFreeId(m_trackingClusters);
-                    cluster->frames = 1;
-                    cluster->clusterObjects.push_back(object1);
-                    object1->assignedCluster = cluster;
-                    m_trackingClusters.push_back(cluster);
-                }
-                else {
-                    cluster = object1->assignedCluster;
-                    cluster->frames++;
+                const std::shared_ptr<TrackingObject>& nearbyObject = m_trackingObjects[it->second];
+                bool isContained = std::find(cluster->clusterObjects.begin(), cluster->clusterObjects.end(), nearbyObject) != cluster->clusterObjects.end();
+                if (!isContained) {
+                    leaveCluster(nearbyObject);
+                    cluster->clusterObjects.push_back(nearbyObject);
+                    nearbyObject->assignedCluster = cluster;
                 }
 
-                /*bool isContained = std::find(cluster->clusterObjects.begin(), cluster->clusterObjects.end(), object2) != cluster->clusterObjects.end();
-                if (!isContained)
-                    cluster->clusterObjects.push_back(object2);
-                object2->assignedCluster = cluster;*/
+                assignedObjects[it->second] = true;
+                pendingObjects.push_back(it->second);
             }
         }
     }
@@ -422,47 +404,31 @@ void Tracking::deleteLostObjects()
     }
 }
 
-void Tracking::createLabelMap(const cv::Mat& labelMap)
+void Tracking::createLabelMap()
 {
-    cv::Mat temp(labelMap.rows, labelMap.cols, CV_8UC3);
-    temp.setTo(0);
-
-    // create a correctly labelled tracking image
-    for (int i = 0; i < labelMap.cols; i++) {
-        for (int j = 0; j < labelMap.rows; j++) {
-            cv::Point curPoint(i, j);
-            const unsigned int& label = labelMap.at<unsigned int>(curPoint);
-            unsigned int& trackingLabel = m_labelMap.at<unsigned int>(curPoint);
-
-            // find the tracking id for this label
-            for (size_t k = 0; k < m_trackingObjects.size(); k++) {
-                const std::shared_ptr<TrackingObject>& object = m_trackingObjects[k];
-
-                if (object->currentComponent->id == label && object->assignedCluster) {
-                    trackingLabel = object->assignedCluster->id;
-                    //trackingLabel = object->id;
-                    temp.at<cv::Vec3b>(curPoint) = cv::Vec3b(255, 255, 255);
-                    break;
-                }
-            }
+    for (size_t i = 0; i < m_trackingClusters.size(); i++)
+        m_trackingClusters[i]->spans.clear();
+
+    // create a correctly labelled tracking image from the spans of the components of each object
+    for (size_t k = 0; k < m_trackingObjects.size(); k++) {
+        const std::shared_ptr<TrackingObject>& object = m_trackingObjects[k];
+        if (!object->assignedCluster)
+            continue;
+
+        const unsigned int trackingLabel = object->assignedCluster->id;
+        //const unsigned int trackingLabel = object->id;
+        for (const BitMask::Run& span : object->currentComponent->spans) {
+            unsigned int* labelRow = m_labelMap.ptr<unsigned int>(span.row);
+            std::fill(labelRow + span.begin, labelRow + span.end, trackingLabel);
+
+            object->assignedCluster->spans.push_back(span);
+            m_labelledSpans.push_back(span);
         }
     }
 
-    // get nearby components
     for (size_t i = 0; i < m_trackingClusters.size(); i++) {
-        const std::shared_ptr<TrackingCluster>& cluster = m_trackingClusters[i];
-        // draw the cluster box red
-        cv::rectangle(temp, cluster->boundingBox2d.getMinPoint() + cv::Point(-2, -2),
-                      cluster->boundingBox2d.getMaxPoint() + cv::Point(2, 2), cv::Scalar(0, 0, 255));
-
-        // draw each cluster entry green
-        for (size_t j = 0; j < cluster->clusterObjects.size(); j++) {
-            const std::shared_ptr<TrackingObject>& object = cluster->clusterObjects[j];
-            cv::rectangle(temp, object->currentComponent->boundingBox2d.getMinPoint(),
-                          object->currentComponent->boundingBox2d.getMaxPoint(), cv::Scalar(0, 255, 0));
-        }
+        std::vector<BitMask::Run>& spans = m_trackingClusters[i]->spans;
+        std::sort(spans.begin(), spans.end(), isSpanBefore);
     }
-
-    cv::imshow("Temp", temp);
 }
 }
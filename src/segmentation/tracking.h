@@ -7,6 +7,8 @@
 #include <utils/boundingbox2d.h>
 #include <utils/boundingbox3d.h>
 #include <utils/module.h>
+#include <utils/assignment.h>
+#include <utils/spatialgrid.h>
 
 namespace pose
 {
@@ -34,6 +36,7 @@ struct TrackingCluster
     std::vector<std::shared_ptr<TrackingObject>> clusterObjects;
     BoundingBox2D   boundingBox2d;
     BoundingBox3D   boundingBox3d;
+    std::vector<BitMask::Run> spans;    // pixels of the cluster in the label map in raster order
 
     void update() {
         if (clusterObjects.size() == 1) {
@@ -104,6 +107,20 @@ public:
 
     void setSearchRadius(float);
 
+    /**
+     * @brief Tells whether the labels of the components are stable across frames (see
+     * ConnectedComponentLabeling::setTemporalLabels). A component is then assigned to the object
+     * with the same label without searching, only the others are searched by distance.
+     */
+    void setTemporalComponentLabels(bool enabled);
+
+    /**
+     * @brief Tells whether the components are tracked over time and clustered into users. If
+     * disabled (the default), all components belong to a single cluster. Changing it starts the
+     * tracking over.
+     */
+    void setObjectTracking(bool enabled);
+
     const std::vector<std::shared_ptr<TrackingCluster>>& getClusters() const;
     const cv::Mat& getLabelMap() const;
     cv::Mat getColoredLabelMap();
@@ -116,20 +133,27 @@ public:
 private:
     void createAssignments(const std::vector<std::shared_ptr<ConnectedComponent>>& components);
     void cluster();
-    void cluster2();
     void resolveSplits();
     void deleteLostObjects();
-    void createLabelMap(const cv::Mat& labelMap);
+    void createLabelMap();
+    void clearLabelMap();
 
     template <typename T>
     int getNextFreeId(const std::vector<std::shared_ptr<T>>& objects) const;
 
     cv::Mat m_labelMap;
     cv::Mat m_coloredLabelMap;
+    bool m_isColoredLabelMapValid;     // the colored label map is only updated once per label map
+    std::vector<BitMask::Run> m_labelledSpans;
 
     std::vector<std::shared_ptr<TrackingObject>> m_trackingObjects;
     std::vector<std::shared_ptr<TrackingCluster>> m_trackingClusters;
     float m_searchRadius;
+    bool m_temporalComponentLabels;
+    bool m_objectTracking;
+    Assignment m_assignment;
+    SpatialGrid m_componentGrid;
+    std::vector<int> m_candidates;
     float m_minBoundingBoxOverlap;
 };
 
@@ -35,7 +35,7 @@ void Fitting::process(const cv::Mat& foreground,
     create(clusters);
 
     // update each skeleton to fit to its user
-    update(foreground, labelMap, pointCloud, projectionMatrix);
+    update(foreground, clusters, pointCloud, projectionMatrix);
 
     // debug drawing
     draw(foreground, labelMap);
@@ -68,7 +68,8 @@ void Fitting::create(const std::vector<std::shared_ptr<TrackingCluster>>& cluste
     }
 }
 
-void Fitting::update(const cv::Mat& foreground, const cv::Mat& labelMap, const cv::Mat& pointCloud, const cv::Mat& projectionMatrix)
+void Fitting::update(const cv::Mat& foreground, const std::vector<std::shared_ptr<TrackingCluster>>& clusters,
+                     const cv::Mat& pointCloud, const cv::Mat& projectionMatrix)
 {
     // create a buffer that will hold the flann point cloud data
     if (!m_flannData)
@@ -80,6 +81,15 @@ void Fitting::update(const cv::Mat& foreground, const cv::Mat& labelMap, const c
         const std::shared_ptr<Skeleton>& skeleton = it->second;
         unsigned int label = skeleton->getLabel();
 
+        // each skeleton belongs to the cluster with its label (see create)
+        const TrackingCluster* cluster = 0;
+        for (size_t i = 0; i < clusters.size() && !cluster; i++) {
+            if (clusters[i]->id == label)
+                cluster = clusters[i].get();
+        }
+        if (!cluster)
+            continue;
+
         cv::Mat userDepthMap(foreground.rows, foreground.cols, foreground.type());
         cv::Mat userPointCloud(pointCloud.rows, pointCloud.cols, pointCloud.type());
         userDepthMap.setTo(0);
@@ -94,33 +104,30 @@ void Fitting::update(const cv::Mat& foreground, const cv::Mat& labelMap, const c
 
         int flannDataIndex = 0;
 
-        // create an image that contains only pixels for the selected skeleton
-        for (int i = 0; i < foreground.rows; i++) {
-            const unsigned int* labelRow = labelMap.ptr<unsigned int>(i);
-            const float* depthRow = foreground.ptr<float>(i);
-            const cv::Vec3f* pointsRow = pointCloud.ptr<cv::Vec3f>(i);
-            float* userDepthRow = userDepthMap.ptr<float>(i);
-            cv::Vec3f* userPointsRow = userPointCloud.ptr<cv::Vec3f>(i);
-
-            for (int j = 0; j < foreground.cols; j++) {
-                if (labelRow[j] == label) {
-                    const float& depthValue = depthRow[j];
+        // create an image that contains only pixels for the selected skeleton, the spans of the
+        // cluster are exactly its pixels in the label map
+        for (const BitMask::Run& span : cluster->spans) {
+            const float* depthRow = foreground.ptr<float>(span.row);
+            const cv::Vec3f* pointsRow = pointCloud.ptr<cv::Vec3f>(span.row);
+            float* userDepthRow = userDepthMap.ptr<float>(span.row);
+            cv::Vec3f* userPointsRow = userPointCloud.ptr<cv::Vec3f>(span.row);
+
+            // update flann point cloud data
+            const int length = span.end - span.begin;
+            memcpy(&m_flannData[flannDataIndex * 3], &pointsRow[span.begin][0], sizeof(float) * 3 * length);
+            flannDataIndex += length;
+
+            std::copy(depthRow + span.begin, depthRow + span.end, userDepthRow + span.begin);
+            std::copy(pointsRow + span.begin, pointsRow + span.end, userPointsRow + span.begin);
+
+            if (updatePosition) {
+                // compute moments
+                for (int j = span.begin; j < span.end; j++) {
                     const cv::Vec3f& pointsValue = pointsRow[j];
-
-                    // update flann point cloud data
-                    memcpy(&m_flannData[flannDataIndex * 3], &pointsValue[0], sizeof(float) * 3);
-                    flannDataIndex++;
-
-                    userDepthRow[j] = depthValue;
-                    userPointsRow[j] = pointsValue;
-
-                    if (updatePosition) {
-                        // compute moments
-                        m100 += pointsValue[0];
-                        m010 += pointsValue[1];
-                        m001 += pointsValue[2];
-                        m000 += 1;
-                    }
+                    m100 += pointsValue[0];
+                    m010 += pointsValue[1];
+                    m001 += pointsValue[2];
+                    m000 += 1;
                 }
             }
         }
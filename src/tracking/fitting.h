@@ -32,7 +32,8 @@ public:
 
 private:
     void create(const std::vector<std::shared_ptr<TrackingCluster>>& clusters);
-    void update(const cv::Mat& foreground, const cv::Mat& labelMap, const cv::Mat& pointCloud, const cv::Mat& projectionMatrix);
+    void update(const cv::Mat& foreground, const std::vector<std::shared_ptr<TrackingCluster>>& clusters,
+                const cv::Mat& pointCloud, const cv::Mat& projectionMatrix);
     void draw(const cv::Mat& foreground, const cv::Mat& pointCloud);
     void drawJoint(const std::shared_ptr<Joint>& joint, cv::Mat& dispImg);
 
@@ -0,0 +1,211 @@
+#include "assignment.h"
+#include <utils/exception.h>
+#include <algorithm>
+#include <limits>
+
+namespace pose
+{
+Assignment::Assignment()
+    : m_numRows(0),
+      m_numColumns(0),
+      m_unassignedCost(1)
+{
+}
+
+void Assignment::reset(int numRows, int numColumns)
+{
+    m_numRows = numRows;
+    m_numColumns = numColumns;
+    m_pairs.clear();
+    m_rowColumns.assign(numRows, -1);
+    m_columnRows.assign(numColumns, -1);
+}
+
+void Assignment::setUnassignedCost(float cost)
+{
+    m_unassignedCost = cost;
+}
+
+void Assignment::add(int row, int column, float cost)
+{
+    if (row < 0 || row >= m_numRows || column < 0 || column >= m_numColumns)
+        throw Exception("assignment pair out of range");
+
+    Pair pair = { row, column, cost };
+    m_pairs.push_back(pair);
+}
+
+int Assignment::getColumn(int row) const
+{
+    return m_rowColumns[row];
+}
+
+int Assignment::getRow(int column) const
+{
+    return m_columnRows[column];
+}
+
+void Assignment::solve()
+{
+    m_rowColumns.assign(m_numRows, -1);
+    m_columnRows.assign(m_numColumns, -1);
+
+    // sort the pairs by their rows and by their columns
+    m_rowOffsets.assign(m_numRows + 1, 0);
+    m_columnOffsets.assign(m_numColumns + 1, 0);
+    for (const Pair& pair : m_pairs) {
+        m_rowOffsets[pair.row + 1]++;
+        m_columnOffsets[pair.column + 1]++;
+    }
+    for (int i = 0; i < m_numRows; i++)
+        m_rowOffsets[i + 1] += m_rowOffsets[i];
+    for (int j = 0; j < m_numColumns; j++)
+        m_columnOffsets[j + 1] += m_columnOffsets[j];
+
+    m_rowPairs.resize(m_pairs.size());
+    m_columnPairs.resize(m_pairs.size());
+    std::vector<int> nextRowPairs(m_rowOffsets.begin(), m_rowOffsets.end() - 1);
+    std::vector<int> nextColumnPairs(m_columnOffsets.begin(), m_columnOffsets.end() - 1);
+    for (size_t k = 0; k < m_pairs.size(); k++) {
+        m_rowPairs[nextRowPairs[m_pairs[k].row]++] = k;
+        m_columnPairs[nextColumnPairs[m_pairs[k].column]++] = k;
+    }
+
+    // collect the rows and columns that are connected through pairs, starting at each row that has
+    // not been reached yet
+    m_localIndices.assign(m_numRows + m_numColumns, -1);
+
+    for (int startRow = 0; startRow < m_numRows; startRow++) {
+        if (m_localIndices[startRow] >= 0 || m_rowOffsets[startRow] == m_rowOffsets[startRow + 1])
+            continue;
+
+        m_subRows.assign(1, startRow);
+        m_subColumns.clear();
+        m_localIndices[startRow] = 0;
+
+        // the rows and columns found so far are the queue
+        size_t nextRow = 0;
+        size_t nextColumn = 0;
+        while (nextRow < m_subRows.size() || nextColumn < m_subColumns.size()) {
+            if (nextRow < m_subRows.size()) {
+                const int row = m_subRows[nextRow++];
+                for (int k = m_rowOffsets[row]; k < m_rowOffsets[row + 1]; k++) {
+                    const int column = m_pairs[m_rowPairs[k]].column;
+                    if (m_localIndices[m_numRows + column] < 0) {
+                        m_localIndices[m_numRows + column] = m_subColumns.size();
+                        m_subColumns.push_back(column);
+                    }
+                }
+            }
+            else {
+                const int column = m_subColumns[nextColumn++];
+                for (int k = m_columnOffsets[column]; k < m_columnOffsets[column + 1]; k++) {
+                    const int row = m_pairs[m_columnPairs[k]].row;
+                    if (m_localIndices[row] < 0) {
+                        m_localIndices[row] = m_subRows.size();
+                        m_subRows.push_back(row);
+                    }
+                }
+            }
+        }
+
+        // a single pair does not need to be solved
+        if (m_subRows.size() == 1 && m_subColumns.size() == 1) {
+            if (m_pairs[m_rowPairs[m_rowOffsets[startRow]]].cost < m_unassignedCost) {
+                m_rowColumns[startRow] = m_subColumns[0];
+                m_columnRows[m_subColumns[0]] = startRow;
+            }
+            continue;
+        }
+
+        // the subproblem is made square, leaving a row or column unassigned costs 0 and each pair
+        // saves what it costs less than an unassigned row
+        const int size = std::max(m_subRows.size(), m_subColumns.size());
+        m_costs.assign(size * size, 0.0f);
+        for (int row : m_subRows) {
+            for (int k = m_rowOffsets[row]; k < m_rowOffsets[row + 1]; k++) {
+                const Pair& pair = m_pairs[m_rowPairs[k]];
+                const float cost = pair.cost - m_unassignedCost;
+                if (cost < 0)
+                    m_costs[m_localIndices[row] * size + m_localIndices[m_numRows + pair.column]] = cost;
+            }
+        }
+
+        solveDense(size);
+
+        for (int j = 1; j <= size; j++) {
+            const int localRow = m_matching[j] - 1;
+            const int localColumn = j - 1;
+            if (localRow >= (int)m_subRows.size() || localColumn >= (int)m_subColumns.size())
+                continue;
+            if (!(m_costs[localRow * size + localColumn] < 0))
+                continue;
+
+            const int row = m_subRows[localRow];
+            const int column = m_subColumns[localColumn];
+            m_rowColumns[row] = column;
+            m_columnRows[column] = row;
+        }
+    }
+}
+
+void Assignment::solveDense(int size)
+{
+    // Hungarian method with potentials in O(size^3), each row is added to the matching by
+    // searching the shortest augmenting path in the reduced costs
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    m_rowPotentials.assign(size + 1, 0);
+    m_columnPotentials.assign(size + 1, 0);
+    m_matching.assign(size + 1, 0);
+    m_way.assign(size + 1, 0);
+
+    for (int i = 1; i <= size; i++) {
+        m_matching[0] = i;
+        int column = 0;
+        m_minSlack.assign(size + 1, infinity);
+        m_isUsed.assign(size + 1, 0);
+
+        do {
+            m_isUsed[column] = 1;
+            const int row = m_matching[column];
+            const float* costRow = &m_costs[(row - 1) * size];
+            double delta = infinity;
+            int nextColumn = 0;
+
+            for (int j = 1; j <= size; j++) {
+                if (m_isUsed[j])
+                    continue;
+
+                const double slack = costRow[j - 1] - m_rowPotentials[row] - m_columnPotentials[j];
+                if (slack < m_minSlack[j]) {
+                    m_minSlack[j] = slack;
+                    m_way[j] = column;
+                }
+                if (m_minSlack[j] < delta) {
+                    delta = m_minSlack[j];
+                    nextColumn = j;
+                }
+            }
+
+            for (int j = 0; j <= size; j++) {
+                if (m_isUsed[j]) {
+                    m_rowPotentials[m_matching[j]] += delta;
+                    m_columnPotentials[j] -= delta;
+                }
+                else
+                    m_minSlack[j] -= delta;
+            }
+
+            column = nextColumn;
+        } while (m_matching[column] != 0);
+
+        // flip the augmenting path
+        do {
+            const int previousColumn = m_way[column];
+            m_matching[column] = m_matching[previousColumn];
+            column = previousColumn;
+        } while (column != 0);
+    }
+}
+}
@@ -0,0 +1,93 @@
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <vector>
+
+namespace pose
+{
+/**
+ * @brief Optimal assignment of rows to columns (e.g. tracked objects to detections) on a sparse
+ * cost matrix. Only the pairs that have been added can be assigned, each row and each column at
+ * most once. A row that stays unassigned costs the unassigned cost, so a pair is only assigned
+ * if its cost is lower. The total cost is minimized.
+ *
+ * The pairs are split into independent subproblems (connected components of the bipartite graph
+ * of the pairs), each of which is solved with the Hungarian method on a dense matrix of its own
+ * rows and columns. With gated pairs these are small even if there are many rows and columns.
+ */
+class Assignment
+{
+public:
+    Assignment();
+
+    /**
+     * @brief Removes all pairs and sets the size of the problem.
+     */
+    void reset(int numRows, int numColumns);
+
+    /**
+     * @brief Sets the cost of a row that is not assigned to any column. Pairs that cost at least
+     * as much are never assigned.
+     */
+    void setUnassignedCost(float cost);
+
+    /**
+     * @brief Adds a pair that can be assigned, each pair may only be added once.
+     */
+    void add(int row, int column, float cost);
+
+    /**
+     * @brief Computes the assignment, see getColumn and getRow.
+     */
+    void solve();
+
+    /**
+     * @brief The column that is assigned to the row, or -1.
+     */
+    int getColumn(int row) const;
+
+    /**
+     * @brief The row that is assigned to the column, or -1.
+     */
+    int getRow(int column) const;
+
+private:
+    struct Pair
+    {
+        int row;
+        int column;
+        float cost;
+    };
+
+    void solveDense(int size);
+
+    int m_numRows;
+    int m_numColumns;
+    float m_unassignedCost;
+    std::vector<Pair> m_pairs;
+    std::vector<int> m_rowColumns;
+    std::vector<int> m_columnRows;
+
+    // pairs of each row and each column (indices into m_pairs)
+    std::vector<int> m_rowOffsets;
+    std::vector<int> m_rowPairs;
+    std::vector<int> m_columnOffsets;
+    std::vector<int> m_columnPairs;
+
+    // the current subproblem, its rows and columns and the dense matrix of (cost - unassigned cost)
+    std::vector<int> m_subRows;
+    std::vector<int> m_subColumns;
+    std::vector<int> m_localIndices;    // of the rows followed by the columns in the subproblem
+    std::vector<float> m_costs;
+
+    // potentials and the matching of the Hungarian method, all 1-based with 0 as the virtual row
+    std::vector<double> m_rowPotentials;
+    std::vector<double> m_columnPotentials;
+    std::vector<int> m_matching;
+    std::vector<int> m_way;
+    std::vector<double> m_minSlack;
+    std::vector<char> m_isUsed;
+};
+}
+
+#endif // ASSIGNMENT_H
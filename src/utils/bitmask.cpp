@@ -0,0 +1,371 @@
+#include "bitmask.h"
+#include <utils/exception.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace pose
+{
+static inline int countTrailingZeros(uint64_t word)
+{
+#if defined(_MSC_VER) && defined(_M_IX86)
+    // there is no 64 bit scan on 32 bit x86, the word is not 0
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)word))
+        return (int)index;
+    _BitScanForward(&index, (unsigned long)(word >> 32));
+    return (int)index + 32;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+BitMask::BitMask()
+    : m_rows(0),
+      m_cols(0),
+      m_wordsPerRow(0)
+{
+}
+
+BitMask::BitMask(int rows, int cols)
+{
+    create(rows, cols);
+}
+
+void BitMask::create(int rows, int cols)
+{
+    m_rows = rows;
+    m_cols = cols;
+    m_wordsPerRow = (cols + 63) / 64;
+    m_data.assign(m_rows * m_wordsPerRow, 0);
+}
+
+int BitMask::rows() const
+{
+    return m_rows;
+}
+
+int BitMask::cols() const
+{
+    return m_cols;
+}
+
+int BitMask::wordsPerRow() const
+{
+    return m_wordsPerRow;
+}
+
+uint64_t* BitMask::row(int i)
+{
+    return &m_data[i * m_wordsPerRow];
+}
+
+const uint64_t* BitMask::row(int i) const
+{
+    return &m_data[i * m_wordsPerRow];
+}
+
+bool BitMask::get(int i, int j) const
+{
+    return (row(i)[j >> 6] >> (j & 63)) & 1;
+}
+
+void BitMask::set(int i, int j, bool value)
+{
+    uint64_t& word = row(i)[j >> 6];
+    const uint64_t bit = uint64_t(1) << (j & 63);
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+void BitMask::setTo(bool value)
+{
+    if (!value) {
+        std::fill(m_data.begin(), m_data.end(), 0);
+        return;
+    }
+
+    // keep the bits after the last column cleared
+    const uint64_t lastMask = (m_cols & 63) ? (uint64_t(1) << (m_cols & 63)) - 1 : ~uint64_t(0);
+    for (int i = 0; i < m_rows; i++) {
+        uint64_t* rowData = row(i);
+        std::fill(rowData, rowData + m_wordsPerRow, ~uint64_t(0));
+        rowData[m_wordsPerRow - 1] = lastMask;
+    }
+}
+
+void BitMask::fromMat(const cv::Mat& mask, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        const uchar* maskRow = mask.ptr<uchar>(i);
+        uint64_t* rowData = row(i);
+
+        for (int w = 0; w < m_wordsPerRow; w++) {
+            const int start = w * 64;
+            const int count = std::min(64, m_cols - start);
+
+            uint64_t word = 0;
+            for (int b = 0; b < count; b++)
+                word |= uint64_t(maskRow[start + b] != 0) << b;
+            rowData[w] = word;
+        }
+    }
+}
+
+void BitMask::fromMat(const cv::Mat& mask)
+{
+    if (mask.rows != m_rows || mask.cols != m_cols)
+        create(mask.rows, mask.cols);
+
+    fromMat(mask, 0, m_rows);
+}
+
+void BitMask::toMat(cv::Mat& mask, int begin, int end) const
+{
+    for (int i = begin; i < end; i++) {
+        uchar* maskRow = mask.ptr<uchar>(i);
+        const uint64_t* rowData = row(i);
+
+        for (int w = 0; w < m_wordsPerRow; w++) {
+            const int start = w * 64;
+            const int count = std::min(64, m_cols - start);
+            const uint64_t word = rowData[w];
+
+            for (int b = 0; b < count; b++)
+                maskRow[start + b] = (uchar)(0 - (int)((word >> b) & 1));
+        }
+    }
+}
+
+void BitMask::toMat(cv::Mat& mask) const
+{
+    toMat(mask, 0, m_rows);
+}
+
+void BitMask::getRuns(int begin, int end, std::vector<Run>& runs) const
+{
+    Run run;
+    for (int i = begin; i < end; i++) {
+        const uint64_t* rowData = row(i);
+        run.row = i;
+
+        // find the transitions inside of each word, a run can continue in the next word
+        bool isInRun = false;
+        for (int w = 0; w < m_wordsPerRow; w++) {
+            const uint64_t word = rowData[w];
+            int bit = 0;
+
+            while (bit < 64) {
+                const uint64_t rest = (isInRun ? ~word : word) >> bit;
+                if (!rest)
+                    break;
+
+                bit += countTrailingZeros(rest);
+                if (isInRun) {
+                    run.end = w * 64 + bit;
+                    runs.push_back(run);
+                }
+                else {
+                    run.begin = w * 64 + bit;
+                }
+                isInRun = !isInRun;
+            }
+        }
+
+        if (isInRun) {
+            run.end = m_cols;
+            runs.push_back(run);
+        }
+    }
+}
+
+static inline int findRoot(std::vector<int>& parents, int index)
+{
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+int BitMask::labelRuns(const std::vector<Run>& runs, std::vector<int>& labels, std::vector<int>& areas)
+{
+    const int numRuns = runs.size();
+    std::vector<int> parents(numRuns);
+
+    // the runs of the previous row are [previousBegin, previousEnd)
+    int previousBegin = 0;
+    int previousEnd = 0;
+    int currentBegin = 0;
+    int overlap = 0;
+
+    for (int k = 0; k < numRuns; k++) {
+        const Run& run = runs[k];
+        parents[k] = k;
+
+        if (k == 0 || run.row != runs[k - 1].row) {
+            const bool isNextRow = k > 0 && run.row == runs[k - 1].row + 1;
+            previousBegin = isNextRow ? currentBegin : k;
+            previousEnd = k;
+            currentBegin = k;
+            overlap = previousBegin;
+        }
+
+        // skip the runs of the previous row that end before this one starts (including the diagonal
+        // neighbor), then merge with all runs that start before this one ends
+        while (overlap < previousEnd && runs[overlap].end < run.begin)
+            overlap++;
+
+        for (int other = overlap; other < previousEnd && runs[other].begin <= run.end; other++) {
+            // the smaller index becomes the root, so the first run of a component is its root
+            const int root = findRoot(parents, k);
+            const int otherRoot = findRoot(parents, other);
+            if (root < otherRoot)
+                parents[otherRoot] = root;
+            else
+                parents[root] = otherRoot;
+        }
+    }
+
+    // number the components in the order of their first run, which is always the root
+    labels.resize(numRuns);
+    areas.clear();
+    for (int k = 0; k < numRuns; k++) {
+        const int root = findRoot(parents, k);
+        if (root == k) {
+            labels[k] = areas.size();
+            areas.push_back(0);
+        }
+        else {
+            labels[k] = labels[root];
+        }
+
+        areas[labels[k]] += runs[k].end - runs[k].begin;
+    }
+
+    return areas.size();
+}
+
+void BitMask::erode(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end)
+{
+    morphology(src, dst, element, begin, end, true);
+}
+
+void BitMask::dilate(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end)
+{
+    morphology(src, dst, element, begin, end, false);
+}
+
+void BitMask::morphology(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end,
+                         bool erode)
+{
+    if (&src == &dst)
+        throw Exception("source and destination of the morphology must not be the same");
+
+    if (dst.m_rows != src.m_rows || dst.m_cols != src.m_cols)
+        throw Exception("source and destination of the morphology must have the same size");
+
+    // the element is decomposed into the horizontal radius of each of its rows, -1 for empty rows
+    const int halo = element.rows / 2;
+    const int center = element.cols / 2;
+    std::vector<int> radii(element.rows, -1);
+    std::vector<int> distinctRadii;
+
+    for (int y = 0; y < element.rows; y++) {
+        const uchar* elementRow = element.ptr<uchar>(y);
+        int first = -1;
+        int last = -1;
+        for (int x = 0; x < element.cols; x++) {
+            if (elementRow[x]) {
+                if (first < 0)
+                    first = x;
+                else if (last != x - 1)
+                    throw Exception("structuring element rows must be contiguous");
+                last = x;
+            }
+        }
+
+        if (first < 0)
+            continue;
+        if (center - first != last - center || last - center >= 64)
+            throw Exception("structuring element rows must be centered");
+
+        radii[y] = last - center;
+        if (std::find(distinctRadii.begin(), distinctRadii.end(), radii[y]) == distinctRadii.end())
+            distinctRadii.push_back(radii[y]);
+    }
+
+    const int words = src.m_wordsPerRow;
+    const uint64_t lastMask = (src.m_cols & 63) ? (uint64_t(1) << (src.m_cols & 63)) - 1 : ~uint64_t(0);
+    const int rowBegin = std::max(0, begin - halo);
+    const int rowEnd = std::min(src.m_rows, end + halo);
+
+    // combine the pixels of each row horizontally once for every radius that is used
+    std::vector<std::vector<uint64_t>> shifted(distinctRadii.size());
+    for (size_t r = 0; r < distinctRadii.size(); r++) {
+        shifted[r].resize((rowEnd - rowBegin) * words);
+        for (int i = rowBegin; i < rowEnd; i++)
+            shiftRow(src.row(i), &shifted[r][(i - rowBegin) * words], words, distinctRadii[r], lastMask, erode);
+    }
+
+    std::vector<const uint64_t*> rowData(element.rows);
+    for (int i = begin; i < end; i++) {
+        // rows outside of the image do not change the result, neither for erosion nor for dilation
+        for (int y = 0; y < element.rows; y++) {
+            const int srcRow = i + y - halo;
+            rowData[y] = NULL;
+            if (radii[y] < 0 || srcRow < 0 || srcRow >= src.m_rows)
+                continue;
+
+            const size_t r = std::find(distinctRadii.begin(), distinctRadii.end(), radii[y]) - distinctRadii.begin();
+            rowData[y] = &shifted[r][(srcRow - rowBegin) * words];
+        }
+
+        // combine the rows vertically
+        uint64_t* dstRow = dst.row(i);
+        for (int w = 0; w < words; w++) {
+            uint64_t word = erode ? ~uint64_t(0) : 0;
+            for (int y = 0; y < element.rows; y++) {
+                if (!rowData[y])
+                    continue;
+                word = erode ? (word & rowData[y][w]) : (word | rowData[y][w]);
+            }
+            dstRow[w] = word;
+        }
+        dstRow[words - 1] &= lastMask;
+    }
+}
+
+void BitMask::shiftRow(const uint64_t* src, uint64_t* dst, int words, int radius, uint64_t lastMask, bool erode)
+{
+    const uint64_t border = erode ? ~uint64_t(0) : 0;
+
+    uint64_t previous = border;
+    uint64_t current = words > 1 ? src[0] : (src[0] & lastMask) | (border & ~lastMask);
+
+    for (int w = 0; w < words; w++) {
+        // the bits after the last column belong to the border
+        uint64_t next = border;
+        if (w + 1 < words - 1)
+            next = src[w + 1];
+        else if (w + 1 == words - 1)
+            next = (src[w + 1] & lastMask) | (border & ~lastMask);
+
+        // combine each pixel with its neighbors at a distance of up to radius pixels
+        uint64_t word = current;
+        for (int s = 1; s <= radius; s++) {
+            const uint64_t right = (current >> s) | (next << (64 - s));
+            const uint64_t left = (current << s) | (previous >> (64 - s));
+            word = erode ? (word & left & right) : (word | left | right);
+        }
+        dst[w] = word;
+
+        previous = current;
+        current = next;
+    }
+}
+}
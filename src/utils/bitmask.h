@@ -0,0 +1,99 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace pose
+{
+/**
+ * @brief Binary mask with one bit per pixel. Each row is stored as an array of 64 bit words, where
+ * the pixel at column j is bit j % 64 of word j / 64. Bits after the last column are always 0.
+ * Morphological operations work on whole words with shifts, ANDs and ORs.
+ *
+ * All functions that take a range [begin, end) only write the rows inside of the range, so that
+ * they can be used to process bands in parallel.
+ */
+class BitMask
+{
+public:
+    /**
+     * @brief A horizontal run of set pixels, i.e. the columns [begin, end) of a row.
+     */
+    struct Run
+    {
+        int row;
+        int begin;
+        int end;
+    };
+
+    BitMask();
+    BitMask(int rows, int cols);
+
+    void create(int rows, int cols);
+
+    int rows() const;
+    int cols() const;
+    int wordsPerRow() const;
+
+    uint64_t* row(int i);
+    const uint64_t* row(int i) const;
+
+    bool get(int i, int j) const;
+    void set(int i, int j, bool value);
+    void setTo(bool value);
+
+    /**
+     * @brief Set the rows [begin, end) from an 8 bit mask, every non-zero pixel is set.
+     */
+    void fromMat(const cv::Mat& mask, int begin, int end);
+    void fromMat(const cv::Mat& mask);
+
+    /**
+     * @brief Write the rows [begin, end) into an 8 bit mask with 255 for every set pixel. The
+     * mask has to be allocated already.
+     */
+    void toMat(cv::Mat& mask, int begin, int end) const;
+    void toMat(cv::Mat& mask) const;
+
+    /**
+     * @brief Append the runs of the rows [begin, end) in raster order.
+     */
+    void getRuns(int begin, int end, std::vector<Run>& runs) const;
+
+    /**
+     * @brief Label runs (in raster order) that are 8-connected with a union-find. Each run gets
+     * the label of its component, the labels are numbered in the order of the first run of each
+     * component. The area of each component in pixels is written to areas. Returns the number of
+     * components.
+     */
+    static int labelRuns(const std::vector<Run>& runs, std::vector<int>& labels, std::vector<int>& areas);
+
+    /**
+     * @brief Erode the rows [begin, end) of src into dst. Pixels outside of the image are treated
+     * as set, like the default border of cv::erode. The structuring element has to be symmetric
+     * and each of its rows has to be a single run around the center column, e.g. an ellipse.
+     */
+    static void erode(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end);
+
+    /**
+     * @brief Dilate the rows [begin, end) of src into dst. Pixels outside of the image are treated
+     * as not set. The structuring element has the same restrictions as for erode.
+     */
+    static void dilate(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end);
+
+private:
+    static void morphology(const BitMask& src, BitMask& dst, const cv::Mat& element, int begin, int end,
+                           bool erode);
+    static void shiftRow(const uint64_t* src, uint64_t* dst, int words, int radius, uint64_t lastMask,
+                         bool erode);
+
+    std::vector<uint64_t> m_data;
+    int m_rows;
+    int m_cols;
+    int m_wordsPerRow;
+};
+}
+
+#endif // BITMASK_H
@@ -0,0 +1,99 @@
+#include "cpufeatures.h"
+#include <algorithm>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace pose
+{
+CpuFeatures::InstructionSet CpuFeatures::m_maxInstructionSet = CpuFeatures::IS_AVX512;
+
+// the kernels of an instruction set are only compiled if the compiler supports it
+#ifdef POSE_SIMD_AVX512
+static const CpuFeatures::InstructionSet compiledInstructionSet = CpuFeatures::IS_AVX512;
+#else
+static const CpuFeatures::InstructionSet compiledInstructionSet = CpuFeatures::IS_AVX2;
+#endif
+
+CpuFeatures::InstructionSet CpuFeatures::getInstructionSet()
+{
+    static const InstructionSet supported = std::min(detect(), compiledInstructionSet);
+    return supported < m_maxInstructionSet ? supported : m_maxInstructionSet;
+}
+
+void CpuFeatures::setMaxInstructionSet(InstructionSet instructionSet)
+{
+    m_maxInstructionSet = instructionSet;
+}
+
+const char* CpuFeatures::getName(InstructionSet instructionSet)
+{
+    switch (instructionSet) {
+    case IS_SCALAR:
+        return "Scalar";
+    case IS_SSE41:
+        return "SSE4.1";
+    case IS_AVX:
+        return "AVX";
+    case IS_AVX2:
+        return "AVX2";
+    case IS_AVX512:
+        return "AVX-512";
+    }
+    return "Unknown";
+}
+
+CpuFeatures::InstructionSet CpuFeatures::detect()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return IS_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return IS_AVX2;
+    if (__builtin_cpu_supports("avx"))
+        return IS_AVX;
+    if (__builtin_cpu_supports("sse4.1"))
+        return IS_SSE41;
+    return IS_SCALAR;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse41 = (info[2] & (1 << 19)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool cpuAvx = (info[2] & (1 << 28)) != 0;
+
+    // check whether the operating system saves the AVX (and AVX-512) registers
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool osAvx = (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+    const bool avx = osAvx && cpuAvx;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+        avx512 = osAvx512 && (info[1] & (1 << 16)) != 0;
+    }
+
+    if (avx512)
+        return IS_AVX512;
+    if (avx2)
+        return IS_AVX2;
+    if (avx)
+        return IS_AVX;
+    if (sse41)
+        return IS_SSE41;
+    return IS_SCALAR;
+#else
+    return IS_SCALAR;
+#endif
+}
+}
@@ -0,0 +1,61 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// POSE_SIMD_X86 is defined if the compiler supports the x86 SIMD intrinsics, POSE_TARGET enables an
+// instruction set for a single function, so that everything else is compiled for the baseline CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSE_SIMD_X86
+#define POSE_TARGET(x) __attribute__((target(x)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define POSE_SIMD_X86
+#define POSE_TARGET(x)
+#endif
+
+// POSE_SIMD_AVX512 is defined if the compiler also has the AVX-512 intrinsics, Visual Studio only
+// has them since 2017 (15.3), without them the instruction set is limited to AVX2 at runtime
+#if defined(POSE_SIMD_X86) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1911))
+#define POSE_SIMD_AVX512
+#endif
+
+namespace pose
+{
+/**
+ * @brief Runtime detection of the SIMD instruction sets that are supported by the CPU. Modules
+ * with hand-written SIMD kernels use this to select the best kernel at runtime.
+ */
+class CpuFeatures
+{
+public:
+    enum InstructionSet {
+        IS_SCALAR = 0,
+        IS_SSE41,
+        IS_AVX,
+        IS_AVX2,
+        IS_AVX512
+    };
+
+    /**
+     * @brief Get the best instruction set that is supported by the CPU, the operating system and
+     * the compiler, limited by the maximum instruction set.
+     */
+    static InstructionSet getInstructionSet();
+
+    /**
+     * @brief Limits the instruction set that is returned by getInstructionSet(), e.g. to compare
+     * the SIMD kernels with the scalar fallback.
+     */
+    static void setMaxInstructionSet(InstructionSet instructionSet);
+
+    static const char* getName(InstructionSet instructionSet);
+
+private:
+    CpuFeatures();
+    ~CpuFeatures();
+
+    static InstructionSet detect();
+
+    static InstructionSet m_maxInstructionSet;
+};
+}
+
+#endif // CPUFEATURES_H
@@ -0,0 +1,23 @@
+#ifndef FRAMEINFO_H
+#define FRAMEINFO_H
+
+namespace pose
+{
+/**
+ * @brief Per-frame meta data that is passed along with the images through all modules.
+ */
+struct FrameInfo
+{
+    FrameInfo()
+        : timestamp(0),
+          sequence(0),
+          arrivalTime(0) {
+    }
+
+    long long       timestamp;      // capture timestamp in microseconds (Timer::getMicroseconds() clock)
+    unsigned int    sequence;       // sequence number assigned by the capture device
+    long long       arrivalTime;    // time at which the frame was handed to the library in microseconds
+};
+}
+
+#endif // FRAMEINFO_H
@@ -0,0 +1,170 @@
+#include "latencytracer.h"
+#include "timer.h"
+#include <algorithm>
+
+namespace pose
+{
+LatencyTracer::LatencyTracer()
+{
+    reset();
+}
+
+LatencyTracer::~LatencyTracer()
+{
+}
+
+void LatencyTracer::reset()
+{
+    m_hasSequence = false;
+    m_lastSequence = 0;
+    m_frames = 0;
+    m_sequenceGaps = 0;
+    m_droppedFrames = 0;
+    m_outOfOrderFrames = 0;
+
+    m_pendingQueueLatency = 0;
+    m_lastQueueLatency = 0;
+    m_sumQueueLatency = 0;
+    m_maxQueueLatency = 0;
+    m_lastProcessingLatency = 0;
+    m_sumProcessingLatency = 0;
+    m_maxProcessingLatency = 0;
+    m_lastTotalLatency = 0;
+    m_sumTotalLatency = 0;
+    m_maxTotalLatency = 0;
+}
+
+void LatencyTracer::beginFrame(FrameInfo& frameInfo)
+{
+    frameInfo.arrivalTime = Timer::getMicroseconds();
+
+    // detect gaps in the sequence numbers (with wrap-around)
+    if (m_hasSequence) {
+        const unsigned int diff = frameInfo.sequence - m_lastSequence;
+
+        if (diff == 0 || diff >= 0x80000000u) {
+            // duplicate or older frame
+            m_outOfOrderFrames++;
+        }
+        else if (diff > 1) {
+            m_sequenceGaps++;
+            m_droppedFrames += diff - 1;
+        }
+    }
+
+    if (!m_hasSequence || frameInfo.sequence - m_lastSequence < 0x80000000u)
+        m_lastSequence = frameInfo.sequence;
+    m_hasSequence = true;
+
+    m_pendingQueueLatency = (frameInfo.arrivalTime - frameInfo.timestamp) / 1000.0f;
+}
+
+void LatencyTracer::endFrame(const FrameInfo& frameInfo)
+{
+    const long long now = Timer::getMicroseconds();
+
+    m_lastQueueLatency = m_pendingQueueLatency;
+    m_lastProcessingLatency = (now - frameInfo.arrivalTime) / 1000.0f;
+    m_lastTotalLatency = (now - frameInfo.timestamp) / 1000.0f;
+
+    m_sumQueueLatency += m_lastQueueLatency;
+    m_sumProcessingLatency += m_lastProcessingLatency;
+    m_sumTotalLatency += m_lastTotalLatency;
+
+    m_maxQueueLatency = std::max(m_maxQueueLatency, m_lastQueueLatency);
+    m_maxProcessingLatency = std::max(m_maxProcessingLatency, m_lastProcessingLatency);
+    m_maxTotalLatency = std::max(m_maxTotalLatency, m_lastTotalLatency);
+
+    m_frames++;
+}
+
+void LatencyTracer::abortFrame()
+{
+    // the sequence number has been seen, only the latencies are dropped
+    m_pendingQueueLatency = 0;
+}
+
+unsigned int LatencyTracer::getFrames() const
+{
+    return m_frames;
+}
+
+unsigned int LatencyTracer::getSequenceGaps() const
+{
+    return m_sequenceGaps;
+}
+
+unsigned int LatencyTracer::getDroppedFrames() const
+{
+    return m_droppedFrames;
+}
+
+unsigned int LatencyTracer::getOutOfOrderFrames() const
+{
+    return m_outOfOrderFrames;
+}
+
+float LatencyTracer::getLastQueueLatency() const
+{
+    return m_lastQueueLatency;
+}
+
+float LatencyTracer::getAvgQueueLatency() const
+{
+    return m_frames > 0 ? (float)(m_sumQueueLatency / m_frames) : 0;
+}
+
+float LatencyTracer::getMaxQueueLatency() const
+{
+    return m_maxQueueLatency;
+}
+
+float LatencyTracer::getLastProcessingLatency() const
+{
+    return m_lastProcessingLatency;
+}
+
+float LatencyTracer::getAvgProcessingLatency() const
+{
+    return m_frames > 0 ? (float)(m_sumProcessingLatency / m_frames) : 0;
+}
+
+float LatencyTracer::getMaxProcessingLatency() const
+{
+    return m_maxProcessingLatency;
+}
+
+float LatencyTracer::getLastTotalLatency() const
+{
+    return m_lastTotalLatency;
+}
+
+float LatencyTracer::getAvgTotalLatency() const
+{
+    return m_frames > 0 ? (float)(m_sumTotalLatency / m_frames) : 0;
+}
+
+float LatencyTracer::getMaxTotalLatency() const
+{
+    return m_maxTotalLatency;
+}
+
+FrameTrace::FrameTrace(LatencyTracer& tracer, FrameInfo& frameInfo)
+    : m_tracer(tracer),
+      m_isEnded(false)
+{
+    m_tracer.beginFrame(frameInfo);
+}
+
+FrameTrace::~FrameTrace()
+{
+    if (!m_isEnded)
+        m_tracer.abortFrame();
+}
+
+void FrameTrace::end(const FrameInfo& frameInfo)
+{
+    m_tracer.endFrame(frameInfo);
+    m_isEnded = true;
+}
+}
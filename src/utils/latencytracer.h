@@ -0,0 +1,93 @@
+#ifndef LATENCYTRACER_H
+#define LATENCYTRACER_H
+
+#include "frameinfo.h"
+
+namespace pose
+{
+/**
+ * @brief Records the end-to-end latency of each frame, split into the queueing latency (capture
+ * until the frame is handed to the library) and the processing latency (until the scene is
+ * available), and detects gaps in the sequence numbers.
+ */
+class LatencyTracer
+{
+public:
+    LatencyTracer();
+    ~LatencyTracer();
+
+    void reset();
+
+    /**
+     * @brief Called when a new frame arrives. Sets the arrival time of the frame and checks
+     * the sequence number for gaps.
+     */
+    void beginFrame(FrameInfo& frameInfo);
+
+    /**
+     * @brief Called when the frame has been processed by all modules.
+     */
+    void endFrame(const FrameInfo& frameInfo);
+
+    /**
+     * @brief Called instead of endFrame if the frame has not been processed, e.g. because the
+     * input is not ready yet. The latencies of the frame are not recorded.
+     */
+    void abortFrame();
+
+    unsigned int getFrames() const;
+    unsigned int getSequenceGaps() const;
+    unsigned int getDroppedFrames() const;
+    unsigned int getOutOfOrderFrames() const;
+
+    // all latencies are given in milliseconds
+    float getLastQueueLatency() const;
+    float getAvgQueueLatency() const;
+    float getMaxQueueLatency() const;
+    float getLastProcessingLatency() const;
+    float getAvgProcessingLatency() const;
+    float getMaxProcessingLatency() const;
+    float getLastTotalLatency() const;
+    float getAvgTotalLatency() const;
+    float getMaxTotalLatency() const;
+
+private:
+    bool            m_hasSequence;
+    unsigned int    m_lastSequence;
+    unsigned int    m_frames;
+    unsigned int    m_sequenceGaps;
+    unsigned int    m_droppedFrames;
+    unsigned int    m_outOfOrderFrames;
+
+    float   m_pendingQueueLatency;     // of the frame that has begun
+    float   m_lastQueueLatency;
+    double  m_sumQueueLatency;
+    float   m_maxQueueLatency;
+    float   m_lastProcessingLatency;
+    double  m_sumProcessingLatency;
+    float   m_maxProcessingLatency;
+    float   m_lastTotalLatency;
+    double  m_sumTotalLatency;
+    float   m_maxTotalLatency;
+};
+
+/**
+ * @brief Begins a frame on the tracer and aborts it when it goes out of scope without having
+ * been ended, so that a frame that is not processed completely (the input is not ready yet or a
+ * module throws) does not stay open.
+ */
+class FrameTrace
+{
+public:
+    FrameTrace(LatencyTracer& tracer, FrameInfo& frameInfo);
+    ~FrameTrace();
+
+    void end(const FrameInfo& frameInfo);
+
+private:
+    LatencyTracer& m_tracer;
+    bool m_isEnded;
+};
+}
+
+#endif // LATENCYTRACER_H
@@ -0,0 +1,99 @@
+#include "spatialgrid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace pose
+{
+SpatialGrid::SpatialGrid()
+    : m_searchRadius(0),
+      m_cellSize(0),
+      m_maxSize(0)
+{
+}
+
+void SpatialGrid::build(const std::vector<BoundingBox3D>& boxes, float searchRadius)
+{
+    m_searchRadius = searchRadius;
+    m_boxes = boxes;
+    m_cells.clear();
+
+    // a cell has about the width of the region a query has to search
+    float meanSize = 0;
+    m_maxSize = 0;
+
+    for (const BoundingBox3D& box : boxes) {
+        meanSize += box.getSize().x;
+        m_maxSize = std::max(m_maxSize, box.getSize().x);
+    }
+
+    meanSize = boxes.empty() ? 0 : meanSize / boxes.size();
+    m_cellSize = std::max(1e-3f, searchRadius + meanSize);
+
+    // sort the boxes by their cells, each cell is a range of the sorted boxes
+    std::vector<std::pair<int, int>> cellBoxes(boxes.size());
+    for (size_t k = 0; k < boxes.size(); k++)
+        cellBoxes[k] = std::make_pair(getCell(boxes[k].getCenter().x), (int)k);
+    std::sort(cellBoxes.begin(), cellBoxes.end());
+
+    m_sortedIndices.resize(boxes.size());
+    for (size_t k = 0; k < cellBoxes.size(); k++) {
+        m_sortedIndices[k] = cellBoxes[k].second;
+
+        if (k == 0 || cellBoxes[k].first != cellBoxes[k - 1].first)
+            m_cells[cellBoxes[k].first] = std::make_pair((int)k, (int)k + 1);
+        else
+            m_cells[cellBoxes[k].first].second++;
+    }
+}
+
+void SpatialGrid::query(const BoundingBox3D& box, std::vector<int>& indices) const
+{
+    indices.clear();
+
+    // the cells of all centers that can be within the gate
+    const float center = box.getCenter().x;
+    const float reach = m_searchRadius + (box.getSize().x + m_maxSize) / 2;
+    const int minCell = getCell(center - reach);
+    const int maxCell = getCell(center + reach);
+
+    // a wide box (or a few wide ones in the grid) can reach more cells than there are boxes
+    if ((int64_t)maxCell - minCell + 1 >= (int64_t)m_boxes.size()) {
+        for (size_t k = 0; k < m_boxes.size(); k++) {
+            if (isWithinGate(box, m_boxes[k], m_searchRadius))
+                indices.push_back(k);
+        }
+        return;
+    }
+
+    for (int x = minCell; x <= maxCell; x++) {
+        auto it = m_cells.find(x);
+        if (it == m_cells.end())
+            continue;
+
+        for (int k = it->second.first; k < it->second.second; k++) {
+            const int index = m_sortedIndices[k];
+            if (isWithinGate(box, m_boxes[index], m_searchRadius))
+                indices.push_back(index);
+        }
+    }
+
+    std::sort(indices.begin(), indices.end());
+}
+
+bool SpatialGrid::isWithinGate(const BoundingBox3D& box, const BoundingBox3D& other, float searchRadius)
+{
+    // Utils::distance combines the anchor distances so that each term contains the left or the
+    // right anchor, i.e. it is at least the distance of the left or the right sides, which is
+    // within the search radius only if the centers are at most this far apart on the x axis. The
+    // other axes are not bounded by the distance and must not be gated on.
+    const float distance = std::abs(box.getCenter().x - other.getCenter().x);
+    return distance <= searchRadius + (box.getSize().x + other.getSize().x) / 2;
+}
+
+int SpatialGrid::getCell(float value) const
+{
+    // clamp to the range of int, boxes that far away do not occur
+    const float cell = std::floor(value / m_cellSize);
+    return (int)std::max(-1e9f, std::min(1e9f, cell));
+}
+}
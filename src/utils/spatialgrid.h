@@ -0,0 +1,54 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "boundingbox3d.h"
+
+namespace pose
+{
+/**
+ * @brief Uniform grid along the x axis over the centers of bounding boxes to find the boxes that
+ * are near another box without comparing all pairs. Each box is stored in the cell of its center,
+ * only the cells that contain boxes are allocated.
+ */
+class SpatialGrid
+{
+public:
+    SpatialGrid();
+
+    /**
+     * @brief Rebuilds the grid over the boxes for queries with the given search radius. The cells
+     * are as wide as the search radius plus the mean width of the boxes.
+     */
+    void build(const std::vector<BoundingBox3D>& boxes, float searchRadius);
+
+    /**
+     * @brief Sets indices to the boxes (in increasing order) that are within the gate of the given
+     * box, see isWithinGate.
+     */
+    void query(const BoundingBox3D& box, std::vector<int>& indices) const;
+
+    /**
+     * @brief Whether the centers of the boxes are on the x axis at most the search radius plus half
+     * of both widths apart. Boxes outside of the gate are never within the search radius of
+     * Utils::distance, so the gate only skips pairs that cannot match.
+     */
+    static bool isWithinGate(const BoundingBox3D& box, const BoundingBox3D& other, float searchRadius);
+
+private:
+    int getCell(float value) const;
+
+    float m_searchRadius;
+    float m_cellSize;
+    float m_maxSize;
+
+    std::vector<BoundingBox3D> m_boxes;
+    std::vector<int> m_sortedIndices;                      // of the boxes sorted by their cells
+    std::unordered_map<int, std::pair<int, int>> m_cells;  // range of the sorted indices
+};
+}
+
+#endif // SPATIALGRID_H
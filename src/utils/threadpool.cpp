@@ -0,0 +1,153 @@
+#include "threadpool.h"
+#include <algorithm>
+
+namespace pose
+{
+ThreadPool::ThreadPool(int numThreads)
+    : m_terminateThreads(false)
+{
+    for (int i = 1; i < numThreads; i++)
+        m_threads.push_back(new boost::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    // signal the threads to exit and free memory
+    m_mutex.lock();
+    m_terminateThreads = true;
+    m_jobCondition.notify_all();
+    m_mutex.unlock();
+
+    for (size_t i = 0; i < m_threads.size(); i++) {
+        m_threads[i]->join();
+        delete m_threads[i];
+    }
+    m_threads.clear();
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool(std::max(1, (int)boost::thread::hardware_concurrency()));
+    return pool;
+}
+
+int ThreadPool::getNumThreads() const
+{
+    return (int)m_threads.size() + 1;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int numBands, const BandFunction& function)
+{
+    numBands = std::min(numBands, end - begin);
+    if (numBands <= 0)
+        return;
+
+    // nothing to distribute
+    if (numBands == 1 || m_threads.empty()) {
+        const int size = end - begin;
+        for (int i = 0; i < numBands; i++)
+            function(i, begin + (int)((long long)size * i / numBands), begin + (int)((long long)size * (i + 1) / numBands));
+        return;
+    }
+
+    Job job;
+    job.function = &function;
+    job.begin = begin;
+    job.end = end;
+    job.numBands = numBands;
+    job.nextBand = 0;
+    job.remainingBands = numBands;
+
+    m_mutex.lock();
+    m_jobs.push_back(&job);
+    m_jobCondition.notify_all();
+    m_mutex.unlock();
+
+    // take part in the processing
+    int band = 0;
+    while (claimBand(&job, band))
+        runBand(&job, band);
+
+    // wait until the workers have finished the remaining bands
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        while (job.remainingBands > 0)
+            m_doneCondition.wait(lock);
+    }
+
+    // no other thread accesses the job anymore
+    if (job.exception)
+        std::rethrow_exception(job.exception);
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true) {
+        Job* job = 0;
+        int band = 0;
+
+        {
+            // wait until there is a job with unclaimed bands
+            boost::mutex::scoped_lock lock(m_mutex);
+            while (m_jobs.empty() && !m_terminateThreads)
+                m_jobCondition.wait(lock);
+
+            // if termiation flag is set, exit the loop
+            if (m_terminateThreads)
+                break;
+
+            job = m_jobs.front();
+            band = job->nextBand++;
+
+            // all bands of this job are claimed, so no other thread may access it through the queue
+            if (job->nextBand == job->numBands)
+                m_jobs.pop_front();
+        }
+
+        runBand(job, band);
+    }
+}
+
+bool ThreadPool::claimBand(Job* job, int& band)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+
+    if (job->nextBand >= job->numBands)
+        return false;
+
+    band = job->nextBand++;
+
+    if (job->nextBand == job->numBands) {
+        std::deque<Job*>::iterator it = std::find(m_jobs.begin(), m_jobs.end(), job);
+        if (it != m_jobs.end())
+            m_jobs.erase(it);
+    }
+
+    return true;
+}
+
+void ThreadPool::runBand(Job* job, int band)
+{
+    const int size = job->end - job->begin;
+    const int bandBegin = job->begin + (int)((long long)size * band / job->numBands);
+    const int bandEnd = job->begin + (int)((long long)size * (band + 1) / job->numBands);
+
+    // an exception must not leave the band unfinished, the calling thread would wait forever or
+    // destroy the job while workers still use it
+    std::exception_ptr exception;
+    try {
+        (*job->function)(band, bandBegin, bandEnd);
+    }
+    catch (...) {
+        exception = std::current_exception();
+    }
+
+    // the job may be destroyed by the calling thread as soon as the last band is done and the
+    // lock has been released
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (exception && !job->exception)
+        job->exception = exception;
+    if (--job->remainingBands == 0)
+        m_doneCondition.notify_all();
+}
+}
@@ -0,0 +1,75 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace pose
+{
+/**
+ * @brief A pool of worker threads that is shared by all modules to process images in parallel
+ * bands. The calling thread always takes part in the processing.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Function that processes one band, i.e. the range [begin, end) with the given index.
+     */
+    typedef std::function<void(int band, int begin, int end)> BandFunction;
+
+    /**
+     * @brief Create a pool with the given number of threads including the calling thread, i.e.
+     * numThreads - 1 worker threads are started.
+     */
+    ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    /**
+     * @brief Get the pool that is shared by all modules. It uses one thread per CPU core.
+     */
+    static ThreadPool& instance();
+
+    /**
+     * @brief Get the number of threads including the calling thread.
+     */
+    int getNumThreads() const;
+
+    /**
+     * @brief Split the range [begin, end) into numBands contiguous bands of (almost) equal size
+     * and process them in parallel. Blocks until all bands have been processed. If a band throws,
+     * the other bands are still processed and the first exception is rethrown afterwards.
+     */
+    void parallelFor(int begin, int end, int numBands, const BandFunction& function);
+
+private:
+    struct Job
+    {
+        const BandFunction* function;
+        int begin;
+        int end;
+        int numBands;
+        int nextBand;
+        int remainingBands;
+        std::exception_ptr exception;   // the first exception of a band
+    };
+
+    void workerLoop();
+    bool claimBand(Job* job, int& band);
+    void runBand(Job* job, int band);
+
+    std::vector<boost::thread*> m_threads;
+    std::deque<Job*> m_jobs;
+    boost::mutex m_mutex;
+    boost::condition_variable m_jobCondition;
+    boost::condition_variable m_doneCondition;
+    bool m_terminateThreads;
+};
+}
+
+#endif // THREADPOOL_H
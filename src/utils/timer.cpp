@@ -20,6 +20,7 @@
 ***********************************************************************/
 
 #include "Timer.h"
+#include <chrono>
 
 using namespace std;
 
@@ -89,6 +90,12 @@ namespace pose
 #endif
 	}
 
+	long long Timer::getMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
 	void Timer::reset()
 	{
 		m_elapsed = 0;
@@ -23,6 +23,12 @@ public:
     void reset();
     static float getTimestamp();
 
+    /**
+     * @brief Get the current time of a monotonic clock in microseconds. This is the clock that
+     * is used for frame timestamps.
+     */
+    static long long getMicroseconds();
+
 private:
 #ifdef _WIN32
     LARGE_INTEGER m_start;
@@ -1,36 +1,120 @@
 #include "utils.h"
 #include "boundingbox3d.h"
+#include "threadpool.h"
+#include "cpufeatures.h"
 #include <iostream>
+#include <cstring>
+
+#ifdef POSE_SIMD_X86
+#include <immintrin.h>
+#endif
 
 namespace pose
 {
+// the colors of the labels as 0x00RRGGBB, i.e. the bytes in memory are blue, green and red
+class LabelColorTable
+{
+public:
+    LabelColorTable()
+    {
+        for (unsigned int label = 0; label < (unsigned int)Utils::LABEL_COLOR_TABLE_SIZE; label++) {
+            // finalizer of MurmurHash3, which spreads neighboring labels over all colors
+            unsigned int hash = label + 1;
+            hash ^= hash >> 16;
+            hash *= 0x85ebca6b;
+            hash ^= hash >> 13;
+            hash *= 0xc2b2ae35;
+            hash ^= hash >> 16;
+            m_colors[label] = hash & 0xffffff;
+        }
+    }
+
+    const unsigned int* getColors() const
+    {
+        return m_colors;
+    }
+
+private:
+    unsigned int m_colors[Utils::LABEL_COLOR_TABLE_SIZE];
+};
+
+static const LabelColorTable& getLabelColorTable()
+{
+    static const LabelColorTable table;
+    return table;
+}
+
+typedef void (*ColorRowFunc)(const unsigned int* labels, const unsigned int* colors, cv::Vec3b* coloredRow, int cols);
+
+static void colorRowScalar(const unsigned int* labels, const unsigned int* colors, cv::Vec3b* coloredRow, int cols)
+{
+    for (int j = 0; j < cols; j++) {
+        const unsigned int color = labels[j] ? colors[labels[j] & (Utils::LABEL_COLOR_TABLE_SIZE - 1)] : 0;
+        coloredRow[j] = cv::Vec3b(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff);
+    }
+}
+
+#ifdef POSE_SIMD_X86
+
+POSE_TARGET("avx2")
+static void colorRowAVX2(const unsigned int* labels, const unsigned int* colors, cv::Vec3b* coloredRow, int cols)
+{
+    uchar* out = &coloredRow[0][0];
+    const __m256i indexMask = _mm256_set1_epi32(Utils::LABEL_COLOR_TABLE_SIZE - 1);
+    const __m256i zero = _mm256_setzero_si256();
+
+    // drops the fourth byte of each color, the 12 bytes of each lane are stored separately
+    const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        const __m256i label = _mm256_loadu_si256((const __m256i*)(labels + j));
+        __m256i color = _mm256_i32gather_epi32((const int*)colors, _mm256_and_si256(label, indexMask), 4);
+        color = _mm256_andnot_si256(_mm256_cmpeq_epi32(label, zero), color);
+        color = _mm256_shuffle_epi8(color, pack);
+
+        const __m128i low = _mm256_castsi256_si128(color);
+        const __m128i high = _mm256_extracti128_si256(color, 1);
+        const int lowLast = _mm_extract_epi32(low, 2);
+        const int highLast = _mm_extract_epi32(high, 2);
+
+        _mm_storel_epi64((__m128i*)(out + 3 * j), low);
+        memcpy(out + 3 * j + 8, &lowLast, sizeof(int));
+        _mm_storel_epi64((__m128i*)(out + 3 * j + 12), high);
+        memcpy(out + 3 * j + 20, &highLast, sizeof(int));
+    }
+
+    colorRowScalar(labels + j, colors, coloredRow + j, cols - j);
+}
+
+#endif // POSE_SIMD_X86
+
 void Utils::getColoredLabelMap(const cv::Mat& labelMap, cv::Mat& coloredLabelMap)
 {
     if (coloredLabelMap.empty() || coloredLabelMap.rows != labelMap.rows ||
             coloredLabelMap.cols != labelMap.cols || coloredLabelMap.type() != CV_8UC3) {
         coloredLabelMap = cv::Mat(labelMap.rows, labelMap.cols, CV_8UC3);
     }
-    coloredLabelMap.setTo(0);
-
-    for (int i = 0; i < labelMap.cols; i++) {
-        for (int j = 0; j < labelMap.rows; j++) {
-            const unsigned int& label = labelMap.at<unsigned int>(cv::Point(i, j));
-
-            if (label > 0) {
-                cv::Vec3b color = getLabelColor(label);
-                coloredLabelMap.at<cv::Vec3b>(cv::Point(i, j))[0] = (uchar)color[0];
-                coloredLabelMap.at<cv::Vec3b>(cv::Point(i, j))[1] = (uchar)color[1];
-                coloredLabelMap.at<cv::Vec3b>(cv::Point(i, j))[2] = (uchar)color[2];
-            }
-        }
-    }
+
+    ColorRowFunc colorRow = colorRowScalar;
+#ifdef POSE_SIMD_X86
+    if (CpuFeatures::getInstructionSet() >= CpuFeatures::IS_AVX2)
+        colorRow = colorRowAVX2;
+#endif
+
+    const unsigned int* colors = getLabelColorTable().getColors();
+
+    ThreadPool& threadPool = ThreadPool::instance();
+    threadPool.parallelFor(0, labelMap.rows, threadPool.getNumThreads(), [&](int, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            colorRow(labelMap.ptr<unsigned int>(i), colors, coloredLabelMap.ptr<cv::Vec3b>(i), labelMap.cols);
+    });
 }
 
 cv::Mat Utils::getColoredLabelMap(const cv::Mat& labelMap)
 {
-    cv::Mat coloredLabelMap(labelMap.rows, labelMap.cols, CV_8UC3);
-    coloredLabelMap.setTo(0);
-
+    cv::Mat coloredLabelMap;
     getColoredLabelMap(labelMap, coloredLabelMap);
 
     return coloredLabelMap;
@@ -38,10 +122,8 @@ cv::Mat Utils::getColoredLabelMap(const cv::Mat& labelMap)
 
 cv::Vec3b Utils::getLabelColor(unsigned int label)
 {
-    srand(label);
-    return cv::Vec3b((rand() / (float)RAND_MAX) * 255,
-                     (rand() / (float)RAND_MAX) * 255,
-                     (rand() / (float)RAND_MAX) * 255);
+    const unsigned int color = getLabelColorTable().getColors()[label & (LABEL_COLOR_TABLE_SIZE - 1)];
+    return cv::Vec3b(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff);
 }
 
 bool Utils::loadCvMat(const char* filename, cv::Mat& image)
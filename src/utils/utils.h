@@ -16,9 +16,20 @@ class BoundingBox3D;
 class Utils
 {
 public:
+    /**
+     * @brief Colors each label of the label map (CV_32S) with getLabelColor, label 0 is black. The
+     * rows are colored in parallel on the shared thread pool.
+     */
     static void getColoredLabelMap(const cv::Mat&, cv::Mat&);
     static cv::Mat getColoredLabelMap(const cv::Mat&);
+
+    /**
+     * @brief The color of a label from a fixed table of hashed colors, i.e. the same label always
+     * has the same color. The colors repeat every LABEL_COLOR_TABLE_SIZE labels.
+     */
     static cv::Vec3b getLabelColor(unsigned int label);
+
+    static const int LABEL_COLOR_TABLE_SIZE = 4096;
     static bool loadCvMat(const char* filename, cv::Mat& image);
     static bool saveCvMat(const char* filename, const cv::Mat& image);
     static float distance(const BoundingBox3D& box1, const BoundingBox3D& box2, float searchRadius);